@@ -309,6 +309,65 @@ static void iterator_delete(test_batch_runner *runner) {
   cmark_node_free(doc);
 }
 
+static void flat_tree(test_batch_runner *runner) {
+  static const char md[] = "# T\n"
+                           "\n"
+                           "- a *b*\n"
+                           "- ![c](/u \"t\")\n"
+                           "\n"
+                           "```x\n"
+                           "code\n"
+                           "```\n";
+  cmark_node *doc = cmark_parse_document(md, sizeof(md) - 1, CMARK_OPT_DEFAULT);
+  cmark_flat *flat = cmark_flatten(doc);
+  const cmark_flat_event *ev = cmark_flat_events(flat);
+  cmark_event_type ev_type;
+  cmark_iter *iter = cmark_iter_new(doc);
+  size_t i = 0, n = cmark_flat_count(flat);
+  int same = 1;
+  char *html, *flat_html;
+  void *copy;
+
+  while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+    cmark_node *cur = cmark_iter_get_node(iter);
+    if (i >= n || ev[i].type != cur->type || ev[i].event != ev_type)
+      same = 0;
+    i++;
+  }
+  cmark_iter_free(iter);
+  OK(runner, same && i == n, "flat tree has the events of an iterator");
+
+  INT_EQ(runner, ev[0].type, CMARK_NODE_DOCUMENT, "flat tree starts at root");
+  INT_EQ(runner, (int)ev[0].match, (int)n - 1, "root ENTER matches its EXIT");
+  INT_EQ(runner, ev[1].type, CMARK_NODE_HEADING, "flat heading");
+  INT_EQ(runner, ev[1].number, 1, "flat heading level");
+  INT_EQ(runner, ev[1].depth, 1, "flat heading depth");
+  INT_EQ(runner, ev[6].type, CMARK_NODE_PARAGRAPH, "flat paragraph");
+  OK(runner, (ev[6].flags & CMARK_FLAT_TIGHT) != 0,
+     "flat paragraph in tight list");
+  for (i = 0; i < n && ev[i].type != CMARK_NODE_IMAGE; i++)
+    ;
+  STR_EQ(runner, cmark_flat_string(flat, ev[i].literal), "/u", "flat url");
+  STR_EQ(runner, cmark_flat_string(flat, ev[i].info), "t", "flat title");
+  INT_EQ(runner, ev[ev[i].match].event, CMARK_EVENT_EXIT, "flat image EXIT");
+  STR_EQ(runner, cmark_flat_string(flat, ev[n - 2].literal), "code\n",
+         "flat code block literal");
+  STR_EQ(runner, cmark_flat_string(flat, ev[n - 2].info), "x",
+         "flat code block info");
+  OK(runner, (ev[n - 2].flags & CMARK_FLAT_FENCED) != 0, "flat fenced");
+
+  html = cmark_render_html(doc, CMARK_OPT_SOURCEPOS);
+  copy = malloc(cmark_flat_size(flat));
+  memcpy(copy, flat, cmark_flat_size(flat));
+  cmark_flat_free(flat);
+  flat_html = cmark_render_html_flat((cmark_flat *)copy, CMARK_OPT_SOURCEPOS);
+  STR_EQ(runner, flat_html, html, "render a copy of a flat tree");
+  free(flat_html);
+  free(copy);
+  free(html);
+  cmark_node_free(doc);
+}
+
 static void create_tree(test_batch_runner *runner) {
   char *html;
   cmark_node *doc = cmark_node_new(CMARK_NODE_DOCUMENT);
@@ -883,6 +942,374 @@ static void test_feed_across_line_ending(test_batch_runner *runner) {
   cmark_node_free(document);
 }
 
+static void parser_stats(test_batch_runner *runner) {
+  static const char markdown[] = "# Title\n\nSome *text* and [a link][r].\n\n"
+                                 "[r]: /url\n";
+  cmark_parser *parser = cmark_parser_new(CMARK_OPT_DEFAULT);
+  cmark_node *doc;
+  cmark_stats stats;
+
+  cmark_parser_feed(parser, markdown, sizeof(markdown) - 1);
+  doc = cmark_parser_finish(parser);
+  if (cmark_parser_get_stats(parser, &stats)) {
+    OK(runner, stats.lines == 5, "get_stats counts lines");
+    INT_EQ(runner, (int)stats.nodes[CMARK_NODE_PARAGRAPH], 2,
+           "get_stats counts paragraphs");
+    OK(runner, stats.nodes[CMARK_NODE_EMPH] == 1, "get_stats counts emph");
+    OK(runner, stats.ref_hits == 1, "get_stats counts reference hits");
+  } else {
+    OK(runner, stats.lines == 0 && stats.allocs == 0,
+       "get_stats zeroes stats without CMARK_STATS");
+  }
+  cmark_node_free(doc);
+  cmark_parser_free(parser);
+}
+
+static char *limited_html(const char *markdown, const cmark_limits *limits) {
+  cmark_parser *parser = cmark_parser_new(CMARK_OPT_DEFAULT);
+  cmark_node *doc;
+  char *html;
+
+  cmark_parser_set_limits(parser, limits);
+  cmark_parser_feed(parser, markdown, strlen(markdown));
+  doc = cmark_parser_finish(parser);
+  html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  cmark_node_free(doc);
+  cmark_parser_free(parser);
+  return html;
+}
+
+static void parser_limits(test_batch_runner *runner) {
+  cmark_limits limits;
+  char *html;
+
+  memset(&limits, 0, sizeof(limits));
+  limits.max_nesting = 2;
+  html = limited_html("> > > a\n", &limits);
+  STR_EQ(runner, html, "<blockquote>\n<blockquote>\n<p>&gt; a</p>\n"
+                       "</blockquote>\n</blockquote>\n",
+         "max_nesting limits block quotes");
+  free(html);
+  html = limited_html("- > - a\n", &limits);
+  STR_EQ(runner, html, "<ul>\n<li>\n<blockquote>\n<p>- a</p>\n"
+                       "</blockquote>\n</li>\n</ul>\n",
+         "max_nesting limits lists");
+  free(html);
+
+  memset(&limits, 0, sizeof(limits));
+  limits.max_delimiters = 2;
+  html = limited_html("*a* *b*\n", &limits);
+  STR_EQ(runner, html, "<p><em>a</em> *b*</p>\n",
+         "max_delimiters limits emphasis");
+  free(html);
+  html = limited_html("[*a*](/u) [_b_](/v) [*c*](/w) *d*\n", &limits);
+  STR_EQ(runner, html,
+         "<p><a href=\"/u\"><em>a</em></a> <a href=\"/v\"><em>b</em></a> "
+         "<a href=\"/w\"><em>c</em></a> <em>d</em></p>\n",
+         "max_delimiters counts only delimiters awaiting a match");
+  free(html);
+
+  memset(&limits, 0, sizeof(limits));
+  limits.max_references = 1;
+  html = limited_html("[a]: /u\n[b]: /v\n\n[a] [b]\n", &limits);
+  STR_EQ(runner, html, "<p>[b]: /v</p>\n<p><a href=\"/u\">a</a> [b]</p>\n",
+         "max_references limits reference definitions");
+  free(html);
+
+  memset(&limits, 0, sizeof(limits));
+  limits.max_nodes = 2;
+  html = limited_html("a\n\n*b* c\n\n- d\n", &limits);
+  STR_EQ(runner, html, "<p>a</p>\n<p>*b* c</p>\n<p>- d</p>\n",
+         "max_nodes keeps the rest as text");
+  free(html);
+
+  memset(&limits, 0, sizeof(limits));
+  limits.max_steps = 4;
+  html = limited_html("a\n\n*b* c\n", &limits);
+  STR_EQ(runner, html, "<p>a</p>\n<p>*b* c</p>\n",
+         "max_steps keeps the rest as text");
+  free(html);
+
+  memset(&limits, 0, sizeof(limits));
+  limits.max_output = 20;
+  html = limited_html("> a\n\nb\n\nc\n", &limits);
+  STR_EQ(runner, html, "<blockquote>\n<p>a</p>\n</blockquote>\n",
+         "max_output leaves out the rest");
+  free(html);
+}
+
+static char *feed_and_render(cmark_parser *parser, const char *markdown) {
+  cmark_node *doc;
+  char *html;
+
+  cmark_parser_feed(parser, markdown, strlen(markdown));
+  doc = cmark_parser_finish(parser);
+  html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  cmark_node_free(doc);
+  return html;
+}
+
+static void parser_reset(test_batch_runner *runner) {
+  cmark_parser *parser = cmark_parser_new(CMARK_OPT_DEFAULT);
+  cmark_limits limits;
+  char *html;
+
+  html = feed_and_render(parser, "[a]: /u\n\n[a]\n");
+  STR_EQ(runner, html, "<p><a href=\"/u\">a</a></p>\n",
+         "reset: first document");
+  free(html);
+
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  html = feed_and_render(parser, "[a] \"b\"\n");
+  STR_EQ(runner, html, "<p>[a] &quot;b&quot;</p>\n",
+         "reset drops reference definitions");
+  free(html);
+
+  cmark_parser_reset(parser, CMARK_OPT_SMART);
+  html = feed_and_render(parser, "\"b\"\n");
+  STR_EQ(runner, html, "<p>\xe2\x80\x9c" "b\xe2\x80\x9d</p>\n",
+         "reset sets new options");
+  free(html);
+
+  // A document that was never finished is dropped.
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  cmark_parser_feed(parser, "> unfinished\n> quote", 20);
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  html = feed_and_render(parser, "x\n");
+  STR_EQ(runner, html, "<p>x</p>\n", "reset drops an unfinished document");
+  free(html);
+
+  memset(&limits, 0, sizeof(limits));
+  limits.max_nesting = 1;
+  cmark_parser_set_limits(parser, &limits);
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  html = feed_and_render(parser, "> > a\n");
+  STR_EQ(runner, html, "<blockquote>\n<p>&gt; a</p>\n</blockquote>\n",
+         "reset keeps the limits");
+  free(html);
+
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  cmark_parser_feed(parser, "left unfinished", 15);
+  cmark_parser_free(parser);
+}
+
+static void render_size_hint(test_batch_runner *runner) {
+  static const char markdown[] =
+      "# Title\n\n"
+      "Some *emphasis*, `code` and <http://example.com/?a&b>.\n\n"
+      "- one\n- two &amp; three\n\n"
+      "end\n\n"
+      "    <code block>\n";
+  cmark_node *doc, *built, *para, *text;
+  char *html;
+  size_t hint, len;
+
+  doc = cmark_parse_document(markdown, sizeof(markdown) - 1,
+                             CMARK_OPT_DEFAULT);
+  html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  len = strlen(html);
+  hint = cmark_render_html_size_hint(doc, CMARK_OPT_DEFAULT);
+  OK(runner, hint >= len * 3 / 4 && hint <= len * 5 / 4,
+     "size hint of a parsed document is near the output length");
+  OK(runner,
+     cmark_render_html_size_hint(doc, CMARK_OPT_SOURCEPOS) >= hint + 8 * 27,
+     "size hint counts source positions");
+  free(html);
+
+  cmark_node_free(doc);
+
+  // A tree built without the parser is counted when asked, the same
+  // as the parser counts it.
+  doc = cmark_parse_document("a < b\n", 6, CMARK_OPT_DEFAULT);
+  hint = cmark_render_html_size_hint(doc, CMARK_OPT_DEFAULT);
+  built = cmark_node_new(CMARK_NODE_DOCUMENT);
+  para = cmark_node_new(CMARK_NODE_PARAGRAPH);
+  text = cmark_node_new(CMARK_NODE_TEXT);
+  cmark_node_set_literal(text, "a < b");
+  cmark_node_append_child(para, text);
+  cmark_node_append_child(built, para);
+  INT_EQ(runner, (int)cmark_render_html_size_hint(built, CMARK_OPT_DEFAULT),
+         (int)hint, "size hint of a built tree");
+  INT_EQ(runner, (int)cmark_render_html_size_hint(para, CMARK_OPT_DEFAULT),
+         (int)hint, "size hint of a subtree");
+  cmark_node_free(built);
+  cmark_node_free(doc);
+
+  doc = cmark_parse_document("", 0, CMARK_OPT_DEFAULT);
+  INT_EQ(runner, (int)cmark_render_html_size_hint(doc, CMARK_OPT_DEFAULT), 0,
+         "size hint of an empty document");
+  html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  STR_EQ(runner, html, "", "render an empty document");
+  free(html);
+  cmark_node_free(doc);
+
+  // Man and LaTeX leave out raw HTML, so the pre-sized buffer stays
+  // empty until the final newline.
+  doc = cmark_parse_document(" <div>\n  *hello*\n         <foo><a>\n", 35,
+                             CMARK_OPT_DEFAULT);
+  html = cmark_render_man(doc, CMARK_OPT_DEFAULT, 0);
+  STR_EQ(runner, html, "\n", "render man of an HTML block");
+  free(html);
+  html = cmark_render_latex(doc, CMARK_OPT_DEFAULT, 0);
+  STR_EQ(runner, html, "\n", "render latex of an HTML block");
+  free(html);
+  cmark_node_free(doc);
+}
+
+static void lazy_inlines(test_batch_runner *runner) {
+  static const char markdown[] = "# A *b*\n"
+                                 "\n"
+                                 "> [c][r] `d`\n"
+                                 "\n"
+                                 "[r]: /u\n"
+                                 "\n"
+                                 "e \"f\"\n";
+  int options = CMARK_OPT_SMART | CMARK_OPT_NORMALIZE;
+  cmark_parser *parser = cmark_parser_new(options | CMARK_OPT_LAZY_INLINES);
+  cmark_node *doc, *heading, *quote, *para, *node;
+  char *html, *expected;
+
+  cmark_parser_feed(parser, markdown, sizeof(markdown) - 1);
+  doc = cmark_parser_finish(parser);
+  // the document keeps the reference definitions it needs
+  cmark_parser_free(parser);
+
+  heading = cmark_node_first_child(doc);
+  INT_EQ(runner, cmark_node_get_type(heading), CMARK_NODE_HEADING,
+         "lazy inlines: heading");
+  quote = cmark_node_next(heading);
+  para = cmark_node_last_child(doc);
+  INT_EQ(runner, cmark_node_get_type(quote), CMARK_NODE_BLOCK_QUOTE,
+         "lazy inlines: block quote");
+  INT_EQ(runner, cmark_node_get_type(para), CMARK_NODE_PARAGRAPH,
+         "lazy inlines: paragraph");
+
+  node = cmark_node_last_child(heading);
+  INT_EQ(runner, cmark_node_get_type(node), CMARK_NODE_EMPH,
+         "inlines parsed by cmark_node_last_child");
+
+  // a paragraph leaving its document is parsed first
+  cmark_node_unlink(para);
+  node = cmark_node_first_child(para);
+  STR_EQ(runner, cmark_node_get_literal(node),
+         "e \xe2\x80\x9c" "f\xe2\x80\x9d",
+         "inlines of an unlinked paragraph");
+  cmark_node_append_child(doc, para);
+
+  html = cmark_render_html(doc, options);
+  expected = cmark_markdown_to_html(markdown, sizeof(markdown) - 1, options);
+  STR_EQ(runner, html, expected, "lazy inlines render the same HTML");
+  free(html);
+  free(expected);
+  cmark_node_free(doc);
+
+  // a document freed with its inlines never parsed
+  doc = cmark_parse_document(markdown, sizeof(markdown) - 1,
+                             CMARK_OPT_LAZY_INLINES);
+  quote = cmark_node_next(cmark_node_first_child(doc));
+  OK(runner, quote->first_child->first_child == NULL,
+     "inlines are not parsed before they are accessed");
+  cmark_node_free(doc);
+}
+
+static void outline(test_batch_runner *runner) {
+  static const char markdown[] = "# One *a* #\n"
+                                 "\n"
+                                 "- Two\n"
+                                 "  ===\n"
+                                 "\n"
+                                 "  ```c a\n"
+                                 "  x\n"
+                                 "  ```\n"
+                                 "\n"
+                                 "[B]: /b\n"
+                                 "[a]: /a\n"
+                                 "[b]: /c\n"
+                                 "\n"
+                                 "    ~~~ not a fence\n";
+  cmark_outline *outline =
+      cmark_parse_outline(markdown, sizeof(markdown) - 1, CMARK_OPT_DEFAULT);
+  const cmark_outline_entry *e = cmark_outline_entries(outline);
+
+  INT_EQ(runner, (int)cmark_outline_count(outline), 5, "outline entries");
+  INT_EQ(runner, e[0].type, CMARK_OUTLINE_HEADING, "outline heading");
+  INT_EQ(runner, e[0].level, 1, "outline heading level");
+  STR_EQ(runner, cmark_outline_string(outline, e[0].text), "One *a*",
+         "outline heading text");
+  INT_EQ(runner, e[0].end_column, 9, "outline heading position");
+  INT_EQ(runner, e[1].level, 1, "outline setext heading in a list");
+  STR_EQ(runner, cmark_outline_string(outline, e[1].text), "Two",
+         "outline setext heading text");
+  INT_EQ(runner, e[1].start_line, 3, "outline setext heading line");
+  INT_EQ(runner, e[2].type, CMARK_OUTLINE_CODE, "outline fenced code");
+  STR_EQ(runner, cmark_outline_string(outline, e[2].text), "c a",
+         "outline info string");
+  INT_EQ(runner, e[2].end_line, 8, "outline fenced code position");
+  INT_EQ(runner, e[3].type, CMARK_OUTLINE_REFERENCE, "outline reference");
+  STR_EQ(runner, cmark_outline_string(outline, e[3].text), "b",
+         "outline reference label");
+  STR_EQ(runner, cmark_outline_string(outline, e[3].url), "/b",
+         "the first definition of a label wins");
+  STR_EQ(runner, cmark_outline_string(outline, e[4].url), "/a",
+         "outline references in order");
+  INT_EQ(runner, (int)e[4].url_len, 2, "outline string length");
+  cmark_outline_free(outline);
+
+  outline = cmark_parse_outline("", 0, CMARK_OPT_DEFAULT);
+  INT_EQ(runner, (int)cmark_outline_count(outline), 0, "empty outline");
+  cmark_outline_free(outline);
+}
+
+static void shared_references(test_batch_runner *runner) {
+  static const char glossary[] = "[a]: /ga\n"
+                                 "[B  c]: /gb \"t\"\n"
+                                 "\n"
+                                 "# Not a reference\n";
+  cmark_reference_map *map =
+      cmark_parse_references(glossary, sizeof(glossary) - 1,
+                             CMARK_OPT_DEFAULT);
+  cmark_parser *parser = cmark_parser_new(CMARK_OPT_DEFAULT);
+  cmark_node *doc;
+  char *html;
+
+  INT_EQ(runner, (int)cmark_reference_map_count(map), 2,
+         "shared references parsed");
+
+  cmark_parser_set_shared_references(parser, map);
+  html = feed_and_render(parser, "[a] [b C] [d]\n\n[a]: /doc\n");
+  STR_EQ(runner, html,
+         "<p><a href=\"/doc\">a</a> <a href=\"/gb\" title=\"t\">b C</a> "
+         "[d]</p>\n",
+         "shared references are looked up after the document's");
+  free(html);
+
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  html = feed_and_render(parser, "[a]\n");
+  STR_EQ(runner, html, "<p><a href=\"/ga\">a</a></p>\n",
+         "reset keeps the shared references");
+  free(html);
+
+  cmark_parser_reset(parser, CMARK_OPT_DEFAULT);
+  cmark_parser_set_shared_references(parser, NULL);
+  html = feed_and_render(parser, "[a]\n");
+  STR_EQ(runner, html, "<p>[a]</p>\n", "shared references detached");
+  free(html);
+  cmark_parser_free(parser);
+
+  parser = cmark_parser_new(CMARK_OPT_LAZY_INLINES);
+  cmark_parser_set_shared_references(parser, map);
+  cmark_parser_feed(parser, "[a]\n", 4);
+  doc = cmark_parser_finish(parser);
+  cmark_parser_free(parser);
+  html = cmark_render_html(doc, CMARK_OPT_DEFAULT);
+  STR_EQ(runner, html, "<p><a href=\"/ga\">a</a></p>\n",
+         "shared references with lazy inlines");
+  free(html);
+  cmark_node_free(doc);
+
+  cmark_reference_map_free(map);
+}
+
 int main() {
   int retval;
   test_batch_runner *runner = test_batch_runner_new();
@@ -893,6 +1320,7 @@ int main() {
   node_check(runner);
   iterator(runner);
   iterator_delete(runner);
+  flat_tree(runner);
   create_tree(runner);
   custom_nodes(runner);
   hierarchy(runner);
@@ -908,6 +1336,13 @@ int main() {
   test_cplusplus(runner);
   test_safe(runner);
   test_feed_across_line_ending(runner);
+  parser_stats(runner);
+  parser_limits(runner);
+  parser_reset(runner);
+  render_size_hint(runner);
+  lazy_inlines(runner);
+  outline(runner);
+  shared_references(runner);
 
   test_print_summary(runner);
   retval = test_ok(runner) ? 0 : 1;
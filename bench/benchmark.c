@@ -0,0 +1,313 @@
+// Benchmark driver: parses and renders input files in-process and
+// reports the throughput of each phase, as text or as JSON.
+//
+// The phases are timed through the public API: "block" is
+// `cmark_parser_feed()` over the whole input (block structure, line
+// by line), "inline" is `cmark_parser_finish()` (closing the blocks,
+// reference definitions and inline parsing), followed by each
+// renderer on the resulting tree.  "flatten" is `cmark_flatten()` of
+// the tree, and "html-flat" is `cmark_render_html_flat()` of the flat
+// tree.  "outline" is `cmark_parse_outline()` of the whole input.  The
+// block phase is also reported in nanoseconds per input line, the unit
+// of work of the block parser.
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmark.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define MAX_SAMPLES 1000
+
+typedef enum {
+  PHASE_BLOCK,
+  PHASE_INLINE,
+  PHASE_HTML,
+  PHASE_XHTML,
+  PHASE_XML,
+  PHASE_MAN,
+  PHASE_COMMONMARK,
+  PHASE_LATEX,
+  PHASE_FLATTEN,
+  PHASE_HTML_FLAT,
+  PHASE_OUTLINE,
+  NUM_PHASES
+} phase_t;
+
+static const char *phase_names[NUM_PHASES] = {
+    "block",      "inline", "html",    "xhtml",     "xml",    "man",
+    "commonmark", "latex",  "flatten", "html-flat", "outline"};
+
+static double now(void) {
+#ifdef _WIN32
+  LARGE_INTEGER freq, count;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&count);
+  return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double median(double *samples, int n) {
+  qsort(samples, n, sizeof(double), cmp_double);
+  return (n % 2) ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+}
+
+static char *read_file(const char *path, size_t *len) {
+  FILE *fp = fopen(path, "rb");
+  char *data = NULL;
+  size_t cap = 0, n = 0, nread;
+
+  if (fp == NULL)
+    return NULL;
+  do {
+    if (n == cap) {
+      cap = cap ? 2 * cap : 65536;
+      data = realloc(data, cap);
+      if (data == NULL) {
+        fclose(fp);
+        return NULL;
+      }
+    }
+    nread = fread(data + n, 1, cap - n, fp);
+    n += nread;
+  } while (nread > 0);
+  fclose(fp);
+
+  *len = n;
+  return data;
+}
+
+static char *render(cmark_node *doc, phase_t phase, int options) {
+  switch (phase) {
+  case PHASE_HTML:
+    return cmark_render_html(doc, options);
+  case PHASE_XHTML:
+    return cmark_render_xhtml(doc, options);
+  case PHASE_XML:
+    return cmark_render_xml(doc, options);
+  case PHASE_MAN:
+    return cmark_render_man(doc, options, 0);
+  case PHASE_COMMONMARK:
+    return cmark_render_commonmark(doc, options, 0);
+  case PHASE_LATEX:
+    return cmark_render_latex(doc, options, 0);
+  default:
+    return NULL;
+  }
+}
+
+// Run all phases `iterations` times over `data`, and store the median
+// time of each phase in `seconds`.
+static void bench_data(const char *data, size_t len, int iterations,
+                       int options, double seconds[NUM_PHASES]) {
+  static double samples[NUM_PHASES][MAX_SAMPLES];
+  cmark_parser *parser;
+  cmark_node *doc;
+  cmark_flat *flat;
+  cmark_outline *outline;
+  char *result;
+  double t0, t1, t2;
+  int i, p;
+
+  for (i = 0; i < iterations; i++) {
+    t0 = now();
+    parser = cmark_parser_new(options);
+    cmark_parser_feed(parser, data, len);
+    t1 = now();
+    doc = cmark_parser_finish(parser);
+    t2 = now();
+    cmark_parser_free(parser);
+    samples[PHASE_BLOCK][i] = t1 - t0;
+    samples[PHASE_INLINE][i] = t2 - t1;
+
+    for (p = PHASE_HTML; p <= PHASE_LATEX; p++) {
+      t0 = now();
+      result = render(doc, (phase_t)p, options);
+      t1 = now();
+      free(result);
+      samples[p][i] = t1 - t0;
+    }
+
+    t0 = now();
+    flat = cmark_flatten(doc);
+    t1 = now();
+    result = cmark_render_html_flat(flat, options);
+    t2 = now();
+    free(result);
+    cmark_flat_free(flat);
+    samples[PHASE_FLATTEN][i] = t1 - t0;
+    samples[PHASE_HTML_FLAT][i] = t2 - t1;
+    cmark_node_free(doc);
+
+    t0 = now();
+    outline = cmark_parse_outline(data, len, options);
+    t1 = now();
+    cmark_outline_free(outline);
+    samples[PHASE_OUTLINE][i] = t1 - t0;
+  }
+
+  for (p = 0; p < NUM_PHASES; p++)
+    seconds[p] = median(samples[p], iterations);
+}
+
+static double mb_per_s(size_t len, double seconds) {
+  return seconds > 0 ? (double)len / 1e6 / seconds : 0;
+}
+
+static size_t count_lines(const char *data, size_t len) {
+  size_t i, lines = 0;
+
+  for (i = 0; i < len; i++) {
+    if (data[i] == '\n' ||
+        (data[i] == '\r' && (i + 1 == len || data[i + 1] != '\n')))
+      lines++;
+  }
+  if (len > 0 && data[len - 1] != '\n' && data[len - 1] != '\r')
+    lines++;
+  return lines;
+}
+
+static double ns_per_line(size_t lines, double seconds) {
+  return lines > 0 ? seconds * 1e9 / (double)lines : 0;
+}
+
+static const char *basename_of(const char *path) {
+  const char *p = strrchr(path, '/');
+#ifdef _WIN32
+  const char *q = strrchr(path, '\\');
+  if (q != NULL && (p == NULL || q > p))
+    p = q;
+#endif
+  return p ? p + 1 : path;
+}
+
+static void print_json_string(const char *s) {
+  putchar('"');
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      printf("\\%c", *s);
+    else if ((unsigned char)*s < 0x20)
+      printf("\\u%04x", (unsigned char)*s);
+    else
+      putchar(*s);
+  }
+  putchar('"');
+}
+
+static void print_usage(void) {
+  printf("Usage:   cmark-bench [OPTIONS] FILE...\n");
+  printf("Options:\n");
+  printf("  --iterations N   Runs per file, the median is reported "
+         "(default 10)\n");
+  printf("  --json           Print results as JSON\n");
+  printf("  --sourcepos      Include source position attribute\n");
+  printf("  --smart          Use smart punctuation\n");
+  printf("  --lazy-inlines   Parse inlines when the renderers reach them\n");
+  printf("  --help, -h       Print usage information\n");
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = 10;
+  int json = 0;
+  int options = CMARK_OPT_DEFAULT;
+  int nfiles = 0, i, p;
+  const char **files = calloc(argc, sizeof(char *));
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+      if (iterations < 1 || iterations > MAX_SAMPLES) {
+        fprintf(stderr, "Iterations must be in 1 .. %d\n", MAX_SAMPLES);
+        exit(1);
+      }
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = 1;
+    } else if (strcmp(argv[i], "--sourcepos") == 0) {
+      options |= CMARK_OPT_SOURCEPOS;
+    } else if (strcmp(argv[i], "--smart") == 0) {
+      options |= CMARK_OPT_SMART;
+    } else if (strcmp(argv[i], "--lazy-inlines") == 0) {
+      options |= CMARK_OPT_LAZY_INLINES;
+    } else if (strcmp(argv[i], "--help") == 0 ||
+               strcmp(argv[i], "-h") == 0) {
+      print_usage();
+      exit(0);
+    } else if (argv[i][0] == '-') {
+      print_usage();
+      exit(1);
+    } else {
+      files[nfiles++] = argv[i];
+    }
+  }
+
+  if (nfiles == 0) {
+    print_usage();
+    exit(1);
+  }
+
+  if (json)
+    printf("{\n  \"version\": \"%s\",\n  \"iterations\": %d,\n"
+           "  \"corpora\": [",
+           cmark_version_string(), iterations);
+  else
+    printf("%-20s %10s %s\n", "corpus", "bytes", "MB/s per phase");
+
+  for (i = 0; i < nfiles; i++) {
+    double seconds[NUM_PHASES];
+    size_t len, lines;
+    char *data = read_file(files[i], &len);
+
+    if (data == NULL) {
+      fprintf(stderr, "Error opening file %s\n", files[i]);
+      exit(1);
+    }
+    bench_data(data, len, iterations, options, seconds);
+    lines = count_lines(data, len);
+    free(data);
+
+    if (json) {
+      printf("%s\n    {\"name\": ", i ? "," : "");
+      print_json_string(basename_of(files[i]));
+      printf(", \"bytes\": %lu, \"lines\": %lu, \"block_ns_per_line\": %.1f,"
+             " \"phases\": {",
+             (unsigned long)len, (unsigned long)lines,
+             ns_per_line(lines, seconds[PHASE_BLOCK]));
+      for (p = 0; p < NUM_PHASES; p++)
+        printf("%s\n      \"%s\": {\"seconds\": %.6f, \"mb_per_s\": %.2f}",
+               p ? "," : "", phase_names[p], seconds[p],
+               mb_per_s(len, seconds[p]));
+      printf("\n    }}");
+    } else {
+      printf("%-20s %10lu", basename_of(files[i]), (unsigned long)len);
+      for (p = 0; p < NUM_PHASES; p++)
+        printf(" %s=%.1f", phase_names[p], mb_per_s(len, seconds[p]));
+      printf(" block-ns/line=%.1f\n",
+             ns_per_line(lines, seconds[PHASE_BLOCK]));
+    }
+  }
+
+  if (json)
+    printf("\n  ]\n}\n");
+
+  free(files);
+  return 0;
+}
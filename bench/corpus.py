@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Generate deterministic synthetic Markdown corpora for benchmarking.
+#
+# Each corpus stresses a different part of the parser; the output
+# depends only on the kind, the size and the seed, so results can be
+# compared across versions without network access.
+
+import argparse
+import math
+import os
+import random
+import sys
+
+WORDS = ("the quick brown fox jumps over lazy dog lorem ipsum dolor sit "
+         "amet consectetur adipiscing elit sed do eiusmod tempor incididunt "
+         "ut labore et dolore magna aliqua enim ad minim veniam quis "
+         "nostrud exercitation ullamco laboris nisi aliquip ex ea commodo "
+         "consequat parser renderer block inline node tree").split()
+
+ENTITIES = ["&amp;", "&lt;", "&gt;", "&quot;", "&copy;", "&auml;",
+            "&ouml;", "&szlig;", "&nbsp;", "&mdash;", "&hellip;",
+            "&#35;", "&#1234;", "&#x1F600;", "&#xe9;", "&bogus;"]
+
+ESCAPES = ["\\*", "\\_", "\\`", "\\[", "\\]", "\\\\", "\\#", "\\<"]
+
+LANGS = ["c", "python", "", "sh", "haskell"]
+
+def words(rng, n):
+    return " ".join(rng.choice(WORDS) for _ in range(n))
+
+def sentence(rng):
+    return words(rng, rng.randint(4, 14)).capitalize() + "."
+
+def inline_text(rng, n):
+    out = []
+    for _ in range(n):
+        r = rng.random()
+        w = rng.choice(WORDS)
+        if r < 0.06:
+            out.append("*" + w + "*")
+        elif r < 0.10:
+            out.append("**" + words(rng, 2) + "**")
+        elif r < 0.13:
+            out.append("`" + w + "()`")
+        elif r < 0.15:
+            out.append("_" + w + "_")
+        else:
+            out.append(w)
+    return " ".join(out)
+
+def prose(rng):
+    parts = []
+    if rng.random() < 0.15:
+        parts.append("#" * rng.randint(1, 3) + " " + words(rng, 4) + "\n\n")
+    lines = [inline_text(rng, rng.randint(8, 14))
+             for _ in range(rng.randint(2, 6))]
+    parts.append("\n".join(lines) + "\n\n")
+    return "".join(parts)
+
+def lists(rng):
+    out = []
+    def item_list(depth, ordered):
+        for i in range(rng.randint(2, 6)):
+            marker = ("%d." % (i + 1)) if ordered else rng.choice("-*+")
+            indent = "   " * depth if ordered else "  " * depth
+            out.append("%s%s %s\n" % (indent, marker,
+                                      inline_text(rng, rng.randint(3, 9))))
+            if depth < 3 and rng.random() < 0.3:
+                item_list(depth + 1, rng.random() < 0.4)
+    item_list(0, rng.random() < 0.5)
+    if rng.random() < 0.3:
+        out.append("\n")
+        out.append("1. %s\n\n   %s\n" % (sentence(rng), sentence(rng)))
+    out.append("\n")
+    return "".join(out)
+
+class Links:
+    def __init__(self):
+        self.nrefs = 0
+
+    def __call__(self, rng):
+        out = []
+        for _ in range(rng.randint(2, 5)):
+            r = rng.random()
+            w = words(rng, rng.randint(1, 3))
+            if r < 0.3:
+                out.append("[%s](http://example.com/%s \"%s\")" %
+                           (w, rng.choice(WORDS), rng.choice(WORDS)))
+            elif r < 0.6:
+                self.nrefs += 1
+                out.append("[%s][ref%d]" % (w, self.nrefs))
+            elif r < 0.75:
+                out.append("<http://example.org/%s?q=%d>" %
+                           (rng.choice(WORDS), rng.randint(0, 999)))
+            elif r < 0.85:
+                out.append("![%s](/img/%s.png)" % (w, rng.choice(WORDS)))
+            else:
+                # A shortcut reference that is never defined.
+                out.append("[%s]" % w)
+            out.append(" " + words(rng, rng.randint(2, 6)) + " ")
+        return "".join(out).strip() + "\n\n"
+
+    def definitions(self):
+        return "".join("[ref%d]: http://example.net/ref/%d \"Ref %d\"\n" %
+                       (i, i, i) for i in range(1, self.nrefs + 1))
+
+def code(rng):
+    r = rng.random()
+    if r < 0.4:
+        body = "\n".join("    " * rng.randint(0, 2) + words(rng, 5) + ";"
+                         for _ in range(rng.randint(3, 12)))
+        fence = rng.choice(["```", "~~~"])
+        return "%s%s\n%s\n%s\n\n" % (fence, rng.choice(LANGS), body, fence)
+    elif r < 0.7:
+        body = "\n".join("    " + words(rng, 6)
+                         for _ in range(rng.randint(2, 8)))
+        return body + "\n\n"
+    else:
+        spans = " ".join("%s `%s` and ``%s ` %s``" %
+                         (words(rng, 3), rng.choice(WORDS),
+                          rng.choice(WORDS), rng.choice(WORDS))
+                         for _ in range(rng.randint(2, 5)))
+        return spans + "\n\n"
+
+def entities(rng):
+    out = []
+    for _ in range(rng.randint(10, 30)):
+        r = rng.random()
+        if r < 0.4:
+            out.append(rng.choice(ENTITIES))
+        elif r < 0.6:
+            out.append(rng.choice(ESCAPES))
+        else:
+            out.append(rng.choice(WORDS))
+    return " ".join(out) + "\n\n"
+
+def nested(rng):
+    depth = rng.randint(1, 12)
+    out = []
+    for d in range(depth):
+        prefix = "> " * (d + 1)
+        out.append(prefix + inline_text(rng, 6) + "\n")
+        if rng.random() < 0.3:
+            out.append(prefix + "- " + "*" * (d % 3 + 1) + words(rng, 3) +
+                       "*" * (d % 3 + 1) + "\n")
+    emph = rng.randint(2, 20)
+    out.append("\n" + "*a **a " * emph + "b" + " a** a*" * emph + "\n\n")
+    return "".join(out)
+
+# The shapes of test/pathological_tests.py, repeated up to the size,
+# with a maximum repeat count for each. The nesting depth is limited,
+# as the XML renderer's indentation grows quadratically with it. The
+# backtick runs grow quadratically with their count, which is derived
+# from the shape's share of the size instead.
+PATHOLOGICAL = [
+    (lambda n: ("*a **a " * n) + "b" + (" a** a*" * n), 1000),
+    (lambda n: "a_ " * n, None),
+    (lambda n: "_a " * n, None),
+    (lambda n: "a]" * n, None),
+    (lambda n: "[a" * n, None),
+    (lambda n: "*a_ " * n, None),
+    (lambda n: "[ a_" * n, None),
+    (lambda n: ("[" * n) + "a" + ("]" * n), None),
+    (lambda n: ("> " * n) + "a", 1000),
+    (lambda n: "".join("e" + "`" * x for x in range(1, n)),
+     lambda share: int(math.sqrt(2 * share))),
+]
+
+class Pathological:
+    def __init__(self, size):
+        # Each shape gets an equal share, as a single paragraph.
+        self.share = max(size // len(PATHOLOGICAL), 1)
+        self.n = max(self.share // 8, 1)
+        self.i = 0
+
+    def __call__(self, rng):
+        shape, nmax = PATHOLOGICAL[self.i % len(PATHOLOGICAL)]
+        self.i += 1
+        if callable(nmax):
+            nmax = nmax(self.share)
+        n = self.n if nmax is None else min(self.n, nmax)
+        return shape(n) + "\n\n"
+
+KINDS = ["prose", "lists", "links", "code", "entities", "nested",
+         "pathological"]
+
+def generate(kind, size, seed):
+    rng = random.Random("%s:%d" % (kind, seed))
+    links = None
+    if kind == "links":
+        gen = links = Links()
+    elif kind == "pathological":
+        gen = Pathological(size)
+    else:
+        gen = globals()[kind]
+    out = []
+    nbytes = 0
+    while nbytes < size:
+        chunk = gen(rng)
+        out.append(chunk)
+        nbytes += len(chunk.encode("utf-8"))
+    if links is not None:
+        out.append("\n" + links.definitions())
+    return "".join(out)
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+            description='Generate synthetic benchmark corpora.')
+    parser.add_argument('--kind', dest='kinds', action='append',
+            choices=KINDS, help='corpus kind (default: all)')
+    parser.add_argument('--size', dest='size', type=int, default=1000000,
+            help='approximate size of each corpus in bytes')
+    parser.add_argument('--seed', dest='seed', type=int, default=1,
+            help='random seed')
+    parser.add_argument('--outdir', dest='outdir', default=None,
+            help='write KIND.md files here instead of to stdout')
+    args = parser.parse_args(sys.argv[1:])
+
+    for kind in args.kinds or KINDS:
+        text = generate(kind, args.size, args.seed).encode("utf-8")
+        if args.outdir is None:
+            sys.stdout.buffer.write(text)
+        else:
+            with open(os.path.join(args.outdir, kind + ".md"), "wb") as f:
+                f.write(text)
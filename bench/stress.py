@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Emphasis stress test: time cmark on delimiter-heavy inputs of growing
+# size, and check that the time grows linearly with the number of
+# delimiters.
+#
+# Each shape is run with --max delimiters, then halving down to --min.  The scaling exponent is estimated from the smallest and
+# the largest run: 1.0 is linear, 2.0 quadratic.  Exits with status 1
+# if any shape exceeds --max-exponent.
+
+import argparse
+import math
+import subprocess
+import sys
+import time
+
+# (name, function of n giving an input with about n delimiters, options)
+SHAPES = [
+    ("closers of length 1 after a ** opener",
+        lambda n: "a**b" + "c* " * n, []),
+    ("closers of length 2 after a * opener",
+        lambda n: "a*b" + "c** " * (n // 2), []),
+    ("mixed run lengths",
+        lambda n: "a*b" + "c** c* " * (n // 2), []),
+    ("openers with no closers",
+        lambda n: "_a " * n, []),
+    ("closers with no openers",
+        lambda n: "a_ " * n, []),
+    ("mismatched openers and closers",
+        lambda n: "*a_ " * (n // 2), []),
+    ("nested strong emph",
+        lambda n: "*a **a " * (n // 6) + "b" + " a** a*" * (n // 6), []),
+    ("smart quotes",
+        lambda n: "'a \"b " * (n // 2), ["--smart"]),
+]
+
+def run(program, text):
+    data = text.encode("utf-8")
+    start = time.perf_counter()
+    result = subprocess.run(program, input=data, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE)
+    elapsed = time.perf_counter() - start
+    if result.returncode != 0:
+        raise RuntimeError("%s exited with status %d: %s" %
+                           (" ".join(program), result.returncode,
+                            result.stderr.decode("utf-8", "replace")))
+    return elapsed
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+            description='Check that emphasis parsing scales linearly.')
+    parser.add_argument('--program', dest='program', default='build/src/cmark',
+            help='program to test, with options (default build/src/cmark)')
+    parser.add_argument('--min', dest='min', type=int, default=100000,
+            help='smallest number of delimiters')
+    parser.add_argument('--max', dest='max', type=int, default=10000000,
+            help='largest number of delimiters')
+    parser.add_argument('--max-exponent', dest='max_exponent', type=float,
+            default=1.3, help='largest acceptable scaling exponent')
+    args = parser.parse_args(sys.argv[1:])
+    program = args.program.split()
+
+    failed = 0
+    for name, shape, options in SHAPES:
+        print(name)
+        sizes = []
+        n = args.max
+        while n >= args.min:
+            sizes.insert(0, n)
+            n //= 2
+        runs = []
+        for n in sizes:
+            seconds = run(program + options, shape(n))
+            runs.append((n, seconds))
+            print("  %10d delimiters %8.3f s %8.1f ns/delimiter" %
+                  (n, seconds, seconds * 1e9 / n))
+        if len(runs) < 2:
+            continue
+        (n0, t0), (n1, t1) = runs[0], runs[-1]
+        exponent = math.log(max(t1, 1e-6) / max(t0, 1e-6)) / math.log(n1 / n0)
+        ok = exponent <= args.max_exponent
+        print("  scaling exponent %.2f [%s]" %
+              (exponent, "PASSED" if ok else "FAILED"))
+        if not ok:
+            failed += 1
+
+    print("%d shapes, %d failed" % (len(SHAPES), failed))
+    sys.exit(1 if failed else 0)
@@ -5,52 +5,44 @@
 #endif
 
 #include <stdio.h>
+#define ESIS_XMLPARSE
 #include <esisio.h>
-#include <xmlparse.h>
 
 int
 main(int argc, char *argv[])
 {
-  int done;
-  char buf[BUFSIZ];
-  FILE *infile, *outfile;
-  
   XML_Parser parser = XML_ParserCreate(NULL);
-  ESIS_Writer writer = ESIS_WriterCreate(stdout, 0U);
-  
-  if (argc == 2) {
-    infile = fopen(argv[1], "r");
-    if (infile == NULL) {
-      perror(argv[1]);
-      return 1;
-    }
-  } else 
-    infile = stdin;
-    
-  outfile = stdout;
-  
-  XML_SetUserData(parser, writer);
-  XML_SetElementHandler(parser,
-      ESIS_Start,
-      ESIS_End);
-  XML_SetCharacterDataHandler(parser,
-      (XML_CharacterDataHandler)ESIS_Cdata);
+  ESIS_Parser eparser = ESIS_XmlParserCreate(parser);
+  int ok;
   
-  do {
-    size_t len = fread(buf, 1, sizeof(buf), infile);
-    done = len < sizeof(buf);
+  /*
+   * No element handlers: a named input file is mapped into memory and
+   * parsed by Expat in place, standard input is read in large blocks
+   * directly into Expat's buffer. All elements are written as ESIS
+   * text.
+   */
+  if (argc == 2)
+    ok = ESIS_FilterFileName(eparser, argv[1], stdout);
+  else
+    ok = ESIS_FilterFile(eparser, stdin, stdout);
     
-    if (XML_Parse(parser, buf, (int)len, done) == 0) {
+  if (!ok) {
+    if (XML_GetErrorCode(parser) != XML_ERROR_NONE)
       fprintf(stderr,
               "%s at line %d\n",
               XML_ErrorString(XML_GetErrorCode(parser)),
               XML_GetCurrentLineNumber(parser));
-      return 1;
-    }
-  } while (!done);
+    else if (argc == 2 &&
+             ESIS_GetParserError(eparser) == ESIS_ERROR_FILE_READ)
+      perror(argv[1]);
+    else
+      fprintf(stderr, "ESIS error %d reading input\n",
+              (int)ESIS_GetParserError(eparser));
+  }
   
+  /* Also unmaps the input file, kept mapped for the error position. */
+  ESIS_ParserFree(eparser);
   XML_ParserFree(parser);
-  ESIS_WriterFree(writer);
   
-  return 0;
+  return !ok;
 }
@@ -210,27 +210,31 @@ ESIS_Bool handler(void               *userData,
 
 int main(int argc, char *argv[])
 {
-  int i, j;
+  int i, j, k, ok;
+  const char *infile = NULL;
   unsigned options = 0U;
   enum { t_sgml, t_html, t_xhtml, t_xml } format = t_xml;
   
   xml = ESIS_TRUE, trans = ESIS_FALSE;
   
-  if (argc == 2)
-    if (strcmp(argv[1], "-sgml") == 0) {
+  for (k = 1; k < argc; ++k)
+    if (strcmp(argv[k], "-sgml") == 0) {
       xml = ESIS_FALSE, trans = ESIS_FALSE;
       format = t_sgml;
-    } else if (strcmp(argv[1], "-html") == 0) {
+    } else if (strcmp(argv[k], "-html") == 0) {
       xml = ESIS_FALSE, trans = ESIS_TRUE;
       format = t_html;
-    } else if (strcmp(argv[1], "-xml") == 0) {
+    } else if (strcmp(argv[k], "-xml") == 0) {
       xml = ESIS_TRUE, trans = ESIS_FALSE;
       format = t_xml;
-    } else if (strcmp(argv[1], "-xhtml") == 0) {
+    } else if (strcmp(argv[k], "-xhtml") == 0) {
       xml = ESIS_TRUE, trans = ESIS_TRUE;
       format = t_xhtml;
+    } else if (argv[k][0] != '-' && infile == NULL) {
+      infile = argv[k];
     } else {
-      fputs("Usage: argv[0] [-sgml | -html | -xml | -xhtml]\n", stderr);
+      fputs("Usage: argv[0] [-sgml | -html | -xml | -xhtml] [file]\n",
+                                                                 stderr);
       return 1;
     }
     
@@ -283,7 +287,15 @@ int main(int argc, char *argv[])
     break;
   }
   
-  if (ESIS_ParseFile(parser, stdin) == 0) {
+  /*
+   * A named input file is mapped into memory and scanned in place.
+   */
+  if (infile != NULL)
+    ok = ESIS_ParseFileName(parser, infile);
+  else
+    ok = ESIS_ParseFile(parser, stdin);
+    
+  if (!ok) {
     ESIS_Error err = ESIS_GetParserError(parser);
     fprintf(stderr, "ESIS_Error: %d\n", (int)err);
   }
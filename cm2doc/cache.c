@@ -0,0 +1,231 @@
+/*== cache.c ===========================================================*
+
+    cache - Compiled forms of replacement definitions and digraphs
+
+    See "cache.h".
+
+------------------------------------------------------------------------
+
+COPYRIGHT NOTICE AND LICENSE
+
+Copyright (C) 2015 Martin Hofmann <mh@tin-pot.net>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   1. Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copy-
+      right notice, this list of conditions and the following dis-
+      claimer in the documentation and/or other materials provided
+      with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLU-
+DING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*=====================================================================*/
+
+#ifdef _MSC_VER
+#pragma warning (disable: 4996)
+#endif
+
+#include "cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <process.h>  /* _getpid() */
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*== Checksum ========================================================*/
+
+#define ADLER_MOD  65521UL
+#define ADLER_NMAX  5552U /* Max. bytes before the sums can overflow. */
+
+uint32_t cache_checksum(const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    uint32_t a = 1U, b = 0U;
+
+    while (len > 0U) {
+	size_t n = (len < ADLER_NMAX) ? len : ADLER_NMAX;
+	len -= n;
+	while (n-- > 0U) {
+	    a += *p++;
+	    b += a;
+	}
+	a %= ADLER_MOD;
+	b %= ADLER_MOD;
+    }
+    return (b << 16) | a;
+}
+
+/*== Header ==========================================================*/
+
+const void *cache_image(const void *data, size_t size, const char *magic,
+                        uint32_t srcsum, uint32_t srclen,
+                        size_t *pimgsize)
+{
+    cache_header hdr;
+    const char *img;
+
+    if (data == NULL || size < sizeof hdr)
+	return NULL;
+
+    /*
+     * The mapped data is suitably aligned, but don't count on it.
+     */
+    memcpy(&hdr, data, sizeof hdr);
+    img = (const char *)data + sizeof hdr;
+
+    if (memcmp(hdr.magic, magic, sizeof hdr.magic) != 0 ||
+            hdr.version   != CACHE_VERSION   ||
+            hdr.byteorder != CACHE_BYTEORDER ||
+            hdr.srcsum    != srcsum          ||
+            hdr.srclen    != srclen          ||
+            hdr.size      != size - sizeof hdr ||
+            hdr.sum       != cache_checksum(img, hdr.size))
+	return NULL;
+
+    *pimgsize = hdr.size;
+    return img;
+}
+
+int cache_write(const char *pathname, const char *magic,
+                uint32_t srcsum, uint32_t srclen,
+                const void *img, size_t size)
+{
+    cache_header hdr;
+    char *tmpname;
+    FILE *fp;
+    int rc = 0;
+
+    memset(&hdr, 0, sizeof hdr);
+    memcpy(hdr.magic, magic, sizeof hdr.magic);
+    hdr.version   = CACHE_VERSION;
+    hdr.byteorder = CACHE_BYTEORDER;
+    hdr.srcsum    = srcsum;
+    hdr.srclen    = srclen;
+    hdr.size      = (uint32_t)size;
+    hdr.sum       = cache_checksum(img, size);
+
+    tmpname = malloc(strlen(pathname) + 32U);
+    if (tmpname == NULL)
+	return -1;
+    sprintf(tmpname, "%s.%lu", pathname, (unsigned long)getpid());
+
+    if ((fp = fopen(tmpname, "wb")) == NULL) {
+	free(tmpname);
+	return -1;
+    }
+    if (fwrite(&hdr, sizeof hdr, 1U, fp) != 1U ||
+                            fwrite(img, 1U, size, fp) != size)
+	rc = -1;
+    if (fclose(fp) != 0)
+	rc = -1;
+
+    if (rc == 0 && rename(tmpname, pathname) != 0) {
+#ifdef _WIN32
+	/*
+	 * Windows does not replace an existing file.
+	 */
+	remove(pathname);
+	if (rename(tmpname, pathname) != 0)
+#endif
+	    rc = -1;
+    }
+    if (rc != 0)
+	remove(tmpname);
+
+    free(tmpname);
+    return rc;
+}
+
+/*== Mapping =========================================================*/
+
+void *cache_map(const char *pathname, size_t *psize)
+{
+#ifndef _WIN32
+    struct stat st;
+    void *data;
+    int fd;
+
+    if ((fd = open(pathname, O_RDONLY)) < 0)
+	return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+	close(fd);
+	return NULL;
+    }
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+	return NULL;
+
+    *psize = (size_t)st.st_size;
+    return data;
+#else
+    FILE *fp;
+    char *data = NULL;
+    long size;
+
+    if ((fp = fopen(pathname, "rb")) == NULL)
+	return NULL;
+    if (fseek(fp, 0L, SEEK_END) == 0 && (size = ftell(fp)) > 0L &&
+            fseek(fp, 0L, SEEK_SET) == 0 &&
+            (data = malloc((size_t)size)) != NULL &&
+            fread(data, 1U, (size_t)size, fp) != (size_t)size) {
+	free(data);
+	data = NULL;
+    }
+    fclose(fp);
+
+    if (data != NULL)
+	*psize = (size_t)size;
+    return data;
+#endif
+}
+
+void cache_unmap(void *data, size_t size)
+{
+    if (data == NULL)
+	return;
+#ifndef _WIN32
+    munmap(data, size);
+#else
+    (void)size;
+    free(data);
+#endif
+}
+
+char *cache_pathname(const char *srcname)
+{
+    char *pathname = malloc(strlen(srcname) + sizeof CACHE_SUFFIX);
+
+    if (pathname != NULL) {
+	strcpy(pathname, srcname);
+	strcat(pathname, CACHE_SUFFIX);
+    }
+    return pathname;
+}
+
+/*== EOF ============================ vim:tw=72:sts=0:et:cin:fo=croq:sta
+                                               ex: set ts=8 sw=4 ai : */
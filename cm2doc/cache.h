@@ -0,0 +1,80 @@
+/* cache.h */
+
+#ifndef CACHE_H_INCLUDED
+#define CACHE_H_INCLUDED 1
+
+/*
+ * cache --
+ *
+ *     Compiled ("binary") forms of the replacement definitions and of
+ *     the digraph tables, stored next to their source files.
+ *
+ * A cache file starts with a `cache_header`, followed by the image
+ * proper. The header records the checksum and length of the *source*
+ * file the image was compiled from, so a cache file is only used
+ * while its source file is unchanged.
+ *
+ * The images are in the native byte order and struct layout: they
+ * are meant for the machine that wrote them, not for distribution.
+ * The `byteorder` member and the version number catch the obvious
+ * mismatches.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define CACHE_VERSION    2U
+#define CACHE_BYTEORDER  0x01020304UL
+#define CACHE_SUFFIX     ".cache"
+
+#define CACHE_MAGIC_REPL "CM2DOC\0R" /* Replacement definitions. */
+#define CACHE_MAGIC_DGR  "CM2DOC\0D" /* Digraph table. */
+
+typedef struct cache_header_ {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byteorder;
+    uint32_t srcsum;    /* Checksum of the source file. */
+    uint32_t srclen;    /* Length of the source file. */
+    uint32_t size;      /* Length of the image following the header. */
+    uint32_t sum;       /* Checksum of the image. */
+} cache_header;
+
+/*
+ * Adler-32 checksum (RFC 1950) of a byte array.
+ */
+uint32_t    cache_checksum(const void *data, size_t len);
+
+/*
+ * Check the header at the start of a cache file `size` bytes long, and
+ * return a pointer to the image following it -- or NULL if the cache
+ * file is invalid, or was not compiled from the given source.
+ */
+const void *cache_image(const void *data, size_t size, const char *magic,
+                        uint32_t srcsum, uint32_t srclen,
+                        size_t *pimgsize);
+
+/*
+ * Write a cache file containing the image in `img` (of `size`
+ * bytes) to `pathname`. The file is written under a temporary name
+ * first and then renamed, so concurrent readers never see a partial
+ * cache file. Returns 0 on success.
+ */
+int         cache_write(const char *pathname, const char *magic,
+                        uint32_t srcsum, uint32_t srclen,
+                        const void *img, size_t size);
+
+/*
+ * Map (or read) a whole file into memory; NULL if this fails.
+ */
+void       *cache_map(const char *pathname, size_t *psize);
+void        cache_unmap(void *data, size_t size);
+
+/*
+ * The name of the cache file for a source file: a new string from
+ * `malloc()`.
+ */
+char       *cache_pathname(const char *srcname);
+
+#endif/*CACHE_H_INCLUDED*/
@@ -0,0 +1,145 @@
+/* cm2doc.h */
+
+#ifndef CM2DOC_H_INCLUDED
+#define CM2DOC_H_INCLUDED 1
+
+/*
+ * cm2doc --
+ *
+ *     The "replacement backend" of `cm2doc` as a library: CommonMark
+ *     documents are parsed by `libcmark` and rendered into an output
+ *     document under control of "replacement definitions" loaded
+ *     from replacement files.
+ *
+ * The replacement definitions are compiled into a `cm2doc_rules`
+ * object, which is loaded once and is *never* modified while
+ * documents are rendered. All per-document state -- the cmark parser,
+ * the attribute stack of the currently open elements, and the output
+ * state -- lives in a `cm2doc_ctx` object.
+ *
+ * Thus any number of threads can render documents concurrently, each
+ * one using its own `cm2doc_ctx`, and all of them sharing the same
+ * `cm2doc_rules`:
+ *
+ *     cm2doc_rules *rules = cm2doc_rules_new();
+ *     cm2doc_rules_load(rules, replfp, "html.repl");
+ *
+ *     ... in each thread:
+ *
+ *     cm2doc_ctx *ctx = cm2doc_ctx_new(rules, 0U, options, outfp);
+ *     cm2doc_feed(ctx, text, len);
+ *     cm2doc_finish(ctx);
+ *     cm2doc_ctx_free(ctx);
+ *
+ * A context can be re-used for any number of (consecutive) documents:
+ * `cm2doc_finish()` leaves it ready for the next one.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "cmark.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cm2doc_rules_ cm2doc_rules;
+typedef struct cm2doc_ctx_   cm2doc_ctx;
+
+/*
+ * Replacement definitions.
+ *
+ * Loading several replacement files into the same `cm2doc_rules`
+ * is equivalent to loading the concatenation of these files.
+ *
+ * `cm2doc_rules_load()` reports syntax errors on `stderr` (using
+ * `filename` in the diagnostics), and returns the number of errors.
+ *
+ * All replacement files must be loaded before the first context
+ * using the rules is created.
+ */
+
+cm2doc_rules *cm2doc_rules_new(void);
+unsigned      cm2doc_rules_load(cm2doc_rules *, FILE *replfp,
+                                                  const char *filename);
+void          cm2doc_rules_free(cm2doc_rules *);
+
+/*
+ * Compiled replacement definitions.
+ *
+ * `cm2doc_rules_image()` returns a binary image of the rules (in a
+ * buffer from `malloc()`), and `cm2doc_rules_load_image()` adds the
+ * rules in such an image to `rules` -- with the same effect as
+ * loading the replacement files the image was made from. It returns
+ * 0 on success, and -1 if the image is invalid (in which case `rules`
+ * may have been partially modified).
+ */
+void         *cm2doc_rules_image(const cm2doc_rules *, size_t *psize);
+int           cm2doc_rules_load_image(cm2doc_rules *,
+                                      const void *image, size_t size);
+
+/*
+ * Rendering context flags: Produce RAST output (ISO/IEC 13673:2000)
+ * instead of using replacement definitions, and optionally include
+ * the internal root element in the RAST output.
+ */
+#define CM2DOC_RAST      0x0001U
+#define CM2DOC_RAST_ALL  0x0002U
+
+/*
+ * The output sink: called with chunks of the rendered output, it must
+ * return the number of bytes written (anything less than `len` is
+ * counted as an error).
+ */
+typedef size_t (cm2doc_write_fn)(void *userdata,
+                                 const char *data, size_t len);
+
+/*
+ * Create a rendering context writing into `outfp`, or into the
+ * given output sink.
+ *
+ * The output is buffered in the context, and handed to the sink in
+ * large chunks, and at the end of each document.
+ *
+ * The `rules` can be NULL only when rendering RAST output.
+ */
+cm2doc_ctx *cm2doc_ctx_new(const cm2doc_rules *rules, unsigned flags,
+                           cmark_option_t options, FILE *outfp);
+cm2doc_ctx *cm2doc_ctx_new_sink(const cm2doc_rules *rules,
+                                unsigned flags, cmark_option_t options,
+                                cm2doc_write_fn *sink, void *userdata);
+void        cm2doc_ctx_free(cm2doc_ctx *);
+
+/*
+ * Set "pseudo-attributes" for the document (see `DC.title` etc.).
+ *
+ * Both arguments are NULL-terminated arrays of name/value pairs (or
+ * NULL): the `defaults` are overridden by the meta-data lines in
+ * the document header, which in turn are overridden by `meta`.
+ *
+ * The strings are *not* copied: they must stay valid as long as the
+ * context is used.
+ */
+void        cm2doc_ctx_set_meta(cm2doc_ctx *,
+                                const char *const defaults[],
+                                const char *const meta[]);
+
+/*
+ * Feed the next chunk of CommonMark input text. Chunks can be of any
+ * size, and split the input anywhere (even the meta-data lines).
+ */
+void        cm2doc_feed(cm2doc_ctx *, const char *data, size_t len);
+
+/*
+ * Finish parsing, render the document into the output stream, and
+ * reset the context for the next document. Returns the number of
+ * errors (eg undefined attributes) encountered while rendering.
+ */
+unsigned    cm2doc_finish(cm2doc_ctx *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif/*CM2DOC_H_INCLUDED*/
@@ -28,7 +28,6 @@
 #define snprintf _snprintf
 #endif
 
-#define NDIGRAPH 1000
 
 #define PRG "escape"
 
@@ -139,17 +138,28 @@ static void error(int errnum, const char *msg, ...)
 #define MKOI(I, L) ( ((L) << 13) | ((I) & IDXMAX) )
 
 /*
- * A one-character "digraph" simply has ch[1] == NUL.
+ * The digraph table is indexed directly by the two characters, which
+ * are in SP .. DEL-1; a one-character "digraph" has ch[1] == NUL,
+ * and uses the column of SP. An entry of 0 is "undefined", which no
+ * `MKOI(I, L)` with L > 0 can be.
  */
-struct dgr_ {
-    char       ch[2];
-    uint16_t   oi;
+#define NDGRCH      96
+#define ISDGRCH(C)  ( SP <= (C) && (C) < SP + NDGRCH )
+#define DGRCOL(C)   ( ((C) == NUL) ? 0U : (unsigned)(C) - SP )
+
+/*
+ * The states of the transducer in `esc_feed()`.
+ */
+enum {
+    ST_OUTSIDE,   ST_ESCAPE,   ST_BMP,    ST_UCS,	    ST_SUBST,
+    ST_SUB_GRP,   ST_SUB_PAR,
+    ST_UNI,       ST_DGR0,     ST_DGR,    ST_CODE,      ST_CALLBACK,
+    ST_INVALID
 };
 
 struct esc_state_ {
     unsigned        ndgr;
-    struct dgr_    *dgrs;
-    char           *defs;
+    uint16_t        dgrtab[NDGRCH][NDGRCH];
     char            escape;
     char            subst;
     esc_cb          cb;
@@ -158,8 +168,11 @@ struct esc_state_ {
     const char     *nmstart;
     const char     *nmchar;
     
-    octetbuf dgrs_buf; /* = {0}; */
-    octetbuf octs_buf; /* = {0}; */
+    int             st;     /* Transducer state between feeds, */
+    unsigned        nseq;   /* and the pending escape sequence. */
+    char            seq[SEQMAX];
+    
+    octetbuf octs_buf;
 };
 
 int esc_set_escape(esc_state *esp, int ch)
@@ -199,23 +212,19 @@ void esc_nmchar(esc_state *esp, const char *chars)
     esp->nmchar = chars;
 }
 
-int cmpdgr(const void *lhs, const void *rhs)
-{
-    const struct dgr_ *const ldgr = (struct dgr_*)lhs;
-    const struct dgr_ *const rdgr = (struct dgr_*)rhs;
-    int d;
-    
-    (d = ldgr->ch[0] - rdgr->ch[0]) || 
-    (d = ldgr->ch[1] - rdgr->ch[1]);
-    return d;
-}
-
 int esc_define(esc_state *esp, const char ch[2], const long ucsdef[])
 {
     octetidx_t  oi;
-    struct dgr_ dgr;
     char        u8seq[U8_LEN_MAX];
     size_t      u8nseq;
+    unsigned char c0 = ch[0];
+    unsigned char c1 = (ch[1] == SP) ? NUL : ch[1];
+    
+    if (!ISDGRCH(c0) || (c1 != NUL && !ISDGRCH(c1))) {
+	error(ESC_ERR_DGR_LINEFORMAT, "Invalid digraph: %c%c\n",
+	                                                   ch[0], ch[1]);
+	return -1;
+    }
     
     u8nseq = xctomb(u8seq, ucsdef[0]);
     if (u8nseq == (size_t)-1) {
@@ -234,19 +243,18 @@ int esc_define(esc_state *esp, const char ch[2], const long ucsdef[])
 #endif
 
     oi = octetbuf_push_back(&esp->octs_buf, u8seq, u8nseq);
+    assert(oi <= IDXMAX);
 
-    dgr.ch[0] =  ch[0];
-    dgr.ch[1] = (ch[1] == SP) ? NUL : ch[1];
-    dgr.oi    = MKOI(oi, 1U);
-
-    assert(LEN(dgr.oi) == 1U);
-    assert(IDX(dgr.oi) == oi);
+    if (esp->dgrtab[c0 - SP][DGRCOL(c1)] == 0U)
+	++esp->ndgr;
+    esp->dgrtab[c0 - SP][DGRCOL(c1)] = MKOI(oi, 1U);
 
-    octetbuf_push_back(&esp->dgrs_buf, &dgr, sizeof dgr);
+    assert(LEN(esp->dgrtab[c0 - SP][DGRCOL(c1)]) == 1U);
+    assert(IDX(esp->dgrtab[c0 - SP][DGRCOL(c1)]) == oi);
     return 0;
 }
 
-int readline(esc_state *esp, FILE *infp, char dgr[2], xchar_t *ucs)
+int readline(esc_state *esp, FILE *infp, char dgr[2], long *ucs)
 {
     int ch1, ch;
     bool valid = false;
@@ -266,6 +274,7 @@ int readline(esc_state *esp, FILE *infp, char dgr[2], xchar_t *ucs)
 	    error(ESC_ERR_DGR_LINEFORMAT, "Line %u: invalid.\n", esp->lno);
 	/* FALLTHROUGH */
     case '#': default:
+	++esp->lno;
 	if (ch1 != '#' && ch1 != SP)
 	    error(ESC_ERR_DGR_LINETYPE, "Line %u: '%c' invalid.\n", esp->lno, ch1);
 	while ((ch = getc(infp)) != EOF && ch != LF)
@@ -278,18 +287,22 @@ int readline(esc_state *esp, FILE *infp, char dgr[2], xchar_t *ucs)
 esc_state *esc_create(FILE *infp)
 {
     char           ch[2];
-    unsigned long  cp[2];
+    long           cp[2];
     
-    struct esc_state_   es = { 0 };
-    struct esc_state_ *esp = NULL;
+    struct esc_state_ *esp = calloc(1U, sizeof *esp);
     
-    es.nmstart = NMSTRT;
-    es.nmchar  = NMCHAR;
-    es.escape  = ESCAPE;
-    es.subst   = SUBST;
+    if (esp == NULL)
+	return NULL;
+	
+    esp->nmstart = NMSTRT;
+    esp->nmchar  = NMCHAR;
+    esp->escape  = ESCAPE;
+    esp->subst   = SUBST;
+    esp->st      = ST_OUTSIDE;
+    octetbuf_init(&esp->octs_buf, 0U);
     
     if (infp == NULL)
-	goto create;
+	return esp;
 	
     while (readline(esp, infp, ch, cp) != EOF) {
 #if !defined(NDEBUG)
@@ -298,41 +311,86 @@ esc_state *esc_create(FILE *infp)
 	assert(IS646INV(ch[1]) || ch[1] == SP);
 #endif
 	cp[1] = 0U;
-	esc_define(&es, ch, cp);
+	esc_define(esp, ch, cp);
     }
     
-    es.ndgr   = octetbuf_size(&es.dgrs_buf)/sizeof(struct dgr_);
-    es.dgrs   = octetbuf_release(&es.dgrs_buf);
-    es.defs   = octetbuf_release(&es.octs_buf);
-    qsort(es.dgrs, es.ndgr, sizeof es.dgrs[0], cmpdgr);
-    
 #ifndef NDEBUG
-    fprintf(stderr, "%s: %u digraphs defined.\n", PRG, es.ndgr);
+    fprintf(stderr, "%s: %u digraphs defined.\n", PRG, esp->ndgr);
 #endif
-create:
-    esp = malloc(sizeof es);
-    if (esp != NULL)
-	memcpy(esp, &es, sizeof es);
+    return esp;
+}
+
+void esc_free(esc_state *esp)
+{
+    if (esp == NULL)
+	return;
+    octetbuf_fini(&esp->octs_buf);
+    free(esp);
+}
+
+/*
+ * The binary image of the digraph table, as (native) `uint32_t`
+ * and the arrays:
+ *
+ *     ndgr, ndefs, dgrtab[NDGRCH][NDGRCH], defs[ndefs]
+ *
+ * The table is used as is.
+ */
+ 
+void *esc_image(const esc_state *esp, size_t *psize)
+{
+    uint32_t hdr[2];
+    char *img;
+    
+    hdr[0] = esp->ndgr;
+    hdr[1] = (uint32_t)octetbuf_size(&esp->octs_buf);
+    *psize = sizeof hdr + sizeof esp->dgrtab + hdr[1];
+    
+    if ((img = malloc(*psize)) != NULL) {
+	memcpy(img, hdr, sizeof hdr);
+	memcpy(img + sizeof hdr, esp->dgrtab, sizeof esp->dgrtab);
+	memcpy(img + sizeof hdr + sizeof esp->dgrtab,
+	                              octetbuf_ptr(&esp->octs_buf), hdr[1]);
+    }
+    return img;
+}
+
+esc_state *esc_create_image(const void *img, size_t size)
+{
+    const char *p = img;
+    uint32_t hdr[2];
+    esc_state *esp;
+    
+    if (size < sizeof hdr)
+	return NULL;
+    memcpy(hdr, p, sizeof hdr);
+    if (size != sizeof hdr + sizeof esp->dgrtab + hdr[1])
+	return NULL;
+	
+    if ((esp = esc_create(NULL)) == NULL)
+	return NULL;
+	
+    p += sizeof hdr;
+    esp->ndgr = hdr[0];
+    memcpy(esp->dgrtab, p, sizeof esp->dgrtab);
+    octetbuf_push_back(&esp->octs_buf, p + sizeof esp->dgrtab, hdr[1]);
     return esp;
 }
 
 size_t esc_expand(esc_state *esp, char buf[5], const char ch[2])
 {
-    struct dgr_ dgr, *pdgr;
+    unsigned char c0 = ch[0], c1 = ch[1];
     const char *u8seq;
     size_t u8nseq, nuc;
+    uint16_t oi;
     
-    dgr.ch[0] = ch[0];
-    dgr.ch[1] = ch[1];
-    
-    pdgr = bsearch(&dgr, esp->dgrs, esp->ndgr,
-                                           sizeof esp->dgrs[0], cmpdgr);
-                   
-    if (pdgr == NULL)
+    if (!ISDGRCH(c0) || (c1 != NUL && !ISDGRCH(c1)))
+	return (size_t)-1;
+    if ((oi = esp->dgrtab[c0 - SP][DGRCOL(c1)]) == 0U)
 	return (size_t)-1;
 	
-    u8seq  = esp->defs + IDX(pdgr->oi);
-    nuc = LEN(pdgr->oi);
+    u8seq  = (const char *)octetbuf_begin(&esp->octs_buf) + IDX(oi);
+    nuc = LEN(oi);
     assert(nuc == 1U);
     u8nseq = u8len(u8seq, U8_LEN_MAX);
     
@@ -341,27 +399,53 @@ size_t esc_expand(esc_state *esp, char buf[5], const char ch[2])
     return u8nseq;
 }
 
-size_t esc_bsubst(esc_state *esp, octetbuf *dst, octetbuf *src)
+/*
+ * Call back for a variable substitution in `seq`, and output the
+ * result. Returns false if there is none.
+ */
+static bool subst_cb(esc_state *esp, const char *seq, esc_out *out,
+                                                           void *ud)
 {
-    const unsigned char *p, *begin, *end;
-    enum { 
-	ST_OUTSIDE,   ST_ESCAPE,   ST_BMP,    ST_UCS,	    ST_SUBST,
-	ST_SUB_GRP,   ST_SUB_PAR,
-	ST_UNI,       ST_DGR0,	   ST_DGR,    ST_CODE,      ST_CALLBACK,
-	ST_INVALID
-    } st = ST_OUTSIDE;
+    const char *sub = NULL;
     
-    char          seq[SEQMAX], u8seq1[U8_LEN_MAX], u8seq2[U8_LEN_MAX];
-    unsigned      nseq = 0U, u8nseq1 = 0U, u8nseq2 = 0U;
+    if (esp->cb != NULL && seq[1] != NUL)
+	sub = esp->cb(seq+1);
+    if (sub != NULL)
+	out(ud, sub, strlen(sub));
+    return sub != NULL;
+}
+
+/*
+ * The transducer: it copies runs of plain text directly from `data`
+ * to the output, and keeps an escape sequence which is incomplete at
+ * the end of `data` in the state for the next call.
+ */
+
+void esc_feed(esc_state *esp, const char *data, size_t len,
+                                             esc_out *out, void *ud)
+{
+    const unsigned char *p, *end;
+    const char   *run = data; /* Pending plain text up to `p`. */
+    int           st   = esp->st;
+    unsigned      nseq = esp->nseq;
+    char         *seq  = esp->seq;
+    char          u8seq1[U8_LEN_MAX], u8seq2[U8_LEN_MAX];
+    size_t        u8nseq1, u8nseq2;
     char          dgr[2];
     const char    escape = esp->escape;
     const char    subst  = esp->subst;
     
-    begin = octetbuf_begin(src);
-    end   = octetbuf_end(src);
-    for (p = begin; p < end; ++p) {
+    end = (const unsigned char *)data + len;
+    for (p = (const unsigned char *)data; p < end; ++p) {
 	unsigned char ch = *p;
 	
+	if (st == ST_OUTSIDE) {
+	    if (ch != escape && ch != subst)
+		continue;
+	    if ((const char *)p > run)
+		out(ud, run, (const char *)p - run);
+	}
+	
 	switch (st) {
 	    case ST_OUTSIDE:
 		if (ch == escape)
@@ -455,18 +539,19 @@ size_t esc_bsubst(esc_state *esp, octetbuf *dst, octetbuf *src)
 
 		assert(IS646INV(dgr[0]) || dgr[0] == SP);
 		u8nseq1 = esc_expand(esp, u8seq1, dgr);
+		u8nseq2 = (size_t)-1;
 
 		if (IS646INV(ch)) {
 		    dgr[1] = seq[nseq++] = ch;
 		    u8nseq2 = esc_expand(esp, u8seq2, dgr);
-		    if (u8nseq1 == -1)
+		    if (u8nseq1 == (size_t)-1)
 			ch = NUL;
 		}
 		st = ST_OUTSIDE;
-		if (u8nseq2 != -1)
-		    ch = NUL, octetbuf_push_back(dst, u8seq2, u8nseq2);
-		else if (u8nseq1 != -1)
-		    octetbuf_push_back(dst, u8seq1, u8nseq1);
+		if (u8nseq2 != (size_t)-1)
+		    ch = NUL, out(ud, u8seq2, u8nseq2);
+		else if (u8nseq1 != (size_t)-1)
+		    out(ud, u8seq1, u8nseq1);
 		else
 		    st = ST_INVALID;
 		break;
@@ -476,83 +561,91 @@ size_t esc_bsubst(esc_state *esp, octetbuf *dst, octetbuf *src)
 	}
 	
 	if (st == ST_CODE) {
-	    xchar_t ucs;
-	    int sn, d = U8_LEN_MAX;
+	    unsigned long ucs;
+	    int sn;
 	    size_t u8n;
-	    octet *op;
 	    
 	    seq[nseq] = NUL;
 	    assert(isxdigit(seq[2]));
 	    sn = sscanf(seq+2, "%lx", &ucs);
 	    assert(sn == 1);
-	    op = octetbuf_extend(dst, d);
 	    errno = 0;
-	    u8n = xctomb(op, ucs);
+	    u8n = xctomb(u8seq1, (xchar_t)ucs);
 	    assert(u8n <= U8_LEN_MAX || errno == EILSEQ);
-	    if (u8n <= U8_LEN_MAX)
-		d -= u8n;
-	    if (errno == EILSEQ)
+	    if (errno == EILSEQ || u8n > U8_LEN_MAX)
 		st = ST_INVALID;
 	    else
-		ch = NUL;
-	    octetbuf_extend(dst, -d);
+		ch = NUL, out(ud, u8seq1, u8n);
 	} else if (st == ST_CALLBACK) {
-	    const char *sub = NULL;
 	    seq[nseq] = NUL;
 	    assert(nseq >= 2);
-	    if (esp->cb != NULL && seq[1] != NUL)
-		sub = esp->cb(seq+1);
-	    if (sub != NULL)
-		octetbuf_push_s(dst, sub);
-	    else
+	    if (!subst_cb(esp, seq, out, ud))
 		st = ST_INVALID;
-	    if (ch == ESC_GRPC || ch == ESC_PARC) {
+	    else if (ch == ESC_GRPC || ch == ESC_PARC)
 		ch = NUL;
-	    }
 	}
 	
 	if (st == ST_INVALID)
-	    octetbuf_push_back(dst, seq, nseq);
+	    out(ud, seq, nseq);
 	    
-	switch (st) case ST_INVALID: case ST_CODE: 
-	            case ST_CALLBACK: case ST_OUTSIDE: {
-	    nseq = 0U;
-	    st = ST_OUTSIDE;
-	    if (ch != NUL)
-		octetbuf_push_c(dst, ch);
+	/*
+	 * A character ending a sequence, but not part of it, is output
+	 * (as the start of the next run of plain text).
+	 */
+	switch (st) {
+	    case ST_INVALID: case ST_CODE: 
+	    case ST_CALLBACK: case ST_OUTSIDE:
+		nseq = 0U;
+		st = ST_OUTSIDE;
+		run = (const char *)p + (ch == NUL);
+		break;
+	    default:
+		run = (const char *)p + 1;
+		break;
 	}
     }
-    return octetbuf_shift(src, p-begin);
+    
+    if ((const char *)end > run)
+	out(ud, run, (const char *)end - run);
+	
+    esp->st   = st;
+    esp->nseq = nseq;
 }
 
-size_t esc_fsubst(esc_state *esp, char buffer[], size_t nbuffer, FILE *in)
+void esc_finish(esc_state *esp, esc_out *out, void *ud)
 {
-    static octetbuf dst = {0};
-    static octetbuf src = {0};
-    size_t nbuf  = nbuffer - 1U;
-    size_t nread = nbuf;
-    octet *pread;
-    int d;
+    char     *seq  = esp->seq;
+    unsigned  nseq = esp->nseq;
+    char      u8seq[U8_LEN_MAX];
+    size_t    u8nseq;
+    char      dgr[2];
     
-    octetbuf_reserve(&dst, nbuf);
-    octetbuf_reserve(&src, nbuf);
-    
-    while (octetbuf_size(&dst) < nbuf && nread == nbuf) {
-	pread = octetbuf_extend(&src, (int)nbuf);
-        octetbuf_lock(&src);
-	nread = fread(pread, 1U, nbuf, in);
-	if ((d = nbuf - nread) > 0)
-	    pread = octetbuf_extend(&src, -d);
-	esc_bsubst(esp, &dst, &src);
-	octetbuf_unlock(&src);
+    /*
+     * Only a one-character digraph and a variable substitution
+     * are complete at the end of the input.
+     */
+    switch (esp->st) {
+	case ST_DGR:
+	    dgr[0] = seq[nseq-1];
+	    dgr[1] = NUL;
+	    u8nseq = esc_expand(esp, u8seq, dgr);
+	    if (u8nseq != (size_t)-1)
+		out(ud, u8seq, u8nseq), nseq = 0U;
+	    break;
+	case ST_SUBST:
+	    seq[nseq] = NUL;
+	    if (nseq > 2 && subst_cb(esp, seq, out, ud))
+		nseq = 0U;
+	    break;
+	default:
+	    break;
     }
     
-    if ((nread = octetbuf_size(&dst)) < nbuf)
-	nbuf = nread;
-    memcpy(buffer, octetbuf_begin(&dst), nbuf);
-    buffer[nbuf] = NUL;
-    octetbuf_shift(&dst, nbuf);
-    return nbuf;
+    if (nseq > 0U)
+	out(ud, seq, nseq);
+	
+    esp->st   = ST_OUTSIDE;
+    esp->nseq = 0U;
 }
 
 /*== EOF ============================ vim:tw=72:sts=0:et:cin:fo=croq:sta
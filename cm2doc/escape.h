@@ -14,9 +14,18 @@ typedef struct esc_state_ esc_state;
 
 typedef const char *(*esc_cb)(const char *);
 
+/*
+ * The output of the preprocessor is passed on in pieces to a
+ * function like this one (eg a wrapper around `cmark_parser_feed()`).
+ */
+typedef void (esc_out)(void *userdata, const char *data, size_t len);
+
 esc_state *esc_create(FILE *);
 void       esc_free(esc_state *);
 
+void      *esc_image(const esc_state *, size_t *);
+esc_state *esc_create_image(const void *, size_t);
+
 int     esc_set_escape(esc_state *, int ch);
 int     esc_set_subst(esc_state *, int ch);
 
@@ -31,12 +40,19 @@ int	esc_define(esc_state *,
 size_t  esc_expand(esc_state *,
 			char u8def[], const char ch[2]);
 
-size_t  esc_fsubst(esc_state *,
-			char buf[], size_t nbuf, FILE *in);
-
-size_t  esc_ssubst(esc_state *,
-			char buf[], size_t nbuf, const char *);
-
+/*
+ * Preprocess the next chunk of input. An escape sequence may straddle
+ * chunks: the state is kept in the `esc_state` for the next call,
+ * and the input is not copied.
+ */
+void    esc_feed(esc_state *,
+			const char *data, size_t len,
+			esc_out *out, void *userdata);
+
+/*
+ * End of input: output what is left of an incomplete sequence.
+ */
+void    esc_finish(esc_state *, esc_out *out, void *userdata);
 
 
 #endif/*ESCAPE_H_INCLUDED*/
@@ -0,0 +1,2796 @@
+/*== repl.c ============================================================*
+
+    repl - The cm2doc replacement backend
+
+    Parsing of replacement definition files into a `cm2doc_rules`
+    object, and rendering of CommonMark documents through a
+    `cm2doc_ctx` rendering context, see "cm2doc.h".
+
+    All state is kept in these two objects -- there are no (writable)
+    static variables here, so the rendering of documents in several
+    threads can share one set of replacement definitions.
+
+------------------------------------------------------------------------
+
+COPYRIGHT NOTICE AND LICENSE
+
+Copyright (C) 2015 Martin Hofmann <mh@tin-pot.net>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   1. Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+   2. Redistributions in binary form must reproduce the above copy-
+      right notice, this list of conditions and the following dis-
+      claimer in the documentation and/or other materials provided
+      with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ''AS IS'' AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLU-
+DING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*=====================================================================*/
+
+#include <assert.h>
+
+#include <ctype.h> /* toupper() */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "octetbuf.h"
+#include "xchar.h" /* Unicode utilities - UTF-8 conversion. */
+
+/*
+ * CommonMark library
+ */
+#define CMARK_NO_SHORT_NAMES 1
+#include "config.h"
+#include "cmark.h"
+#include "cmark_ctype.h"
+#include "node.h"
+#include "buffer.h"
+#include "houdini.h"
+
+#include "cm2doc.h"
+
+
+#define NUL  0
+
+/*== ESIS API ========================================================*/
+
+/*
+ * Callback function types for document content transmittal.
+ */
+
+/*
+ * A convenience mechanism: In an API using arguments like
+ *
+ *     ..., char *data, size_t len, ...
+ *
+ * placing the value NTS in the actual parameter `len` indicates that
+ * `data` is a NUL-terminated (byte) string aka NTBS, so the *callee*
+ * can determine the correct value for `len` from `data`.
+ */
+#ifndef SIZE_MAX /* C99: in <stdint.h> (but in <limits.h> in MSC!) */
+#define SIZE_MAX    (~(size_t)0U)
+#endif
+#ifndef NTS
+#define NTS SIZE_MAX
+#endif
+
+typedef void *ESIS_UserData;
+
+typedef void (ESIS_Attr)(ESIS_UserData,    const char *name,
+                                           const char *val, size_t);
+typedef void (ESIS_Start)(ESIS_UserData,               cmark_node_type);
+typedef void (ESIS_Cdata)(ESIS_UserData,   const char *cdata, size_t);
+typedef void (ESIS_End)(ESIS_UserData,                 cmark_node_type);
+
+typedef struct ESIS_CB_ {
+    ESIS_Attr	 *attr;
+    ESIS_Start	 *start;
+    ESIS_Cdata	 *cdata;
+    ESIS_End	 *end;
+} ESIS_CB;
+
+typedef struct ESIS_Port_ {
+    const ESIS_CB *cb;
+    ESIS_UserData  ud;
+} ESIS_Port;
+
+#define DO_ATTR(N, V, L)   esis_cb->attr(esis_ud, N, V, L)
+#define DO_START(NT)       esis_cb->start(esis_ud, NT)
+#define DO_CDATA(D, L)     esis_cb->cdata(esis_ud, D, L)
+#define DO_END(NT)         esis_cb->end(esis_ud, NT)
+
+
+/*== Meta-data =======================================================*/
+
+/*
+ * Optionally make the Git commit ident and the repository URL
+ * available as character strings.
+ *
+ * Use -DWITH_GITIDENT=1 to switch this on (and have the strings
+ * ready for the linker to find them!); or do nothing and use the
+ * placeholder values given below.
+ */
+
+#if WITH_GITIDENT
+extern const char cmark_gitident[];
+extern const char cmark_repourl[];
+#else
+static const char cmark_gitident[] = "n/a";
+static const char cmark_repourl[]  = "https://github.com/tin-pot/cmark";
+#endif
+
+/*
+ * Predefined "pseudo-attribute" names, see "cm2doc.c".
+ */
+#define META_DC_TITLE   "DC.title"
+#define META_DC_CREATOR "DC.creator"
+#define META_DC_DATE    "DC.date"
+
+/*
+ * Hard-coded defaults for the "pseudo-attributes" (unless overridden
+ * by the `defaults` given to `cm2doc_ctx_set_meta()`).
+ */
+#define DEFAULT_DC_TITLE    "Untitled Document"
+#define DEFAULT_DC_CREATOR  "N.N."
+#define DEFAULT_DC_DATE     "YYYY-MM-DD"
+
+/*== CommonMark Nodes ================================================*/
+
+/*
+ * For each CommonMark node type we define a GI conforming to the
+ * ISO 8879 SGML Reference Concrete Syntax, which has:
+ *
+ *     NAMING LCNMSTRT ""
+ *            UCNMSTRT ""
+ *            LCNMCHAR "-."
+ *            UCNMCHAR "-."
+ *            NAMECASE GENERAL YES
+ *                     ENTITY  NO
+ *
+ * (This is replicated in the IS...() character class macros below.)
+ *
+ * The Reference Quantity Set also sets NAMELEN to 8, so these GIs are
+ * somewhat shorter than the ones in the CommonMark DTD -- which is
+ * a good thing IMO.
+ *
+ * (All this is of course purely cosmetic and/or a nod to SGML, where
+ * all this "structural mark-up" stuff came from. -- You could define
+ * and use any GI and any NMSTART / NMCHAR character classes you want
+ * for giving names to the CommonMark node types.)
+ */
+#define NAMELEN      8 /* The Reference Core Syntax value. */
+#define ATTCNT      40 /* The Reference Quantity Set value. */
+#define ATTSPLEN   960 /* The Reference Quantity Set value. */
+
+#define ISUCNMSTRT(C) ( 'A' <= (C) && (C) <= 'Z' )
+#define ISLCNMSTRT(C) ( 'a' <= (C) && (C) <= 'z' )
+#define ISUCNMCHAR(C) ( ISUCNMSTRT(C) || (C) == '-' || (C) == '.' )
+#define ISLCNMCHAR(C) ( ISLCNMSTRT(C) || (C) == '-' || (C) == '.' )
+
+/* How many node types there are, and what the name length limit is. */
+#define NODE_NUM       (CMARK_NODE_LAST_INLINE+2)
+#define NODE_MARKUP    (CMARK_NODE_LAST_INLINE+1)
+#define NODENAME_LEN    NAMELEN
+
+static const char* const nodename[NODE_NUM+1] = {
+     NULL,	/* The "none" type (enum const 0) is invalid! */
+   /*12345678*/
+    "CM.DOC",
+    "CM.QUO-B",
+    "CM.LIST",
+    "CM.LI",
+    "CM.COD-B",
+    "CM.HTM-B",
+    "CM.CUS-B",
+    "CM.PAR",
+    "CM.HDR",
+    "CM.HR",
+    "CM.TXT",
+    "CM.SF-BR",
+    "CM.LN-BR",
+    "CM.COD",
+    "CM.HTM",
+    "CM.CUS",
+    "CM.EMPH",
+    "CM.STRN",
+    "CM.LNK",
+    "CM.IMG",
+    "MARKUP"
+};
+
+
+/*== Replacement Backend =============================================*/
+
+/*
+ * "Reserved Names" to bind special "replacement texts" to:
+ * The output document's prolog (and, if needed, epilog).
+ */
+enum rn_ {
+    RN_INVALID,
+    RN_PROLOG,
+    RN_EPILOG,
+    RN_NUM,	/* Number of defined "reserved names". */
+};
+
+static const char *const rn_name[] = {
+    NULL,
+    "PROLOG",
+    "EPILOG",
+    NULL
+};
+
+/*--------------------------------------------------------------------*/
+
+/*
+ * Some C0 control characters (internally used to encode the
+ * replacement texts).
+ */
+
+#define SOH  1
+#define STX  2
+#define ETX  3
+#define EOT  4
+#define VT  11 /* Encodes the begin-of-line "+". */
+#define SO  14 /* Encodes the attribute substitution "[". */
+#define SI  15 /* Encodes the attribute substitution "]". */
+
+/*
+ * The C0 control characters allowed in SGML/XML; all other C0 are
+ * **not** usable in a document, and thus free for our private use.
+ */
+#define HT   9	/* SGML SEPCHAR */
+#define LF  10	/* SGML RS */
+#define CR  13	/* SGML RE */
+#define SP  32	/* SGML SPACE */
+
+#define EOL          LF	    /* Per ISO C90 text stream. */
+
+/*--------------------------------------------------------------------*/
+
+/*
+ * SGML function characters, character classes, and delimiters.
+ */
+#define RE           LF
+#define RS           CR
+#define SPACE        SP
+#define ISSEPCHAR(C) ((C) == HT)
+
+#define MSSCHAR      '\\'          /* Markup-scan-suppress character. */
+
+#define LIT          '\"'
+#define LITA         '\''
+
+
+#define ISDIGIT(C)   ( '0' <= (C) && (C) <= '9' )
+#define ISHEX(C)     ( ISDIGIT(C) || \
+                      ('A'<=(C) && (C)<='F') || ('a'<=(C) && (C)<='f') )
+#define ISSPACE(C)   ( (C) == RS || (C) == RE || (C) == SPACE || \
+                                                          ISSEPCHAR(C) )
+#define ISNMSTART(C) ( ISDIGIT(C) || ISUCNMSTRT(C) || ISLCNMSTRT(C) )
+#define ISNMCHAR(C)  ( ISNMSTART(C) || (C) == '-' || (C) == '.' )
+
+/*
+ * Notation indicator in "info string"
+ * ===================================
+ *
+ * NOTA_DELIM is (currently pre-defined to be)
+ *
+ *     U+007C VERTICAL BAR (decimal 124) `|`
+ *
+ * It is used to put an "info string" into an *inline* code span
+ * like this:
+ *
+ *     dolor sit amet, `Z|x %e %N` consectetuer adipiscing elit.
+ *
+ * This *inline* "info string" has the exact same meaning as the
+ * standard "info string" on a code block fence:
+ *
+ *     ~~~ Z|
+ *     x %e %N
+ *     ~~~
+ *
+ * NOTE that the trailing `|` is needed, otherwise this gets treated
+ * as a "regular" info string on a code block!
+ *
+ * In a code block info string, the `|` can be used to separate the
+ * notation name from other info (which ends up in the `info`
+ * attribute):
+ *
+ *     ~~~ Z|informative
+ *     x %e %N
+ *     ~~~
+ *
+ * Both examples produce (in the HTML output file):
+ *
+ *     <MARKUP notation="Z" ...>x %e %N</MARKUP>
+ *
+ * but the *inline* code span produces the attribute `display="inline"`,
+ * while the fenced code *block* gives `display="block"` as the second
+ * attribute in the `<MARKUP>` element. (And the second block example
+ * has also an attribute `info="informative"` ...)
+ */
+
+#define NOTA_DELIM '|'
+
+/*== Replacement Definitions =========================================*/
+
+/*
+ * Replacement definitions for a node type are hold in a
+ * `struct repl_`
+ */
+
+#define STAG_REPL       0x0001
+#define ETAG_REPL       0x0002
+#define STAG_BOL_START  0x0010
+#define STAG_BOL_END    0x0020
+#define ETAG_BOL_START  0x0040
+#define ETAG_BOL_END    0x0080
+
+typedef size_t textidx_t;  /* Index into octetbuf text_buf. */
+
+/*
+ * All attribute names and values mentioned in the selectors are
+ * "interned" as atoms: an `atom_t` is an index into the `atoms`
+ * array of the rules, the string itself is in `text_buf`. Equal
+ * strings are the same atom, thus selectors are matched without
+ * any string comparison.
+ *
+ * The atom 0 (NULLATOM) stands for "no atom", ie for a string not
+ * occuring in any selector.
+ */
+typedef unsigned atom_t;
+
+#define NULLATOM  0U
+
+#define ATOM_NAME 0x01 /* Atom used as attribute name in a selector. */
+
+struct sel_ {
+    atom_t name;
+    atom_t val; /* NULLATOM: Test only for existence. */
+};
+
+struct taginfo_ {
+    cmark_node_type nt;
+    struct sel_     sels[ATTCNT + 1]; /* NULLATOM name terminates. */
+};
+
+struct repl_ {
+    struct taginfo_ taginfo;
+    const char     *repl[2];
+    bool            is_cdata;
+    struct repl_   *next;
+};
+
+struct notation_name_ {
+    const char *name;
+    struct notation_name_ *next;
+};
+
+/*
+ * The compiled replacement definitions: for `repl_tab`, one array
+ * member per node type, plus the (currently unused) member at
+ * index 0 == NODE_NONE.
+ *
+ * The `text_buf` holds the attribute names and values used in the
+ * selectors: they are referenced by `textidx_t` indices through
+ * the `atoms` array (of `textidx_t`), and found by the open
+ * addressing hash table `atom_hash` (of `atom_t`, with `atom_hsize`
+ * a power of two).
+ */
+struct cm2doc_rules_ {
+    struct repl_          *repl_tab[NODE_NUM];
+    const char            *rn_repl[RN_NUM]; /* Replacement texts for RNs. */
+    struct notation_name_ *notations;
+    octetbuf               text_buf;
+    octetbuf               atoms;
+    octetbuf               atom_flags;
+    atom_t                *atom_hash;
+    size_t                 atom_hsize;
+};
+
+#define NATOMS(R)       ( octetbuf_size(&(R)->atoms) / sizeof(textidx_t) )
+#define ATOM_TEXT(R, A)  atom_text((R), (A))
+#define ATOM_FLAGS(R, A) ( ((unsigned char*)octetbuf_ptr(&(R)->atom_flags))[A] )
+
+/*
+ * The octetbuf holding the atoms is only byte-aligned, so the text
+ * index is copied out rather than loaded through a textidx_t pointer.
+ */
+static const char *atom_text(const cm2doc_rules *rules, atom_t a)
+{
+    textidx_t idx;
+
+    memcpy(&idx, octetbuf_elem_at(&rules->atoms, a, sizeof idx), sizeof idx);
+    return (const char*)octetbuf_at(&rules->text_buf, idx);
+}
+
+
+/*== Atoms ===========================================================*/
+
+static unsigned atom_hashval(const char *s, size_t len)
+{
+    unsigned hash = 0U;
+
+    while (len-- > 0U)
+	hash = (*s++ & 0xFFU) + (hash << 6) + (hash << 16) - hash;
+
+    return hash;
+}
+
+/*
+ * Find the atom for a string, or return NULLATOM.
+ */
+static atom_t atom_find(const cm2doc_rules *rules,
+                        const char *s, size_t len)
+{
+    const size_t mask = rules->atom_hsize - 1U;
+    size_t h;
+    atom_t a;
+
+    if (rules->atom_hsize == 0U)
+	return NULLATOM;
+
+    for (h = atom_hashval(s, len) & mask;
+                  (a = rules->atom_hash[h]) != NULLATOM; h = (h+1U) & mask) {
+	const char *t = ATOM_TEXT(rules, a);
+	if (strncmp(t, s, len) == 0 && t[len] == NUL)
+	    return a;
+    }
+    return NULLATOM;
+}
+
+static void atom_insert(cm2doc_rules *rules, atom_t a)
+{
+    const size_t mask = rules->atom_hsize - 1U;
+    const char *t = ATOM_TEXT(rules, a);
+    size_t h;
+
+    for (h = atom_hashval(t, strlen(t)) & mask;
+                 rules->atom_hash[h] != NULLATOM; h = (h+1U) & mask)
+	;
+    rules->atom_hash[h] = a;
+}
+
+/*
+ * Find or create the atom for a string.
+ */
+static atom_t atom_intern(cm2doc_rules *rules, const char *s, size_t len)
+{
+    textidx_t idx;
+    atom_t a;
+
+    if ((a = atom_find(rules, s, len)) != NULLATOM)
+	return a;
+
+    /*
+     * Keep the hash table at most half full.
+     */
+    if (2U * (NATOMS(rules) + 1U) > rules->atom_hsize) {
+	size_t hsize = (rules->atom_hsize > 0U) ? 2U * rules->atom_hsize
+	                                        : 64U;
+	atom_t b;
+
+	free(rules->atom_hash);
+	rules->atom_hash  = calloc(hsize, sizeof *rules->atom_hash);
+	rules->atom_hsize = hsize;
+	for (b = 1U; b < NATOMS(rules); ++b)
+	    atom_insert(rules, b);
+    }
+
+    idx = octetbuf_size(&rules->text_buf);
+    octetbuf_push_back(&rules->text_buf, s, len);
+    octetbuf_push_c(&rules->text_buf, NUL);
+
+    a = (atom_t)NATOMS(rules);
+    octetbuf_push_back(&rules->atoms, &idx, sizeof idx);
+    octetbuf_push_c(&rules->atom_flags, 0);
+    atom_insert(rules, a);
+
+    return a;
+}
+
+
+/*== Rendering Context ===============================================*/
+
+#define OUTBUF_SIZE  (4*BUFSIZ)
+
+typedef size_t nameidx_t; /* Index into nameidx_buf. */
+typedef size_t validx_t;  /* Index into validx_buf. */
+
+static const size_t NULLIDX = 0U; /* Common NULL value for indices. */
+
+struct cm2doc_ctx_ {
+    const cm2doc_rules *rules;
+    unsigned            flags;
+    cmark_option_t      options;
+    ESIS_Port           port;
+
+    /*
+     * Parsing state: the cmark parser, and whether we are still in
+     * the (possibly empty) meta-data lines at the start of the
+     * document. Header lines split across input chunks are collected
+     * in `head_buf`.
+     */
+    cmark_parser       *parser;
+    bool                in_header;
+    octetbuf            head_buf;
+    const char *const  *defaults;
+    const char *const  *meta;
+
+    /*
+     * Attribute names and values of current node(s).
+     */
+    octetbuf            attr_buf;
+
+    /*
+     * We "misuse" a `octetbuf` here to store a growing array
+     * of `attridx_t` (not `char`) elements. There are no alignment
+     * issues as long as the array stays homogenuous, as the buffer is
+     * from `malloc()`, and thus suitably aligned.
+     *
+     * An attribute name index of 0U marks the end of the attribute
+     * list (of the currently active node).
+     */
+    octetbuf            nameidx_buf;
+    octetbuf            validx_buf;
+
+    /*
+     * The attributes of the element about to start, as seen by the
+     * selectors: indexed by the atom of the attribute name, a slot
+     * is valid if its `gen` equals the context's `gen`, which is
+     * incremented for each start tag (so there is no need to clear
+     * the slots). The `val` is the atom of the attribute value, or
+     * NULLATOM if the value is not mentioned in any selector.
+     */
+    struct slot_ {
+	atom_t          val;
+	unsigned        gen;
+    }                  *slots;
+    unsigned            gen;
+
+    /*
+     * The rules selected at the start tags of the currently open
+     * elements, used again at their end tags.
+     */
+    octetbuf            rule_stack;
+
+    /*
+     * The output sink, and the output buffer: `outbol` is only
+     * valid for the output already written into the sink, see
+     * `OUTBOL`.
+     */
+    cm2doc_write_fn    *sink;
+    void               *sink_ud;
+    FILE               *outfp; /* If the sink is a stdio stream. */
+    bool                outbol;
+    size_t              outlen;
+    char                outbuf[OUTBUF_SIZE];
+
+    /*
+     * The `is_cdata` flag is a rough solution to transmit state
+     * information from the start-tag handler to the subsequent cdata
+     * handler ...
+     */
+    bool                is_cdata;
+    cmark_strbuf        houdini;
+
+    unsigned            nerr;
+};
+
+
+/*== Element Stack Keeping ===========================================*/
+
+/*
+ * All these macros refer to the rendering context `ctx`.
+ */
+#define NATTR ( octetbuf_size(&ctx->nameidx_buf) / sizeof(nameidx_t) )
+
+/*
+ * The name index and value index arrays as seen as `nameidx_t *`
+ * and `validx_t *` rvalues, ie as "regular C arrays".
+ */
+#define NAMEIDX(I) (*(nameidx_t*)octetbuf_elem_at(&ctx->nameidx_buf,	\
+                                                (I), sizeof(nameidx_t)))
+#define VALIDX(I)  (* (validx_t*)octetbuf_elem_at(&ctx->validx_buf,	\
+                                                 (I), sizeof(validx_t)))
+
+/*
+ * Append one `nameidx_t` element to the `NAMEIDX` array, and
+ * dito for `validx_t` and the `VALIDX` array.
+ */
+#define PUT_NAMEIDX(I) ( octetbuf_push_back(&ctx->nameidx_buf, \
+                                              &(I), sizeof(nameidx_t)) )
+#define PUT_VALIDX(I)  ( octetbuf_push_back(&ctx->validx_buf, \
+                                               &(I), sizeof(validx_t)) )
+
+/*
+ * We use NULLIDX to delimit "activation records" for the currently
+ * open elements: `close_atts()` pushes a NULLIDX name index (together
+ * with the node type as value index), thus closing the activation
+ * record containing the attributes pushed since the last
+ * `close_atts()`.
+ */
+#define current_nt()     ( VALIDX(NATTR-1U) )
+
+static void close_atts(cm2doc_ctx *ctx, cmark_node_type nt)
+{
+    const nameidx_t nameidx = NULLIDX;
+    const validx_t  validx  = (validx_t)nt;
+
+    PUT_NAMEIDX(nameidx);
+    PUT_VALIDX(validx);
+}
+
+static void push_att(cm2doc_ctx *ctx,
+                     const char *name, const char *val, size_t len)
+{
+    nameidx_t nameidx;
+    validx_t  validx;
+
+    if (len == NTS) len = strlen(val);
+
+    nameidx = octetbuf_size(&ctx->attr_buf);
+    octetbuf_push_s(&ctx->attr_buf, name);
+    octetbuf_push_c(&ctx->attr_buf, NUL);
+
+    validx = octetbuf_size(&ctx->attr_buf);
+    octetbuf_push_back(&ctx->attr_buf, val, len);
+    octetbuf_push_c(&ctx->attr_buf, NUL);
+
+    PUT_NAMEIDX(nameidx);
+    PUT_VALIDX(validx);
+
+    if (ctx->slots != NULL) {
+	const cm2doc_rules *rules = ctx->rules;
+	atom_t a = atom_find(rules, name, strlen(name));
+
+	if (a != NULLATOM && (ATOM_FLAGS(rules, a) & ATOM_NAME)) {
+	    ctx->slots[a].val = atom_find(rules, val, len);
+	    ctx->slots[a].gen = ctx->gen;
+	}
+    }
+}
+
+/*
+ * Remove the current activation record.
+ */
+static void pop_atts(cm2doc_ctx *ctx)
+{
+    nameidx_t nameidx = 0U;
+
+    size_t top = NATTR;
+    if (top > 0U) {
+	nameidx = NAMEIDX(--top);
+	assert(nameidx == NULLIDX);
+	do {
+	    octetbuf_pop_back(&ctx->nameidx_buf, sizeof(nameidx_t));
+	    octetbuf_pop_back(&ctx->validx_buf,  sizeof(validx_t));
+	    assert(top == NATTR);
+	    if (nameidx != NULLIDX) ctx->attr_buf.n = nameidx;
+	} while (top > 0U && (nameidx = NAMEIDX(--top)) != NULLIDX);
+    }
+}
+
+/*
+ * Remove all activation records.
+ */
+static void discard_atts(cm2doc_ctx *ctx)
+{
+    /*
+     * Occupy index 0 position after clearing the buffer, so that
+     * index == 0U can be used as a sentinel.
+     */
+    octetbuf_clear(&ctx->attr_buf);
+    octetbuf_push_c(&ctx->attr_buf, NUL);
+
+    octetbuf_clear(&ctx->nameidx_buf);
+    octetbuf_clear(&ctx->validx_buf);
+}
+
+
+/*
+ * Find attribute in active input element (ie in buf_atts),
+ * return the value.
+ */
+
+static const char* att_val(const cm2doc_ctx *ctx,
+                           const char *name, unsigned depth)
+{
+    size_t k;
+
+    assert ((k = NATTR) > 0U);
+    assert (NAMEIDX(k-1U) == NULLIDX);
+    assert (depth > 0U);
+
+    if (depth == 0U) return NULL;
+
+    for (k = NATTR; k > 0U; --k) {
+	nameidx_t nameidx;
+	validx_t validx;
+	const size_t idx = k-1U;
+
+	nameidx = NAMEIDX(idx);
+
+	assert(nameidx < ctx->attr_buf.n);
+
+	if (nameidx == NULLIDX && depth-- == 0U)
+	    break;
+
+	validx = VALIDX(idx);
+
+	assert(validx  < ctx->attr_buf.n);
+	if (!strcmp(octetbuf_at(&ctx->attr_buf, nameidx), name))
+	    return octetbuf_at(&ctx->attr_buf, validx);
+    }
+
+    return NULL;
+}
+
+
+/*== Notations =======================================================*/
+
+static bool is_notation(const cm2doc_rules *rules,
+                        const char *nmtoken, size_t len)
+{
+    const struct notation_name_ *pn;
+
+    if (nmtoken == NULL || len == 0U)
+	return false;
+
+    if (len == NTS) len = strlen(nmtoken);
+    assert(len > 0U);
+
+    for (pn = rules->notations; pn != NULL; pn = pn->next)
+	if (strncmp(pn->name, nmtoken, len) == 0)
+	    return true;
+    return false;
+}
+
+/*
+ * Returns false if the name is not a valid NOTATION name.
+ */
+static bool register_notation(cm2doc_rules *rules,
+                              const char *nmtoken, size_t len)
+{
+    struct notation_name_ *pn;
+    char *name;
+    size_t k;
+
+    assert(nmtoken != NULL);
+    if (len == NTS) len = strlen(nmtoken);
+    assert(len > 0U);
+
+    if (is_notation(rules, nmtoken, len)) {
+        /*
+         * Name is already known and registered - nothing to do.
+         */
+        return true;
+    }
+
+    for (k = 0U; k < len; ++k) {
+	if (!ISNMCHAR(nmtoken[k]))
+	    return false;
+    }
+
+    pn   = malloc(sizeof *pn);
+    name = malloc(len + 1);
+    memcpy(name, nmtoken, len);
+    name[len] = NUL;
+    pn->name = name;
+    pn->next = rules->notations;
+    rules->notations = pn;
+    return true;
+}
+
+
+/*== Replacement Definitions =========================================*/
+
+/*
+ * Set the replacement text for a node type. Returns false if the
+ * rule mentions an invalid NOTATION name.
+ */
+static bool set_repl(cm2doc_rules *rules,
+                     struct taginfo_ *pti,
+                     const char *repl_text[2],
+                     bool is_cdata)
+{
+    cmark_node_type nt = pti->nt;
+    struct repl_ *rp = malloc(sizeof *rp);
+    bool valid = true;
+
+    assert(0 <= nt);
+    assert(nt < NODE_NUM);
+
+    rp->repl[0]  = repl_text[0];
+    rp->repl[1]  = repl_text[1];
+    rp->taginfo  = *pti;
+    rp->is_cdata = is_cdata;
+    rp->next     = rules->repl_tab[nt];
+
+    rules->repl_tab[nt] = rp;
+
+    if (nt == NODE_MARKUP) {
+        const struct sel_ *sel;
+        for (sel = pti->sels; sel->name != NULLATOM; ++sel) {
+            if (strcmp(ATOM_TEXT(rules, sel->name), "notation") == 0 &&
+                                                 sel->val != NULLATOM) {
+                /*
+                 * A rule for the `MARKUP` element mentions a
+                 * value for the `notation` attribute.
+                 */
+                const char *s = ATOM_TEXT(rules, sel->val);
+                valid = register_notation(rules, s, NTS) && valid;
+            }
+        }
+    }
+    return valid;
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+ * Diagnostics while rendering: these don't abort the rendering, but
+ * are counted and reported by `cm2doc_finish()`.
+ */
+
+static void render_error(cm2doc_ctx *ctx, const char *msg, ...)
+{
+    va_list va;
+    va_start(va, msg);
+    vfprintf(stderr, msg, va);
+    va_end(va);
+    ++ctx->nerr;
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+ * Output goes through `ctx->outbuf` into the sink in large chunks.
+ * The begin-of-line state is derived from the last byte written.
+ */
+
+#define OUTBOL ( (ctx->outlen > 0U) ?					\
+                     (ctx->outbuf[ctx->outlen-1U] == EOL) : ctx->outbol )
+
+#define OUT_PUTC(CH)							\
+do {									\
+    if (ctx->outlen == OUTBUF_SIZE)					\
+	out_flush(ctx);							\
+    ctx->outbuf[ctx->outlen++] = (char)(CH);				\
+} while (0)
+
+static void out_sink(cm2doc_ctx *ctx, const char *p, size_t n)
+{
+    assert(n > 0U);
+
+    if (ctx->sink(ctx->sink_ud, p, n) != n)
+	render_error(ctx, "Output error.\n");
+    ctx->outbol = (p[n-1U] == EOL);
+}
+
+static void out_flush(cm2doc_ctx *ctx)
+{
+    if (ctx->outlen > 0U) {
+	out_sink(ctx, ctx->outbuf, ctx->outlen);
+	ctx->outlen = 0U;
+    }
+}
+
+static void out_write(cm2doc_ctx *ctx, const char *p, size_t n)
+{
+    if (ctx->outlen + n > OUTBUF_SIZE) {
+	out_flush(ctx);
+	if (n >= OUTBUF_SIZE) {
+	    out_sink(ctx, p, n);
+	    return;
+	}
+    }
+    memcpy(ctx->outbuf + ctx->outlen, p, n);
+    ctx->outlen += n;
+}
+
+#define out_puts(CTX, S) out_write((CTX), (S), strlen(S))
+
+/*
+ * Attribute substitution and replacement text output.
+ */
+
+static const char *put_subst(cm2doc_ctx *ctx, const char *p)
+{
+    const char *name;
+    const char *val = NULL;
+    unsigned depth = *p & 0xFFU;
+
+    assert(p[-1] == SO);
+    name = p + 1U;
+    p = name + strlen(name)+2U;
+    assert(p[-1] == SI);
+
+    val = att_val(ctx, name, depth);
+
+    if (val != NULL)
+	out_puts(ctx, val);
+    else
+	render_error(ctx, "Undefined attribute '%s'\n", name);
+
+    return p;
+}
+
+static void put_repl(cm2doc_ctx *ctx, const char *repl)
+{
+    const char *p = repl;
+
+    assert(repl != NULL);
+    while (*p != NUL) {
+	const char *q;
+
+	/*
+	 * Write the run of literal text up to the next VT or SO.
+	 */
+	for (q = p; *q != NUL && *q != VT && *q != SO; ++q)
+	    ;
+	out_write(ctx, p, (size_t)(q - p));
+
+	if (*q == VT) {
+	    if (!OUTBOL)
+		OUT_PUTC(EOL);
+	    p = q + 1;
+	} else if (*q == SO)
+	    p = put_subst(ctx, q + 1);
+	else
+	    p = q;
+    }
+}
+
+/*
+ * Select the first rule for the node type whose selectors all match
+ * the attributes in the slots of the current generation.
+ */
+static const struct repl_ *select_rule(const cm2doc_ctx *ctx,
+                                       cmark_node_type nt)
+{
+    const struct repl_ *rp;
+
+    for (rp = ctx->rules->repl_tab[nt]; rp != NULL; rp = rp->next) {
+	const struct sel_ *sel;
+
+	for (sel = rp->taginfo.sels; sel->name != NULLATOM; ++sel) {
+	    const struct slot_ *slot = &ctx->slots[sel->name];
+
+	    if (slot->gen != ctx->gen)
+		break; /* Attribute existence mismatch. */
+
+	    if (sel->val != NULLATOM && slot->val != sel->val)
+		break; /* Attribute value mismatched. */
+	}
+	if (sel->name == NULLATOM)
+	    return rp; /* Matched all attribute selectors. */
+    }
+    return NULL; /* No matching rule found. */
+}
+
+/*== ESIS API for the Replacement Backend ============================*/
+
+static void repl_Attr(ESIS_UserData ud,
+                          const char *name, const char *val, size_t len)
+{
+    push_att(ud, name, val, len);
+}
+
+static void repl_Start(ESIS_UserData ud, cmark_node_type nt)
+{
+    cm2doc_ctx *ctx = ud;
+    const struct repl_ *rp = NULL;
+
+    close_atts(ctx, nt);
+
+    /*
+     * Find matching replacement definition, and output the
+     * substituted "start string".
+     */
+
+    if (nt != CMARK_NODE_NONE && (rp = select_rule(ctx, nt)) != NULL) {
+	if (rp->repl[0] != NULL) {
+	    put_repl(ctx, rp->repl[0]);
+	}
+    }
+
+    /*
+     * Remember the rule for the end tag, and invalidate the slots
+     * for the attributes of the next element.
+     */
+    octetbuf_push_back(&ctx->rule_stack, &rp, sizeof rp);
+    if (++ctx->gen == 0U) {
+	memset(ctx->slots, 0, NATOMS(ctx->rules) * sizeof *ctx->slots);
+	ctx->gen = 1U;
+    }
+
+    /*
+     * Let the cdata handler know if HTML markup or current
+     * replacement definition dictates literal cdata output ...
+     */
+
+    ctx->is_cdata = (rp != NULL && rp->is_cdata) ||
+                    (nt == CMARK_NODE_HTML_BLOCK) ||
+                    (nt == CMARK_NODE_HTML_INLINE);
+
+    /*
+     * If no matching definition was found, or no start string was
+     * given there, we're done already.
+     *
+     * This amounts to a "default replacement definition" of
+     *
+     *     * - / -
+     *
+     * (except that the "universal element selector" is not available
+     * in our replacement definition syntax (yet?).
+     */
+}
+
+
+static void repl_Cdata(ESIS_UserData ud, const char *cdata, size_t len)
+{
+    cm2doc_ctx *ctx = ud;
+    const char *p;
+
+    if (len == NTS) len = strlen(cdata);
+    p = cdata;
+
+    if (!ctx->is_cdata) {
+        /*
+         * For HTML content and elements declared to be CDATA by
+         * the replacement definition, `is_cdata` should be true
+         * here.
+         *
+         * The content of every other node is written "escaped".
+         *
+	 * The last argument `0` indicates that SOLIDUS is *not*
+	 * to be escaped -- which would prevent us from using it
+	 * as the SGML NET.
+	 */
+
+	houdini_escape_html0(&ctx->houdini, (uint8_t*)cdata, len, 0);
+	p   = cmark_strbuf_cstr(&ctx->houdini);
+	len = cmark_strbuf_len(&ctx->houdini);
+    }
+
+    out_write(ctx, p, len);
+
+    cmark_strbuf_clear(&ctx->houdini);
+}
+
+static void repl_End(ESIS_UserData ud, cmark_node_type nt)
+{
+    cm2doc_ctx *ctx = ud;
+    const struct repl_ *rp;
+
+    /*
+     * The rule selected for the start tag (copied out: the rule stack
+     * is only byte-aligned).
+     */
+    memcpy(&rp, octetbuf_pop_back(&ctx->rule_stack, sizeof rp), sizeof rp);
+    if (rp != NULL) {
+	if (rp->repl[1] != NULL) {
+	    put_repl(ctx, rp->repl[1]);
+	}
+    }
+
+    /*
+     * Reset the `is_cdata` switch. This will only work
+     * if no other element is nested inside an element for
+     * which the replacement definition indicated `<![CDATA[`
+     * (but this seems a reasonable assumption after all!).
+     */
+
+    ctx->is_cdata = false;
+
+    pop_atts(ctx);
+}
+
+static const struct ESIS_CB_ repl_CB = {
+    repl_Attr,
+    repl_Start,
+    repl_Cdata,
+    repl_End
+};
+
+/*== ESIS API for RAST Output Generator ==============================*/
+
+static void rast_data(cm2doc_ctx *ctx,
+                      const char *data, size_t len, char delim)
+{
+    char num[16];
+    size_t k;
+    int in_special = 1;
+    int at_bol = 1;
+
+    for (k = 0U; k < len; ++k) {
+	int ch = data[k] & 0xFF;
+	if (32 <= ch && ch < 128) {
+	    if (in_special) {
+		if (!at_bol) {
+		    OUT_PUTC(EOL);
+		}
+		OUT_PUTC(delim);
+		in_special = 0;
+		at_bol = 0;
+	    }
+	    OUT_PUTC(ch);
+	} else {
+	    if (!in_special) {
+		if (!at_bol) {
+		    OUT_PUTC(delim);
+		    OUT_PUTC(EOL);
+		}
+		in_special = 1;
+		at_bol = 1;
+	    }
+	    if (128 < ch) {
+		size_t n = len - k;
+		xchar_t c32;
+		int i = mbtoxc(&c32, &data[k], n);
+		if (i > 0) {
+		    sprintf(num, "#%lu\n", (unsigned long)c32);
+		    out_puts(ctx, num);
+		    k += i-1;
+		} else {
+		    unsigned m;
+		    n = (unsigned)(-i);
+		    if (n == 0) n = 1;
+
+		    for (m = 0; m < n; ++m) {
+			sprintf(num, "#X%02X\n", 0xFFU & data[k+m]);
+			out_puts(ctx, num);
+		    }
+		    k = k + m - 1;
+		    fprintf(stderr,
+		              "Invalid UTF-8 sequence in data line!\n");
+		}
+	    } else {
+		switch (ch) {
+		case RS:  out_puts(ctx, "#RS\n");	    break;
+		case RE:  out_puts(ctx, "#RE\n");	    break;
+		case HT:  out_puts(ctx, "#TAB\n");	    break;
+		default:  sprintf(num, "#%u\n", ch);
+		          out_puts(ctx, num);	    break;
+		}
+	    }
+
+	    at_bol = 1;
+	}
+    }
+    if (!in_special) { OUT_PUTC(delim); at_bol = 0; }
+    if (!at_bol) OUT_PUTC(EOL);
+}
+
+
+static void rast_Attr(ESIS_UserData ud,
+                          const char *name, const char *val, size_t len)
+{
+    if (len == NTS) len = strlen(val);
+
+    push_att(ud, name, val, len);
+    return;
+}
+
+static void rast_Start(ESIS_UserData ud, cmark_node_type nt)
+{
+    cm2doc_ctx *ctx = ud;
+    size_t nattr = NATTR;
+
+    if (nt == 0 && !(ctx->flags & CM2DOC_RAST_ALL)) {
+	discard_atts(ctx);
+	return;
+    }
+
+    if (nattr > 0U) {
+	size_t k;
+	const char *GI = nodename[nt];
+
+	out_puts(ctx, "[");
+	out_puts(ctx, (GI == NULL) ? "#0" : GI);
+	OUT_PUTC(EOL);
+	for (k = nattr; k > 0U; --k) {
+	    nameidx_t nameidx = NAMEIDX(k-1);
+	    nameidx_t validx  = VALIDX(k-1);
+	    const char *name = octetbuf_at(&ctx->attr_buf, nameidx);
+	    const char *val  = octetbuf_at(&ctx->attr_buf, validx);
+	    out_puts(ctx, name);
+	    out_puts(ctx, "=\n");
+	    rast_data(ctx, val, strlen(val), '!');
+	}
+	out_puts(ctx, "]\n");
+    } else {
+	const char *GI = nodename[nt];
+
+	out_puts(ctx, "[");
+	out_puts(ctx, (GI == NULL) ? "#0" : GI);
+	out_puts(ctx, "]\n");
+    }
+
+    discard_atts(ctx);
+    return;
+}
+
+
+static void rast_Cdata(ESIS_UserData ud, const char *cdata, size_t len)
+{
+    cm2doc_ctx *ctx = ud;
+    if (len == NTS) len = strlen(cdata);
+
+    rast_data(ctx, cdata, len, '|');
+}
+
+static void rast_End(ESIS_UserData ud, cmark_node_type nt)
+{
+    cm2doc_ctx *ctx = ud;
+
+    if (nt == 0 && !(ctx->flags & CM2DOC_RAST_ALL))
+	return;
+    else {
+	const char *GI = nodename[nt];
+	out_puts(ctx, "[/");
+	out_puts(ctx, (GI == NULL) ? "#0" : GI);
+	out_puts(ctx, "]\n");
+    }
+    return;
+}
+
+static const struct ESIS_CB_ rast_CB = {
+    rast_Attr,
+    rast_Start,
+    rast_Cdata,
+    rast_End,
+};
+
+/*== CommonMark Document Rendering into an ESIS Port ================*/
+
+/*
+ * Rendering a document node into the ESIS callbacks.
+ */
+
+
+struct infosplit {
+    const char  *name, *suffix;
+    size_t       nlen,  slen;
+};
+
+static int infosplit(const cm2doc_rules *rules,
+                     struct infosplit *ps, const char *s, size_t n)
+{
+    const char *t, *u;
+    bool suppress = false, found = false;
+
+    while (n > 0U && (*s == SP || *s == HT)) {
+        ++s, --n;
+    }
+    t = s;
+    ps->suffix = s;
+    ps->slen   = n;
+    if (n > 0U && *t == NOTA_DELIM) {
+        ++t, --n;
+        suppress = true;
+    }
+    for (u = t; n > 0U && ISNMCHAR(*u); ++u, --n)
+        ;
+    if (rules != NULL && t < u && n > 0U && *u == NOTA_DELIM) {
+        ps->name = t;
+        ps->nlen = (size_t)(u - t);
+        found = is_notation(rules, ps->name, ps->nlen);
+        if (found) {
+            if (suppress) {
+                ++ps->suffix;
+                --ps->slen;
+            } else {
+                ps->suffix = (n > 1) ? u + 1 : NULL;
+                ps->slen   = (n > 1) ? n - 1 : 0U;
+            }
+        }
+    }
+    return found && !suppress;
+}
+
+static int S_render_node_esis(cmark_node *node,
+                              cmark_event_type ev_type,
+                              cm2doc_ctx *ctx)
+{
+    cmark_delim_type delim;
+    bool entering = (ev_type == CMARK_EVENT_ENTER);
+    char buffer[100];
+
+    const ESIS_CB  *esis_cb = ctx->port.cb;
+    ESIS_UserData   esis_ud = ctx->port.ud;
+
+    if (!entering) {
+	if (node->first_child) {
+	    DO_END(node->type);
+	}
+	return 1;
+    }
+
+    switch (node->type) {
+    case CMARK_NODE_TEXT:
+    case CMARK_NODE_HTML_BLOCK:
+    case CMARK_NODE_HTML_INLINE:
+	if (node->type != CMARK_NODE_TEXT) {
+	    DO_ATTR("type", "HTML", NTS);
+	    DO_ATTR("display", node->type == CMARK_NODE_HTML_BLOCK ?
+		    "block" : "inline", NTS);
+	}
+	DO_START(node->type);
+	DO_CDATA(node->as.literal.data, node->as.literal.len);
+	DO_END(node->type);
+	break;
+
+    case CMARK_NODE_LIST:
+	switch (cmark_node_get_list_type(node)) {
+	case CMARK_ORDERED_LIST:
+	    DO_ATTR("type", "ordered", NTS);
+	    sprintf(buffer, "%d", cmark_node_get_list_start(node));
+	    DO_ATTR("start", buffer, NTS);
+	    delim = cmark_node_get_list_delim(node);
+	    DO_ATTR("delim", (delim == CMARK_PAREN_DELIM) ?
+		"paren" : "period", NTS);
+	    break;
+	case CMARK_BULLET_LIST:
+	    DO_ATTR("type", "bullet", NTS);
+	    break;
+	default:
+	    break;
+	}
+	DO_ATTR("tight", cmark_node_get_list_tight(node) ?
+	    "true" : "false", NTS);
+	DO_START(node->type);
+	break;
+
+    case CMARK_NODE_HEADING:
+	sprintf(buffer, "%d", node->as.heading.level);
+	DO_ATTR("level", buffer, NTS);
+	DO_START(node->type);
+	break;
+
+    case CMARK_NODE_CODE:
+    case CMARK_NODE_CODE_BLOCK:
+	/*
+	 * If the info string (for code block) rsp the data string (for
+	 * inline code) has the form:
+	 *
+	 *     ( { S } , name , "|" , suffix )
+	 *
+	 * where *S* is `SP` or `TAB`, *name* is the name of a known
+	 * notation, and *suffix* any string, then we convert the
+	 * code element into a custom element.
+	 *
+	 * What if the info/data string is nevertheless the intended
+	 * content and this conversion should not take place?
+	 *
+	 *     ( { S } , "|", name , "|" , suffix )
+	 */
+	{
+	    cmark_node_type    nt = node->type;
+	    struct infosplit   split;
+	    const char        *info, *data;
+	    size_t             ilen,  dlen;
+	    const bool         is_inline = (nt == CMARK_NODE_CODE);
+
+	    info = node->as.code.info.data;
+	    ilen = node->as.code.info.len;
+
+	    if (infosplit(ctx->rules, &split, info, ilen)) {
+		/*
+		 * Use split.name as notation name,
+		 * and if inline, split.suffix as content or (if block)
+		 * suffix as extra info.
+		 */
+		nt = NODE_MARKUP;
+		DO_ATTR("notation", split.name, split.nlen);
+		if (is_inline) {
+		    DO_ATTR("display", "inline", 6U);
+		    data = split.suffix;
+		    dlen = split.slen;
+		} else {
+		    DO_ATTR("display", "block", 5U);
+		    data = node->as.code.literal.data;
+		    dlen = node->as.code.literal.len;
+		    if (split.slen > 0U)
+			DO_ATTR("info", split.suffix, split.slen);
+		}
+	    } else {
+		/*
+		 * Regular code element, if inline use info as content,
+		 * if block it is the info attribute.
+		 */
+		if (is_inline) {
+		    data = split.suffix;
+		    dlen = split.slen;
+		} else {
+		    data = node->as.code.literal.data;
+		    dlen = node->as.code.literal.len;
+		    if (split.slen > 0U)
+			DO_ATTR("info", split.suffix, split.slen);
+		}
+	    }
+
+	    DO_START(nt);
+	    DO_CDATA(data, dlen);
+	    DO_END(nt);
+	}
+	break;
+
+    case CMARK_NODE_LINK:
+    case CMARK_NODE_IMAGE:
+	DO_ATTR("destination",
+	    node->as.link.url.data, node->as.link.url.len);
+	DO_ATTR("title", node->as.link.title.data,
+	    node->as.link.title.len);
+	DO_START(node->type);
+	break;
+
+    case CMARK_NODE_HRULE:
+    case CMARK_NODE_SOFTBREAK:
+    case CMARK_NODE_LINEBREAK:
+	DO_START(node->type);
+	DO_END(node->type);
+	break;
+
+    case CMARK_NODE_DOCUMENT:
+    default:
+	DO_START(node->type);
+	break;
+    } /* switch */
+
+    return 1;
+}
+
+static void render_esis(cmark_node *root, cm2doc_ctx *ctx)
+{
+  cmark_event_type ev_type;
+  cmark_node *cur;
+  cmark_iter *iter = cmark_iter_new(root);
+
+  while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+    cur = cmark_iter_get_node(iter);
+    S_render_node_esis(cur, ev_type, ctx);
+  }
+  cmark_iter_free(iter);
+}
+
+
+/*====================================================================*/
+
+/*
+ * The default value for a "pseudo-attribute": given by the application
+ * in the context, or the hard-coded one.
+ */
+
+static const char *meta_default(const cm2doc_ctx *ctx,
+                                const char *name, const char *dflt)
+{
+    const char *const *defaults = ctx->defaults;
+
+    if (defaults != NULL)
+	for ( ; defaults[0] != NULL; defaults += 2)
+	    if (strcmp(defaults[0], name) == 0)
+		return defaults[1];
+    return dflt;
+}
+
+/*
+ * do_meta_lines -- Set meta-data attributes from pandoc-style header.
+ */
+
+static size_t do_meta_lines(const char *buffer, size_t nbuf,
+                                                        cm2doc_ctx *ctx)
+{
+    size_t ibol, nused;
+    unsigned dc_count = 0U;
+    static const char *const dc_name[] = {
+	META_DC_TITLE,
+	META_DC_CREATOR,
+	META_DC_DATE,
+	NULL,
+    };
+    char version[1024];
+    const ESIS_CB *esis_cb = ctx->port.cb;
+    ESIS_UserData  esis_ud = ctx->port.ud;
+    const char *const *defaults;
+
+    ibol = 0U;
+    nused = 0U;
+
+    DO_ATTR(META_DC_TITLE,   meta_default(ctx, META_DC_TITLE,
+                                             DEFAULT_DC_TITLE),   NTS);
+    DO_ATTR(META_DC_CREATOR, meta_default(ctx, META_DC_CREATOR,
+                                             DEFAULT_DC_CREATOR), NTS);
+    DO_ATTR(META_DC_DATE,    meta_default(ctx, META_DC_DATE,
+                                             DEFAULT_DC_DATE),    NTS);
+
+    if ((defaults = ctx->defaults) != NULL)
+	for ( ; defaults[0] != NULL; defaults += 2)
+	    if (strcmp(defaults[0], META_DC_TITLE)   != 0 &&
+	        strcmp(defaults[0], META_DC_CREATOR) != 0 &&
+	        strcmp(defaults[0], META_DC_DATE)    != 0)
+		DO_ATTR(defaults[0], defaults[1], NTS);
+
+    sprintf(version, "            %s;\n"
+		     "            date: %s;\n"
+		     "            id: %s\n"
+		     "        ",
+	    cmark_repourl,
+	    __DATE__ ", " __TIME__,
+	    cmark_gitident);
+    DO_ATTR("CM.doc.v", version, NTS);
+    DO_ATTR("CM.ver", CMARK_VERSION_STRING, NTS);
+
+    for (ibol = 0U; ibol < nbuf && buffer[ibol] == '%'; ) {
+	size_t len;
+        const char *p;
+        size_t ifield;
+
+	/*
+	 * Field starts after '%', ends before *p = LF.
+	 */
+        ifield = ibol + 1U;
+        if (ifield < nbuf && buffer[ifield] == ' ') ++ifield;
+        if (ifield >= nbuf)
+            break;
+
+        p = memchr(buffer+ifield, '\n', nbuf - ifield);
+        if (p == NULL)
+            break; /* No EOL ==> fragment buffer too short. */
+
+        /*
+         * One after '\n'.
+         */
+        ibol = (p - buffer) + 1U;
+
+        /*
+         * We copy buffer[ifield .. ibol-2], ie the line content
+         * from ifield to just before the '\n', and append a NUL
+         * terminator, of course.
+         */
+        len = ibol - ifield - 1U;
+        if (len > 1U) {
+	    if (dc_name[dc_count] != NULL)
+		DO_ATTR(dc_name[dc_count++], buffer+ifield, len);
+	    else {
+		const char *colon, *val;
+		char name[NAMELEN+1];
+		size_t nname, nval;
+
+		for (colon = buffer+ifield; colon+1 < p; ++colon)
+		    if (colon[0] == ':' && colon[1] == ' ')
+			break;
+		if (colon+1 < p) {
+		    nname = colon - (buffer+ifield);
+		    if (nname > NAMELEN) nname = NAMELEN;
+		    strncpy(name, buffer + ifield, nname);
+		    name[nname] = NUL;
+
+		    val     = colon + 2;
+		    while (val[0] != EOL && ISSPACE(val[0]) &&
+		                                          val[1] != EOL)
+			++val;
+		    nval = 0U;
+		    while (val[nval] != EOL)
+			++nval;
+
+		    DO_ATTR(name, val, nval);
+		} else
+		    fprintf(stderr, "Meta line \"%% %.*s\" ignored: "
+		                           "No ': ' delimiter found.\n",
+		                               (int)len, buffer+ifield);
+	    }
+        }
+    }
+
+    nused = ibol;
+    return nused;
+}
+
+/*
+ * header_len -- Length of the meta-data lines at the start of `data`,
+ * and whether the first line after them is seen, ie if the header is
+ * complete.
+ */
+
+static size_t header_len(const char *data, size_t len, bool *pdone)
+{
+    size_t ibol = 0U;
+    const char *p;
+
+    while (ibol < len && data[ibol] == '%') {
+	p = memchr(data + ibol, '\n', len - ibol);
+	if (p == NULL)
+	    break;
+	ibol = (p - data) + 1U;
+    }
+    *pdone = ibol < len && data[ibol] != '%';
+    return ibol;
+}
+
+/*== Replacement Definitions Parsing =================================*/
+
+/*
+ * During parsing of the "Replacement Definition" file we keep the
+ * position in the input text file (for diagnostic messages) and the
+ * look-ahead characters in a `struct repl_loader_`.
+ *
+ * All the macros below, and all `P_...()` parsing functions, refer
+ * to the loader state `ld`.
+ */
+
+#define LA_SIZE 4
+
+struct repl_loader_ {
+    cm2doc_rules *rules;
+    FILE         *replfp;
+    const char   *filename;
+    unsigned      lineno;   /* Text input position: Line number. */
+    unsigned      colno;    /* Text input position: Column number. */
+    char          la_buf[LA_SIZE], ch0;
+    unsigned      la_num;
+    octetbuf      repl;     /* The replacement text being parsed. */
+    octetbuf      lit;      /* The attribute value literal parsed. */
+    unsigned      nerr;
+};
+
+typedef struct repl_loader_ repl_loader;
+
+#define COUNT_EOL(CH) (((CH) == EOL) ?					\
+                         (++ld->lineno, ld->colno = 0U, (CH)) :		\
+                                                  (++ld->colno, (CH)) )
+
+#define GETC(CH) ( ld->la_num ? ( (CH) = ld->la_buf[--ld->la_num] ) :	\
+                       ( (CH) = getc(ld->replfp), COUNT_EOL(CH) ) )
+
+#define UNGETC(CH) (ld->la_buf[ld->la_num++] = (CH))
+
+#define PEEK()   ( ld->la_buf[ld->la_num++] = ld->ch0 =			\
+                            getc(ld->replfp), COUNT_EOL(ld->ch0) )
+
+/*--------------------------------------------------------------------*/
+
+/*
+ * Syntax error diagnostics.
+ */
+
+static void syntax_error(repl_loader *ld, const char *msg, ...)
+{
+    va_list va;
+    va_start(va, msg);
+    fprintf(stderr, "%s(%u:%u): error: ", ld->filename,
+                                                 ld->lineno, ld->colno);
+    vfprintf(stderr, msg, va);
+    va_end(va);
+    ++ld->nerr;
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+ * Parsing the replacement definition file format.
+ */
+
+
+/*
+ * S = SPACE | SEPCHAR | RS | RE
+ *
+ * P_S(ch) accepts ( { S } )
+ */
+#define P_S(CH)								\
+do {									\
+    while (ISSPACE(CH))							\
+	CH = GETC(CH);							\
+} while (0)
+
+/*
+ * An _attribute substitution_ in the _replacement text_ gets encoded
+ * like this:
+ *
+ *     attrib subst = "${" , [ prefix ] , nmstart , { nmchar } , "}"
+ *                  | "$"  , [ prefix ] , nmstart , { nmchar } ;
+ *
+ *     encoded form:  SO ,  precode   ,  char   , {  char  } ,  NUL , SI
+ *
+ * The (optional) prefix character ":" or **Digit** is encoded like
+ * this (using SP for "no prefix"):
+ *
+ *     prefix  precode
+ *
+ *      ./.      SP
+ *      "."     0xFF
+ *      "0"     0x01
+ *      "1"     0x02
+ *      ...      ...
+ *
+ *      "9"     0x0A
+ *
+ *   - Thus "precode" can be used as a "depth" argument directly, and
+ *     because SI = 13,
+ *
+ *   - we can still search for SI starting from the SO
+ *     right at the front of this _attribute substitution_ encoding.
+ *
+ *   - And the _attribute name_ is a NTBS starting at offset 2 after the
+ *     initial SO.
+ */
+
+static int P_attr_subst(repl_loader *ld, int ch, octetbuf *pbuf,
+                                                         const char lit)
+{
+    int code = 0;
+    int brace = 0;
+
+    assert(ch == '$');
+    ch = GETC(ch);
+    if (ch == '{') {
+        brace = ch;
+        ch = GETC(ch);
+    }
+
+    if (ISNMSTART(ch))
+	code = SP;
+    else if (ISDIGIT(ch) || ch == ':') {
+	static const char in_ [] = ":0123456789";
+	static const char out_[] = "\xFF\0x01\0x02\0x03\0x04\0x05"
+	                               "\0x06\0x07\0x08\0x09\0x0A";
+	ptrdiff_t idx = strchr(in_, ch) - in_;
+
+	code = out_[idx];
+	ch = GETC(ch);
+    } else {
+	syntax_error(ld, "Expected NMSTART or ':' or Digit, got '%c'\n",
+	                                                            ch);
+	return ch;
+    }
+
+    /*
+     * Code the _**atto**_ delimiter and the "prefix char".
+     */
+    octetbuf_push_c(pbuf, SO);
+    octetbuf_push_c(pbuf, code);
+    if (code == SP) {
+        octetbuf_push_c(pbuf, ch); /* The NMSTART char of name */
+        ch = GETC(ch);
+    }
+
+    while (ch != EOF) {
+	if (ISNMCHAR(ch)) {
+	    octetbuf_push_c(pbuf, ch);
+	} else if (ch == lit) {
+	    if (brace) { /* Hit the string delimiter! */
+	        syntax_error(ld, "Unclosed attribute reference "
+			"(missing '}').\n");
+	    }
+	    break;
+	} else if (ISSPACE(ch)) {
+	    if (brace) {
+                syntax_error(ld, "SPACE in attribute name discarded.\n");
+            } else {
+                break;
+            }
+	} else if (ch == MSSCHAR) {
+	    if (brace) {
+	        syntax_error(ld, "You can't use '%c' in attribute names.\n",
+	                                                            ch);
+            } else {
+                break;
+            }
+	} else if (brace && ch == '}') {
+	    break;
+        } else if (brace) {
+	    syntax_error(ld, "Expected NMCHAR, got '%c'.\n", ch);
+	    break;
+	} else {
+	    break;
+        }
+	ch = GETC(ch);
+    }
+    if (brace && ch == '}') {
+        ch = GETC(ch);
+    }
+
+    /*
+     * Finish the encoded _attribute substitution_.
+     */
+
+    octetbuf_push_c(pbuf, NUL); /* Make the name a NTBS. */
+    octetbuf_push_c(pbuf, SI);  /* Mark the end of the coded thing. */
+
+    return ch;
+}
+
+#define P_repl_string(LD, CH, P, D)   P_string((LD), (CH), (P), (D), 1)
+#define P_attr_val_lit(LD, CH, P, D)  P_string((LD), (CH), (P), (D), 0)
+
+static int P_string(repl_loader *ld, int ch, octetbuf *pbuf, char delim,
+                                                             int is_repl)
+{
+    char last = NUL;
+
+    if (ch == '"' || ch == '\'') {
+        assert(delim == ch);
+        ch = GETC(ch);
+    } else {
+        assert(ch == '{');
+        assert(delim == '}');
+        ch = GETC(ch);
+    }
+    while (ch != delim && (last = ch) != NUL) {
+	if (ch == MSSCHAR) {
+
+	    switch (ch = GETC(ch)) {
+	    case MSSCHAR: ch = MSSCHAR; break;
+	    case  'n': ch = '\n';  break;
+	    case  'r': ch = '\r';  break;
+	    case  's': ch =  SP ;  break;
+	    case  't': ch = '\t';  break;
+	    case  '$': ch = '$' ;  break;
+	    case  '{': ch = '{' ;  break;
+	    case  '}': ch = '}' ;  break;
+	    case  LIT: ch = LIT ; break;
+	    case LITA: ch = LITA ; break;
+	    default:   octetbuf_push_c(pbuf, MSSCHAR);
+	    }
+	    if (ch != EOF)
+		octetbuf_push_c(pbuf, ch);
+	    last = ch, ch = GETC(ch);
+
+	} else if (ch == '$' && is_repl) {
+
+	    ch = P_attr_subst(ld, ch, pbuf, delim);
+
+	} else if (ch == EOL) {
+	    octetbuf_push_c(pbuf, ch);
+	    last = ch, ch = GETC(ch);
+	} else {
+	    octetbuf_push_c(pbuf, ch);
+	    last = ch, ch = GETC(ch);
+	}
+    }
+    if (!is_repl)
+	octetbuf_push_c(pbuf, NUL);
+
+    assert(ch == delim);
+    ch = GETC(ch);
+    return ch;
+}
+
+
+static int P_repl_text(repl_loader *ld, int ch, char *repl_text[1])
+{
+    octetbuf *const repl = &ld->repl;
+    unsigned nstrings = 0U;
+
+    P_S(ch);
+    octetbuf_clear(repl);
+
+    if (ch == '+') {
+        octetbuf_push_c(repl, VT);
+        ch = GETC(ch);
+    }
+
+    while (ch != EOF) {
+
+	P_S(ch);
+
+	if (ch == LIT || ch == LITA || ch == '{')
+	    ch = P_repl_string(ld, ch, repl, (ch == '{') ? '}' : ch);
+	else
+	    break;
+	++nstrings;
+    }
+
+    P_S(ch);
+
+    if (ch == '+') {
+        octetbuf_push_c(repl, VT);
+        ch = GETC(ch);
+    }
+
+    if (nstrings > 0U) {
+	char *res;
+	octetbuf_push_c(repl, NUL);
+	res = octetbuf_dup(repl);
+	repl_text[0] = res;
+	return ch;
+    } else {
+	octetbuf_clear(repl);
+	repl_text[0] = NULL;
+	return ch;
+    }
+}
+
+static int P_repl_text_pair(repl_loader *ld, int ch, char *repl_text[2])
+{
+    repl_text[0] = repl_text[1] = NULL;
+
+    P_S(ch);
+    if (ch == '-') {
+	ch = GETC(ch);
+    } else if (ch == '/') {
+	;
+    } else {
+	ch = P_repl_text(ld, ch, repl_text+0);
+    }
+
+    P_S(ch);
+
+    if (ch == '/') {
+	ch = GETC(ch);
+	P_S(ch);
+	if (ch == '-') {
+	    ch = GETC(ch);
+	} else {
+	    ch = P_repl_text(ld, ch, repl_text+1);
+	}
+    }
+
+    return ch;
+}
+
+
+static int P_name(repl_loader *ld, int ch, cmark_node_type *pnt,
+                                         char name[NAMELEN+1], bool fold)
+{
+    char *p = name;
+    cmark_node_type nt;
+
+    assert(ISNMSTART(ch));
+
+    do {
+	*p++ = fold ? toupper(ch) : ch;
+	ch = GETC(ch);
+    } while (p < name + NAMELEN + 1 && ISNMCHAR(ch));
+
+    *p = NUL;
+    if (p == name + NAMELEN + 1) {
+	syntax_error(ld, "\"%s\": Name truncated after NAMELEN = %u "
+	                                "characters.\n", name, NAMELEN);
+    }
+    while (ISNMCHAR(ch))
+	ch = GETC(ch);
+
+    if (pnt == NULL)
+	return ch;
+    else
+	*pnt = 0;
+    /*
+     * Look up the "GI" for a CommonMark node type.
+     */
+
+    for (nt = 1; nodename[nt] != NULL; ++nt)
+	if (nodename[nt] != NULL && strcmp(nodename[nt], name) == 0) {
+	    *pnt = nt;
+	    break;
+	}
+
+    if (*pnt == 0)
+	syntax_error(ld, "\"%s\": Not a CommonMark node type.", name);
+
+    return ch;
+}
+
+
+static int P_rni_name(repl_loader *ld, int ch, enum rn_ *prn,
+                                                    char name[NAMELEN+1])
+{
+    enum rn_ rn;
+
+    assert(ch == '@');
+
+    ch = GETC(ch);
+    ch = P_name(ld, ch, NULL, name, true);
+
+    if (prn == NULL)
+	return ch;
+    else
+	*prn = 0;
+
+    /*
+     * Look up the "reserved name".
+     */
+    for (rn = 1; rn_name[rn] != NULL; ++rn)
+	if (strcmp(rn_name[rn], name) == 0) {
+	    *prn = rn;
+	    break;
+	}
+
+    if (*prn == 0)
+	syntax_error(ld, "\"%s\": Unknown reserved name.\n", name);
+
+    return ch;
+}
+
+static int P_sel(repl_loader *ld, int ch, struct taginfo_ taginfo[1])
+{
+    cm2doc_rules *const rules = ld->rules;
+    octetbuf *const lit = &ld->lit;
+    char name[NAMELEN+1];
+    cmark_node_type nt;
+    const int fold = 1;
+    unsigned nattr = 0U;
+
+    assert(ISNMSTART(ch));
+
+    ch = P_name(ld, ch, &nt, name, fold);
+    taginfo->nt = nt;
+
+    while (ch == '[') {
+	atom_t name_atom, val_atom = NULLATOM;
+
+	ch = GETC(ch);
+        P_S(ch);
+	ch = P_name(ld, ch, NULL, name, false);
+	P_S(ch);
+	if (ch == '=') {
+	    ch = GETC(ch);
+	    P_S(ch);
+	    if (ch == LIT || ch == LITA) {
+		octetbuf_clear(lit);
+		ch = P_attr_val_lit(ld, ch, lit, ch);
+		val_atom = atom_intern(rules, octetbuf_ptr(lit),
+		                                    octetbuf_size(lit) - 1U);
+	    } else if (ISNMSTART(ch)) {
+	        char val[NAMELEN+1];
+	        ch = P_name(ld, ch, NULL, val, false);
+	        val_atom = atom_intern(rules, val, strlen(val));
+	    } else {
+                syntax_error(ld, "Expected name or string, got '%c'\n",
+                                                                    ch);
+	    }
+	    P_S(ch);
+	}
+	if (ch != ']') {
+            syntax_error(ld, "Expected ']', got '%c'\n", ch);
+	}
+	ch = GETC(ch);
+
+	if (nattr == ATTCNT) {
+	    syntax_error(ld, "More than ATTCNT = %u attribute "
+	                               "selectors ignored.\n", ATTCNT);
+	    continue;
+	}
+
+	name_atom = atom_intern(rules, name, strlen(name));
+	ATOM_FLAGS(rules, name_atom) |= ATOM_NAME;
+	taginfo->sels[nattr].name = name_atom;
+	taginfo->sels[nattr].val  = val_atom;
+	++nattr;
+    }
+    taginfo->sels[nattr].name = NULLATOM;
+
+    return ch;
+}
+
+static int P_cdata_flag(repl_loader *ld, int ch, bool *is_cdata)
+{
+    static const char s_cdata[]  = "CDATA";
+
+    P_S(ch);
+    if (ISNMSTART(ch)) {
+        char nmbuf[NAMELEN+1];
+
+        ch = P_name(ld, ch, NULL, nmbuf, true);
+        if (strcmp(nmbuf, s_cdata) == 0)
+            *is_cdata = true;
+        else
+            syntax_error(ld, "Expected 'CDATA', got '%s'\n", nmbuf);
+    }
+    return ch;
+}
+
+static int P_sel_rule(repl_loader *ld, int ch)
+{
+    struct taginfo_ taginfo[1];
+    char *repl_texts[2];
+    bool is_cdata = false;
+
+    if (!ISNMSTART(ch)) {
+        syntax_error(ld, "Expected name, got '%c'\n", ch);
+        ch = GETC(ch);
+        return ch;
+    }
+
+    ch = P_sel(ld, ch, taginfo);
+    ch = P_cdata_flag(ld, ch, &is_cdata);
+    ch = P_repl_text_pair(ld, ch, repl_texts);
+
+    if (!set_repl(ld->rules, taginfo, (const char **)repl_texts,
+                                                             is_cdata))
+        syntax_error(ld, "Invalid NOTATION name.\n");
+
+    return ch;
+}
+
+static int P_rn_rule(repl_loader *ld, int ch)
+{
+    char name[NAMELEN+1];
+    char *repl_text[1];
+    enum rn_ rn;
+
+    assert(ch == '@');
+
+    ch = P_rni_name(ld, ch, &rn, name);
+    ch = P_repl_text(ld, ch, repl_text);
+    free((void*)ld->rules->rn_repl[rn]);
+    ld->rules->rn_repl[rn] = repl_text[0];
+    return ch;
+}
+
+static int P_comment(repl_loader *ld, int ch, const char lit)
+{
+    assert(ch == '/' && lit == '*');
+
+    ch = GETC(ch);
+    assert(ch == '*');
+
+    while ((ch = GETC(ch)) != EOF)
+	if (ch == '*' && PEEK() == '/') {
+	    break;
+	}
+
+    assert(ch == '*' || ch == EOF);
+    ch = GETC(ch);
+    assert(ch == '/' || ch == EOF);
+    ch = GETC(ch);
+
+    return ch;
+}
+
+static int P_repl_defs(repl_loader *ld, int ch)
+{
+    while (ch != EOF) {
+	P_S(ch);
+
+	if (ch == EOF)
+	    break;
+
+	if (ch == '@')
+	    ch = P_rn_rule(ld, ch);
+	else if (ch == '/' && PEEK() == '*')
+	    ch = P_comment(ld, ch, '*');
+	else
+	    ch = P_sel_rule(ld, ch);
+    }
+    return ch;
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+ * Creating, loading (ie parsing and interpreting), and freeing
+ * Replacement Definitions.
+ */
+
+cm2doc_rules *cm2doc_rules_new(void)
+{
+    const textidx_t null_idx = 0U;
+    cm2doc_rules *rules = calloc(1U, sizeof *rules);
+
+    if (rules == NULL)
+	return NULL;
+
+    /*
+     * Initializing the character buffer. Note that NULLIDX acts as
+     * a sentinel, thus we push a NUL so that index 0 (ie NULLIDX)
+     * is occupied and "out of use".
+     */
+    octetbuf_init(&rules->text_buf, 2048U);
+    octetbuf_push_c(&rules->text_buf, NUL);
+
+    /*
+     * Same for the atoms: NULLATOM is the empty string.
+     */
+    octetbuf_init(&rules->atoms, 0U);
+    octetbuf_push_back(&rules->atoms, &null_idx, sizeof null_idx);
+    octetbuf_init(&rules->atom_flags, 0U);
+    octetbuf_push_c(&rules->atom_flags, 0);
+
+    return rules;
+}
+
+unsigned cm2doc_rules_load(cm2doc_rules *rules, FILE *replfp,
+                                                   const char *filename)
+{
+    repl_loader ld[1];
+    int ch;
+
+    assert(rules != NULL);
+    if (replfp == NULL) return 0U;
+
+    ld->rules    = rules;
+    ld->replfp   = replfp;
+    ld->filename = (filename != NULL) ? filename : "<no file>";
+    ld->lineno   = 0U;
+    ld->colno    = 0U;
+    ld->la_num   = 0U;
+    ld->nerr     = 0U;
+    octetbuf_init(&ld->repl, 0U);
+    octetbuf_init(&ld->lit, 0U);
+
+    /*
+     * Move to start of first line.
+     */
+    COUNT_EOL(EOL);
+
+    /*
+     * Parse and process replacement definitions. All parsing
+     * results are stored in the `rules`.
+     */
+    ch = GETC(ch);
+    ch = P_repl_defs(ld, ch);
+    assert(ch == EOF);
+
+    octetbuf_fini(&ld->repl);
+    octetbuf_fini(&ld->lit);
+    return ld->nerr;
+}
+
+void cm2doc_rules_free(cm2doc_rules *rules)
+{
+    int nt;
+    int rn;
+
+    if (rules == NULL)
+	return;
+
+    for (nt = 0; nt < NODE_NUM; ++nt) {
+	struct repl_ *rp, *next;
+	for (rp = rules->repl_tab[nt]; rp != NULL; rp = next) {
+	    next = rp->next;
+	    free((void*)rp->repl[0]);
+	    free((void*)rp->repl[1]);
+	    free(rp);
+	}
+    }
+    for (rn = 0; rn < RN_NUM; ++rn)
+	free((void*)rules->rn_repl[rn]);
+
+    while (rules->notations != NULL) {
+	struct notation_name_ *pn = rules->notations;
+	rules->notations = pn->next;
+	free((void*)pn->name);
+	free(pn);
+    }
+
+    octetbuf_fini(&rules->text_buf);
+    octetbuf_fini(&rules->atoms);
+    octetbuf_fini(&rules->atom_flags);
+    free(rules->atom_hash);
+    free(rules);
+}
+
+
+/*== Compiled Replacement Definitions ================================*/
+
+/*
+ * The image of a `cm2doc_rules` is a sequence of `uint32_t` words
+ * (in native byte order), preceded by a pool of the strings:
+ *
+ *     npool, pool[npool] (padded to a multiple of 4 octets),
+ *     natoms, ( stroff, flags ) * (natoms-1),
+ *     nrules, ( nt, is_cdata, stroff, len, stroff, len,
+ *               nsels, ( name, val ) * nsels ) * nrules,
+ *     ( stroff, len ) * RN_NUM
+ *
+ * A NULL replacement text has `stroff` == NOSTR. The rules for each
+ * node type are in load order (ie oldest first), so that adding them
+ * one by one rebuilds the rule lists.
+ */
+
+#define NOSTR 0xFFFFFFFFUL
+
+/*
+ * The length of an encoded replacement text, including the final NUL
+ * (the attribute substitutions contain NUL characters, see
+ * `P_attr_subst()`).
+ */
+static size_t repl_size(const char *repl)
+{
+    const char *p = repl;
+
+    while (*p != NUL)
+	if (*p == SO)
+	    p += 2U + strlen(p + 2U) + 2U;
+	else
+	    ++p;
+    return (size_t)(p - repl) + 1U;
+}
+
+static void put_u32(octetbuf *img, unsigned long u)
+{
+    uint32_t u32 = (uint32_t)u;
+    octetbuf_push_back(img, &u32, sizeof u32);
+}
+
+static void put_str(octetbuf *img, octetbuf *pool,
+                                           const char *s, size_t len)
+{
+    if (s == NULL) {
+	put_u32(img, NOSTR);
+	put_u32(img, 0U);
+    } else {
+	put_u32(img, octetbuf_push_back(pool, s, len));
+	put_u32(img, len);
+    }
+}
+
+static void put_rules(octetbuf *img, octetbuf *pool,
+                      const struct repl_ *rp, unsigned long *pnrules)
+{
+    const struct sel_ *sel;
+    size_t nsels;
+
+    if (rp == NULL)
+	return;
+    put_rules(img, pool, rp->next, pnrules); /* Oldest first. */
+
+    put_u32(img, rp->taginfo.nt);
+    put_u32(img, rp->is_cdata);
+    put_str(img, pool, rp->repl[0],
+                     (rp->repl[0] != NULL) ? repl_size(rp->repl[0]) : 0U);
+    put_str(img, pool, rp->repl[1],
+                     (rp->repl[1] != NULL) ? repl_size(rp->repl[1]) : 0U);
+    for (nsels = 0U; rp->taginfo.sels[nsels].name != NULLATOM; ++nsels)
+	;
+    put_u32(img, nsels);
+    for (sel = rp->taginfo.sels; sel->name != NULLATOM; ++sel) {
+	put_u32(img, sel->name);
+	put_u32(img, sel->val);
+    }
+    ++*pnrules;
+}
+
+void *cm2doc_rules_image(const cm2doc_rules *rules, size_t *psize)
+{
+    octetbuf img[1], pool[1];
+    unsigned long nrules = 0U;
+    size_t nrules_at, npad;
+    uint32_t u32;
+    atom_t a;
+    int nt, rn;
+    void *res;
+
+    octetbuf_init(img,  0U);
+    octetbuf_init(pool, 0U);
+
+    for (a = 1U; a < NATOMS(rules); ++a) {
+	put_u32(img, octetbuf_push_s(pool, ATOM_TEXT(rules, a)));
+	octetbuf_push_c(pool, NUL);
+	put_u32(img, ATOM_FLAGS(rules, a));
+    }
+    nrules_at = octetbuf_size(img);
+    put_u32(img, 0U);
+    for (nt = 0; nt < NODE_NUM; ++nt)
+	put_rules(img, pool, rules->repl_tab[nt], &nrules);
+    u32 = (uint32_t)nrules;
+    memcpy(octetbuf_at(img, nrules_at), &u32, sizeof u32);
+    for (rn = 0; rn < RN_NUM; ++rn) {
+	const char *r = rules->rn_repl[rn];
+	put_str(img, pool, r, (r != NULL) ? repl_size(r) : 0U);
+    }
+
+    /*
+     * Now glue it together: the pool, and the words.
+     */
+    npad = (4U - octetbuf_size(pool) % 4U) % 4U;
+    while (npad-- > 0U)
+	octetbuf_push_c(pool, NUL);
+
+    *psize = 2U * sizeof(uint32_t) + octetbuf_size(pool) +
+                                                     octetbuf_size(img);
+    if ((res = malloc(*psize)) != NULL) {
+	char *p = res;
+
+	u32 = (uint32_t)octetbuf_size(pool);
+	memcpy(p, &u32, sizeof u32);			p += sizeof u32;
+	memcpy(p, octetbuf_ptr(pool), u32);		p += u32;
+	u32 = (uint32_t)NATOMS(rules);
+	memcpy(p, &u32, sizeof u32);			p += sizeof u32;
+	memcpy(p, octetbuf_ptr(img), octetbuf_size(img));
+    }
+
+    octetbuf_fini(img);
+    octetbuf_fini(pool);
+    return res;
+}
+
+/*
+ * Reading an image: all accesses are checked against the image size.
+ */
+
+struct image_reader_ {
+    const char *p, *end;
+    const char *pool;
+    size_t      npool;
+    bool        bad;
+};
+
+static unsigned long get_u32(struct image_reader_ *rd)
+{
+    uint32_t u32 = 0U;
+
+    if (rd->end - rd->p < (ptrdiff_t)sizeof u32)
+	rd->bad = true;
+    else {
+	memcpy(&u32, rd->p, sizeof u32);
+	rd->p += sizeof u32;
+    }
+    return u32;
+}
+
+/*
+ * Get a string (from `malloc()`), NULL if the image has none -- or if
+ * it is invalid.
+ */
+static char *get_str(struct image_reader_ *rd)
+{
+    unsigned long off = get_u32(rd);
+    unsigned long len = get_u32(rd);
+    char *s;
+
+    if (rd->bad || off == NOSTR)
+	return NULL;
+    if (off > rd->npool || len > rd->npool - off || len == 0U ||
+                                         rd->pool[off + len - 1U] != NUL) {
+	rd->bad = true;
+	return NULL;
+    }
+    if ((s = malloc(len)) != NULL)
+	memcpy(s, rd->pool + off, len);
+    return s;
+}
+
+int cm2doc_rules_load_image(cm2doc_rules *rules,
+                            const void *image, size_t size)
+{
+    struct image_reader_ rd[1];
+    atom_t *amap = NULL;
+    unsigned long natoms, nrules, k;
+    int rn;
+
+    rd->p     = image;
+    rd->end   = rd->p + size;
+    rd->bad   = false;
+    rd->npool = get_u32(rd);
+    rd->pool  = rd->p;
+    if (rd->bad || rd->npool > size || (rd->npool % 4U) != 0U)
+	return -1;
+    rd->p += rd->npool;
+
+    /*
+     * Intern the atoms of the image, giving the map from the
+     * atoms in the image to the atoms in `rules`.
+     */
+    natoms = get_u32(rd);
+    if (rd->bad || natoms == 0U || natoms > size)
+	return -1;
+    amap = calloc(natoms, sizeof *amap);
+    for (k = 1U; k < natoms && !rd->bad; ++k) {
+	unsigned long off   = get_u32(rd);
+	unsigned long flags = get_u32(rd);
+	size_t len;
+
+	if (rd->bad || off >= rd->npool ||
+	        (len = strlen(rd->pool + off)) >= rd->npool - off) {
+	    rd->bad = true;
+	    break;
+	}
+	amap[k] = atom_intern(rules, rd->pool + off, len);
+	ATOM_FLAGS(rules, amap[k]) |= (unsigned char)flags;
+    }
+
+    /*
+     * Add the rules.
+     */
+    nrules = get_u32(rd);
+    for (k = 0U; k < nrules && !rd->bad; ++k) {
+	struct taginfo_ taginfo;
+	char *repl_texts[2];
+	bool is_cdata;
+	unsigned long nsels, i;
+
+	taginfo.nt    = (cmark_node_type)get_u32(rd);
+	is_cdata      = get_u32(rd) != 0U;
+	repl_texts[0] = get_str(rd);
+	repl_texts[1] = get_str(rd);
+	nsels         = get_u32(rd);
+
+	if (taginfo.nt >= NODE_NUM || nsels > ATTCNT)
+	    rd->bad = true;
+	for (i = 0U; i < nsels && !rd->bad; ++i) {
+	    unsigned long name = get_u32(rd);
+	    unsigned long val  = get_u32(rd);
+
+	    if (name == NULLATOM || name >= natoms || val >= natoms)
+		rd->bad = true;
+	    else {
+		taginfo.sels[i].name = amap[name];
+		taginfo.sels[i].val  = amap[val];
+	    }
+	}
+	if (rd->bad) {
+	    free(repl_texts[0]);
+	    free(repl_texts[1]);
+	    break;
+	}
+	taginfo.sels[nsels].name = NULLATOM;
+
+	set_repl(rules, &taginfo, (const char **)repl_texts, is_cdata);
+    }
+
+    /*
+     * The replacement texts for the reserved names.
+     */
+    for (rn = 0; rn < RN_NUM && !rd->bad; ++rn) {
+	char *r = get_str(rd);
+	if (r != NULL) {
+	    free((void*)rules->rn_repl[rn]);
+	    rules->rn_repl[rn] = r;
+	}
+    }
+
+    free(amap);
+    return rd->bad ? -1 : 0;
+}
+
+
+/*== Rendering Documents =============================================*/
+
+/*
+ * gen_document -- Driver for the replacement backend
+ *
+ *  1. Start the outermost "universal" pseudo-element.
+ *  2. Output the replacement text for #PROLOG, if any.
+ *  3. Render the document into the given ESIS API callbacks.
+ *  4. Output the replacement text for #EPILOG, if any.
+ *  5. End the outermost pseudo-element.
+ *  6. [Not needed]: Clean up the attribute stack.
+ */
+
+static void gen_document(cmark_node *document, cm2doc_ctx *ctx)
+{
+    const ESIS_CB *esis_cb = ctx->port.cb;
+    ESIS_UserData  esis_ud = ctx->port.ud;
+    const char *const *rn_repl = (ctx->rules != NULL) ?
+                                             ctx->rules->rn_repl : NULL;
+
+    DO_START(CMARK_NODE_NONE);
+
+    if (rn_repl != NULL && rn_repl[RN_PROLOG] != NULL) {
+	put_repl(ctx, rn_repl[RN_PROLOG]);
+    }
+
+    render_esis(document, ctx);
+
+    if (rn_repl != NULL && rn_repl[RN_EPILOG] != NULL) {
+	put_repl(ctx, rn_repl[RN_EPILOG]);
+    }
+    DO_END(CMARK_NODE_NONE);
+}
+
+static size_t file_write(void *ud, const char *data, size_t len)
+{
+    return fwrite(data, 1U, len, ud);
+}
+
+cm2doc_ctx *cm2doc_ctx_new(const cm2doc_rules *rules, unsigned flags,
+                           cmark_option_t options, FILE *outfp)
+{
+    cm2doc_ctx *ctx;
+
+    ctx = cm2doc_ctx_new_sink(rules, flags, options, file_write, outfp);
+    if (ctx != NULL)
+	ctx->outfp = outfp;
+    return ctx;
+}
+
+cm2doc_ctx *cm2doc_ctx_new_sink(const cm2doc_rules *rules,
+                                unsigned flags, cmark_option_t options,
+                                cm2doc_write_fn *sink, void *userdata)
+{
+    static cmark_mem stdmem = { calloc, realloc, free };
+    cm2doc_ctx *ctx;
+
+    assert(rules != NULL || (flags & CM2DOC_RAST));
+
+    if ((ctx = calloc(1U, sizeof *ctx)) == NULL)
+	return NULL;
+
+    ctx->rules     = rules;
+    ctx->flags     = flags;
+    ctx->options   = options;
+    ctx->port.cb   = (flags & CM2DOC_RAST) ? &rast_CB : &repl_CB;
+    ctx->port.ud   = ctx;
+    ctx->parser    = NULL;
+    ctx->in_header = true;
+    ctx->sink      = sink;
+    ctx->sink_ud   = userdata;
+    ctx->outfp     = NULL;
+    ctx->outbol    = true;
+    ctx->outlen    = 0U;
+
+    /*
+     * Initializing character buffers. Note that NULLIDX acts as
+     * a sentinel, thus we push a NUL in the attribute buffer so
+     * that index 0 (ie NULLIDX) is occupied and "out of use".
+     *
+     * The name-index and value-index buffers are simply empty
+     * at the beginning.
+     */
+    octetbuf_init(&ctx->attr_buf, ATTSPLEN);
+    octetbuf_push_c(&ctx->attr_buf, NUL);
+    octetbuf_init(&ctx->nameidx_buf, ATTCNT * sizeof(nameidx_t));
+    octetbuf_init(&ctx->validx_buf,  ATTCNT * sizeof(validx_t));
+
+    cmark_strbuf_init(&stdmem, &ctx->houdini, 1024);
+
+    /*
+     * The selector slots, one per atom.
+     */
+    if (rules != NULL && !(flags & CM2DOC_RAST))
+	ctx->slots = calloc(NATOMS(rules), sizeof *ctx->slots);
+    ctx->gen = 1U;
+    octetbuf_init(&ctx->rule_stack, 0U);
+    octetbuf_init(&ctx->head_buf, 0U);
+
+    return ctx;
+}
+
+void cm2doc_ctx_set_meta(cm2doc_ctx *ctx,
+                         const char *const defaults[],
+                         const char *const meta[])
+{
+    ctx->defaults = defaults;
+    ctx->meta     = meta;
+}
+
+/*
+ * Set the meta-data from the complete header at the start of `data`,
+ * and feed the rest into the parser.
+ */
+static void feed_header(cm2doc_ctx *ctx, const char *data, size_t len)
+{
+    const ESIS_CB *esis_cb = ctx->port.cb;
+    ESIS_UserData  esis_ud = ctx->port.ud;
+    const char *const *meta = ctx->meta;
+    size_t hbytes;
+
+    hbytes = do_meta_lines(data, len, ctx);
+
+    /*
+     * Override meta-data from meta-lines with meta-data
+     * given by the application, eg in command-line option
+     * arguments like `--title`.
+     */
+    if (meta != NULL)
+	for ( ; meta[0] != NULL; meta += 2)
+	    DO_ATTR(meta[0], meta[1], NTS);
+
+    ctx->in_header = false;
+
+    assert(hbytes <= len);
+
+    if (ctx->parser == NULL)
+	ctx->parser = cmark_parser_new(ctx->options);
+    if (hbytes < len)
+	cmark_parser_feed(ctx->parser, data + hbytes, len - hbytes);
+}
+
+void cm2doc_feed(cm2doc_ctx *ctx, const char *data, size_t len)
+{
+    bool done;
+
+    if (!ctx->in_header) {
+	cmark_parser_feed(ctx->parser, data, len);
+	return;
+    }
+
+    /*
+     * Usually the header is complete in the first chunk (or there is
+     * none), otherwise collect it until it is.
+     */
+    if (octetbuf_empty(&ctx->head_buf)) {
+	header_len(data, len, &done);
+	if (done) {
+	    feed_header(ctx, data, len);
+	    return;
+	}
+    }
+    octetbuf_push_back(&ctx->head_buf, data, len);
+    header_len(octetbuf_ptr(&ctx->head_buf),
+                                    octetbuf_size(&ctx->head_buf), &done);
+    if (done) {
+	feed_header(ctx, octetbuf_ptr(&ctx->head_buf),
+	                                    octetbuf_size(&ctx->head_buf));
+	octetbuf_clear(&ctx->head_buf);
+    }
+}
+
+unsigned cm2doc_finish(cm2doc_ctx *ctx)
+{
+    cmark_node *document;
+    unsigned    nerr;
+
+    /*
+     * The header ends with the document at the latest, and an empty
+     * document still gets the meta-data attributes.
+     */
+    if (ctx->in_header) {
+	feed_header(ctx, octetbuf_ptr(&ctx->head_buf),
+	                                    octetbuf_size(&ctx->head_buf));
+	octetbuf_clear(&ctx->head_buf);
+    }
+
+    /*
+     * Finished parsing, generate document content into the
+     * output.
+     */
+    document = cmark_parser_finish(ctx->parser);
+    gen_document(document, ctx);
+    cmark_node_free(document);
+
+    out_flush(ctx);
+    if (ctx->outfp != NULL)
+	fflush(ctx->outfp);
+
+    /*
+     * Make the context ready for the next document: the next
+     * `cm2doc_feed()` creates a new parser.
+     */
+    cmark_parser_free(ctx->parser);
+    ctx->parser    = NULL;
+    ctx->in_header = true;
+    ctx->outbol    = true;
+    ctx->is_cdata  = false;
+    discard_atts(ctx);
+    octetbuf_clear(&ctx->rule_stack);
+
+    nerr = ctx->nerr;
+    ctx->nerr = 0U;
+    return nerr;
+}
+
+void cm2doc_ctx_free(cm2doc_ctx *ctx)
+{
+    if (ctx == NULL)
+	return;
+
+    if (ctx->parser != NULL) {
+	/*
+	 * Discard an unfinished document.
+	 */
+	cmark_node_free(cmark_parser_finish(ctx->parser));
+	cmark_parser_free(ctx->parser);
+    }
+    cmark_strbuf_free(&ctx->houdini);
+    octetbuf_fini(&ctx->attr_buf);
+    octetbuf_fini(&ctx->nameidx_buf);
+    octetbuf_fini(&ctx->validx_buf);
+    octetbuf_fini(&ctx->rule_stack);
+    octetbuf_fini(&ctx->head_buf);
+    free(ctx->slots);
+    free(ctx);
+}
+
+/*== EOF ============================ vim:tw=72:sts=0:et:cin:fo=croq:sta
+                                               ex: set ts=8 sw=4 ai : */
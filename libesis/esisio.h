@@ -36,7 +36,7 @@
 #include <stdint.h> /* uintptr_t */
 #include "esisio_external.h"
 
-#ifdef ESIS_XMLPARSE   /* NOT IMPLEMENTED */
+#ifdef ESIS_XMLPARSE
 # include <xmlparse.h> /* Use Expat as a front end for XML input. */
 #endif
 
@@ -86,7 +86,22 @@ struct ESIS_el {
 ESIS_Parser ESISAPI
 ESIS_ParserCreate(const ESIS_Char *encoding);
 
-#ifdef ESIS_XMLPARSE /* NOT IMPLEMENTED */
+#ifdef ESIS_XMLPARSE
+/*
+   Creates a parser that takes its input from the Expat parser
+   xmlParser: the element handlers are called directly from Expat's
+   callbacks (which are set up on xmlParser, as is its user data), so
+   no ESIS text is written and read again in between.
+
+   ESIS_ParseFile and ESIS_FilterFile read the input file in large
+   blocks into the buffers of xmlParser, and ESIS_Parse, ESIS_GetBuffer
+   and ESIS_ParseBuffer work like the corresponding XML_* functions.
+   When filtering, unhandled elements are written as ESIS text.
+
+   The application still owns xmlParser, and frees it after the
+   ESIS_Parser. This function is in esisxml.c, the only part of the
+   library that needs Expat.
+ */
 ESIS_Parser ESISAPI
 ESIS_XmlParserCreate(XML_Parser xmlParser);
 #endif
@@ -275,6 +290,15 @@ typedef int (ESISCALL *ESIS_UnknownEncodingHandler) (
 
    The last call to ESIS_Parse must have isFinal true; len may be zero
    for this call (or any other).
+
+   [NOTE: On ESIS text input, all pieces before the final one are
+   collected by the parser; a single final piece is scanned in place.]
+
+   ESIS_ParseFileName and ESIS_FilterFileName map a regular file into
+   memory and parse it with one call to ESIS_Parse; other files (like
+   pipes) are read with ESIS_ParseFile rsp ESIS_FilterFile. They are
+   in esismap.c. If they fail, the file stays mapped until the parser
+   is freed, so the XML parser can still report the error position.
  */
 
 int ESISAPI
@@ -292,6 +316,13 @@ ESIS_GetBuffer(ESIS_Parser parser, size_t len);
 int ESISAPI
 ESIS_ParseBuffer(ESIS_Parser parser, size_t len, int isFinal);
 
+int ESISAPI
+ESIS_ParseFileName(ESIS_Parser parser, const char *fileName);
+
+int ESISAPI
+ESIS_FilterFileName(ESIS_Parser parser, const char *fileName,
+                    FILE *outputFile);
+
 /*
    Frees memory used by the parser.
  */
@@ -92,6 +92,29 @@ struct ESIS_ParserStruct {
   void                 *userData;
   FILE                 *infp;
   FILE                 *outfp;
+  
+  const byte           *ip;       /* Next input byte,                 */
+  const byte           *iend;     /* end of the input in memory.      */
+  struct esis_stack_    IN[1];    /* Input buffer.                    */
+  
+  /*
+   * Set up by ESIS_XmlParserCreate for input from an XML parser, see
+   * esisxml.c: parsefunc parses s[0..len), or len bytes in the buffer
+   * last returned by bufferfunc if s is NULL.
+   */
+  void                 *xp;
+  int                 (*parsefunc)(ESIS_Parser, const char *s, size_t len,
+                                                            int isFinal);
+  void             *(*bufferfunc)(ESIS_Parser, size_t len);
+  ESIS_Writer           writer;   /* For unhandled elements, if filtering. */
+  ref                   r_frame;  /* Frame of inner-most open element.    */
+  
+  /*
+   * A file mapped by ESIS_ParseFileName that failed to parse is kept
+   * until the parser is freed, see esismap.c; mapfree releases it.
+   */
+  void                 *map;
+  void                (*mapfree)(void *map);
 };
 
 struct hi {
@@ -104,6 +127,9 @@ struct hi {
 
 #define HANDLER ((struct hi *)pe->HI->buf)
 
+extern void       ESIS_SortHandlers_(ESIS_Parser);
+extern struct hi *ESIS_FindHandler_(ESIS_Parser, const ESIS_Char *elemGI);
+
 #define ERROR_SET(E_) do { \
        if (!pe->err && !(pe->err = pe->S->err)) pe->err = (E_); } while (0)
 
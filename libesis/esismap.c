@@ -0,0 +1,197 @@
+/* esismap.c */
+
+/*
+ * Parsing a named file: a regular file is mapped into memory and given
+ * to ESIS_Parse in one piece, so neither reader copies the input into
+ * buffers of its own (the same idea as xmlwf's filemap). Files that
+ * can not be mapped, like pipes, are read with ESIS_ParseFile rsp
+ * ESIS_FilterFile.
+ *
+ * If the parse fails, the mapping is kept until the parser is freed
+ * or parses the next file: Expat's error position (as returned by
+ * XML_GetCurrentLineNumber) still points into the input.
+ */
+
+#include "esisio.h"
+#include "esisio_int.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define STRICT 1
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef MAP_FILE
+#define MAP_FILE 0
+#endif
+#endif
+
+struct map {
+  const char *data;
+  size_t      size;
+#ifdef _WIN32
+  HANDLE      f;
+  HANDLE      m;
+#else
+  int         fd;
+#endif
+};
+
+/*
+ * Returns 1 if the file is mapped (or empty), else 0.
+ */
+#ifdef _WIN32
+
+static int MapOpen(struct map *pm, const char *name)
+{
+  static const char empty = '\0';
+  DWORD size, sizeHi;
+
+  pm->f = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL,
+                      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  pm->m = NULL;
+  if (pm->f == INVALID_HANDLE_VALUE)
+    return 0;
+  if (GetFileType(pm->f) != FILE_TYPE_DISK ||
+      (size = GetFileSize(pm->f, &sizeHi)) == (DWORD)-1 || sizeHi != 0) {
+    CloseHandle(pm->f);
+    return 0;
+  }
+  /* CreateFileMapping barfs on zero length files */
+  if (size == 0) {
+    pm->data = &empty;
+    pm->size = 0U;
+    return 1;
+  }
+  pm->m = CreateFileMapping(pm->f, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (pm->m == NULL) {
+    CloseHandle(pm->f);
+    return 0;
+  }
+  pm->data = MapViewOfFile(pm->m, FILE_MAP_READ, 0, 0, 0);
+  if (pm->data == NULL) {
+    CloseHandle(pm->m);
+    CloseHandle(pm->f);
+    return 0;
+  }
+  pm->size = size;
+  return 1;
+}
+
+static void MapClose(struct map *pm)
+{
+  if (pm->m != NULL) {
+    UnmapViewOfFile(pm->data);
+    CloseHandle(pm->m);
+  }
+  CloseHandle(pm->f);
+}
+
+#else
+
+static int MapOpen(struct map *pm, const char *name)
+{
+  static const char empty = '\0';
+  struct stat sb;
+  void *p;
+
+  pm->fd = open(name, O_RDONLY);
+  if (pm->fd < 0)
+    return 0;
+  if (fstat(pm->fd, &sb) < 0 || !S_ISREG(sb.st_mode) ||
+      (off_t)(size_t)sb.st_size != sb.st_size) {
+    close(pm->fd);
+    return 0;
+  }
+  pm->size = (size_t)sb.st_size;
+  if (pm->size == 0U) {
+    pm->data = &empty;
+    return 1;
+  }
+  p = mmap(NULL, pm->size, PROT_READ, MAP_FILE|MAP_PRIVATE, pm->fd, (off_t)0);
+  if (p == MAP_FAILED) {
+    close(pm->fd);
+    return 0;
+  }
+#ifdef MADV_SEQUENTIAL
+  madvise(p, pm->size, MADV_SEQUENTIAL);
+#endif
+  pm->data = p;
+  return 1;
+}
+
+static void MapClose(struct map *pm)
+{
+  if (pm->size > 0U)
+    munmap((void *)pm->data, pm->size);
+  close(pm->fd);
+}
+
+#endif
+
+static void MapFree(void *pm)
+{
+  MapClose(pm);
+  free(pm);
+}
+
+static int ParseFileName(ESIS_Parser pe, const char *fileName, FILE *outfp)
+{
+  struct map m;
+  FILE *fp;
+  int ok;
+
+  if (pe->map != NULL) {
+    pe->mapfree(pe->map);
+    pe->map = NULL;
+  }
+  if (!MapOpen(&m, fileName)) {
+    if ((fp = fopen(fileName, "rb")) == NULL) {
+      ERROR_SET(ESIS_ERROR_FILE_READ);
+      return 0;
+    }
+    ok = (outfp != NULL) ? ESIS_FilterFile(pe, fp, outfp)
+                         : ESIS_ParseFile(pe, fp);
+    fclose(fp);
+    return ok;
+  }
+
+  pe->outfp = outfp;
+  if (pe->xp != NULL && outfp != NULL)
+    pe->writer = ESIS_WriterCreate(outfp, 0U);
+
+  ok = ESIS_Parse(pe, m.data, m.size, 1);
+
+  if (pe->writer != NULL) {
+    ESIS_WriterFree(pe->writer);
+    pe->writer = NULL;
+  }
+  pe->outfp = NULL;
+  if (ok || (pe->map = malloc(sizeof m)) == NULL) {
+    MapClose(&m);
+  } else {
+    memcpy(pe->map, &m, sizeof m);
+    pe->mapfree = MapFree;
+  }
+  return ok;
+}
+
+int ESISAPI
+ESIS_ParseFileName(ESIS_Parser pe, const char *fileName)
+{
+  return ParseFileName(pe, fileName, NULL);
+}
+
+int ESISAPI
+ESIS_FilterFileName(ESIS_Parser pe, const char *fileName, FILE *outputFile)
+{
+  return ParseFileName(pe, fileName, outputFile);
+}
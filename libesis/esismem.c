@@ -58,7 +58,7 @@ ref esisStackRelease(struct esis_stack_ *p, ref r)
   return r;
 }
 
-ref esisStackPush(struct esis_stack_ *p, void *v, size_t n)
+ref esisStackPush(struct esis_stack_ *p, const void *v, size_t n)
 {
   int err = ESIS_ERROR_NONE;
   
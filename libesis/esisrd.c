@@ -8,15 +8,6 @@
 #include <string.h>
 
 
-#ifdef ESIS_XMLPARSE /* NOT IMPLEMENTED */
-ESIS_Parser ESISAPI
-ESIS_XmlParserCreate(XML_Parser xmlParser)
-{
-  return NULL;
-}
-#endif
-
-
 #ifndef NDEBUG /* NOT IMPLEMENTED */
 ESIS_Bool ESISAPI
 ESIS_ParserReset(ESIS_Parser pe, const ESIS_Char *encoding)
@@ -78,13 +69,72 @@ static int cmp_hi(const void *lhs, const void *rhs)
   return strcmp(lhi->elemGI, rhi->elemGI);
 }
 
+void ESIS_SortHandlers_(ESIS_Parser pe)
+{
+  unsigned n_hi = pe->n_hi;
+  struct hi *p_hi = HANDLER;
+  
+  if (n_hi > 0U) {
+    unsigned k;
+    const char *hdbuf = pe->HD->buf;
+    
+    for (k = 0; k < n_hi; ++k)
+      p_hi[k].elemGI = hdbuf + p_hi[k].r_ElemGI;
+      
+    qsort(p_hi, n_hi, sizeof p_hi[0], cmp_hi);
+  }
+}
+
+struct hi *ESIS_FindHandler_(ESIS_Parser pe, const ESIS_Char *elemGI)
+{
+  struct hi hi;
+  
+  if (pe->n_hi == 0U)
+    return NULL;
+  hi.elemGI = elemGI;
+  return bsearch(&hi, HANDLER, pe->n_hi, sizeof hi, cmp_hi);
+}
+
+#define READ_SIZE (64U * 1024U)
+
+/*
+ * The input is scanned from memory: either all of it (see ParseMemory),
+ * or a block at a time read from the input file into the IN stack.
+ */
+#define GETC() ( (pe->ip < pe->iend) ? *pe->ip++ : Refill(pe) )
+
+static int Refill(ESIS_Parser pe)
+{
+  struct esis_stack_ *in = pe->IN;
+  size_t len;
+  
+  if (pe->infp == NULL)
+    return EOF;
+  if (in->buf == NULL)
+    esisStackInit(in);
+  if (!in->err && in->lim < READ_SIZE)
+    esisStackGrow(in, READ_SIZE - in->lim);
+  if (in->err) {
+    ERROR_SET(in->err);
+    return EOF;
+  }
+  len = fread(in->buf, 1, READ_SIZE, pe->infp);
+  if (len == 0U) {
+    if (ferror(pe->infp))
+      ERROR_SET(ESIS_ERROR_FILE_READ);
+    return EOF;
+  }
+  pe->ip   = in->buf;
+  pe->iend = in->buf + len;
+  return *pe->ip++;
+}
+
 static int store_attr(ESIS_Parser pe)
 {
   int ch;
   ref r = TOP();
-  FILE *fp = pe->infp;
   
-  while ((ch = getc(fp)) != EOF) {
+  while ((ch = GETC()) != EOF) {
     if (ch == '\n' || ch == ' ')
       break;
     PUSH_CHAR(ch);
@@ -94,7 +144,7 @@ static int store_attr(ESIS_Parser pe)
     return ESIS_ERROR_SYNTAX;
   }
   
-  while ((ch = getc(fp)) != EOF)
+  while ((ch = GETC()) != EOF)
     if (ch == '\n' || ch == ' ')
       break;
   if (ch != ' ') {
@@ -103,7 +153,7 @@ static int store_attr(ESIS_Parser pe)
   }
   
   PUSH_CHAR('\0');
-  while ((ch = getc(fp)) != EOF) {
+  while ((ch = GETC()) != EOF) {
     if (ch == '\n')
       break;
     PUSH_CHAR(ch);
@@ -115,15 +165,14 @@ static int store_attr(ESIS_Parser pe)
 static int store_name(ESIS_Parser pe)
 {
   int ch;
-  FILE *fp = pe->infp;
   ref r = TOP();
   
-  if ((ch = getc(fp)) != EOF) {
+  if ((ch = GETC()) != EOF) {
     if (ch == '\n')
       return ESIS_ERROR_SYNTAX;
     do
       PUSH_CHAR(ch);
-    while ((ch = getc(fp)) != EOF && ch != '\n');
+    while ((ch = GETC()) != EOF && ch != '\n');
   }
   PUSH_CHAR('\0');
   return ESIS_ERROR_NONE;
@@ -154,16 +203,15 @@ static void put_cdata(FILE *fp, const byte *data, size_t len)
 static size_t store_cdata(ESIS_Parser pe)
 {
   int ch;
-  FILE *fp = pe->infp;
   size_t n = 0U;
   unsigned num, ndig;
   char dig[DIG_MAX];
   
-  while ((ch = getc(fp)) != EOF) {
+  while ((ch = GETC()) != EOF) {
     if (ch == '\n')
       break;
     else if (ch == '\\') {
-      ch = getc(fp);
+      ch = GETC();
       switch (ch) {
        case EOF:
        case '\n':
@@ -179,14 +227,14 @@ static size_t store_cdata(ESIS_Parser pe)
            num = 8 * num + (ch - '0');
            dig[ndig++] = ch;
            if (ndig == 3) break;
-         } while ((ch = getc(fp)) != EOF && '0' <= ch && ch <= '7');
+         } while ((ch = GETC()) != EOF && '0' <= ch && ch <= '7');
          if (num != '\012') /* Ignore RS character. */
            PUSH_CHAR(num & 0xFF), ++n;
          break;
        case '#':
          num = 0;
          ndig = 0;
-         while ((ch = getc(fp)) != EOF && '0' <= ch && ch <= '9') {
+         while ((ch = GETC()) != EOF && '0' <= ch && ch <= '9') {
            num = 10 * num + (ch - '0');
            dig[ndig++] = ch;
            if (ndig == DIG_MAX) break;
@@ -227,7 +275,6 @@ static size_t store_cdata(ESIS_Parser pe)
 static void ParseLoop(ESIS_Parser pe)
 {
   int ch;
-  FILE *fp = pe->infp;
   FILE *outfp = pe->outfp;
   int err = ESIS_ERROR_NONE;
   const byte *data;
@@ -270,12 +317,12 @@ static void ParseLoop(ESIS_Parser pe)
   n_att = 0U;
   SET_FRAME;
   
-  while ((ch = getc(fp)) != EOF) {
+  while ((ch = GETC()) != EOF) {
     
     switch (ch) {
       case '?':
         /* :TODO: PI - Store for handler ? */
-        while ((ch = getc(fp)) != EOF)
+        while ((ch = GETC()) != EOF)
           if (ch == '\n')
             break;
           else if (outfp != NULL)
@@ -326,11 +373,7 @@ static void ParseLoop(ESIS_Parser pe)
         err = store_name(pe);
         ERROR_SET(err);
         if (!err) {
-          struct hi hi, *p_hi;
-          
-          hi.elemGI = P(frame.r_gi);
-          p_hi = HANDLER;
-          p_hi = bsearch(&hi, p_hi, pe->n_hi, sizeof hi, cmp_hi);
+          struct hi *p_hi = ESIS_FindHandler_(pe, P(frame.r_gi));
           
           if (p_hi != NULL || pe->handler != NULL) {
             ESIS_ElementHandler handler;
@@ -432,80 +475,163 @@ static void ParseLoop(ESIS_Parser pe)
   }
 }
 
-int ESISAPI
-ESIS_ParseFile(ESIS_Parser pe, FILE *inputFile)
+/*
+ * Read the input file in large blocks directly into the buffers of the
+ * XML parser, see ESIS_XmlParserCreate.
+ */
+static void ParseBuffers(ESIS_Parser pe)
 {
-  unsigned n_hi = pe->n_hi;
-  struct hi *p_hi = HANDLER;
+  FILE *fp = pe->infp;
+  void *buf;
+  size_t len;
+  int done;
   
-  if (n_hi > 0U) {
-    unsigned k;
-    const char *hdbuf = pe->HD->buf;
+  if (pe->outfp != NULL)
+    pe->writer = ESIS_WriterCreate(pe->outfp, 0U);
     
-    for (k = 0; k < n_hi; ++k)
-      p_hi[k].elemGI = hdbuf + p_hi[k].r_ElemGI;
-      
-    qsort(p_hi, n_hi, sizeof p_hi[0], cmp_hi);
+  do {
+    buf = pe->bufferfunc(pe, READ_SIZE);
+    if (buf == NULL) {
+      ERROR_SET(ESIS_ERROR_NO_MEMORY);
+      break;
+    }
+    len = fread(buf, 1, READ_SIZE, fp);
+    if (ferror(fp)) {
+      ERROR_SET(ESIS_ERROR_FILE_READ);
+      break;
+    }
+    done = len < READ_SIZE;
+  } while (pe->parsefunc(pe, NULL, len, done) && !done);
+  
+  if (pe->writer != NULL) {
+    ESIS_WriterFree(pe->writer);
+    pe->writer = NULL;
   }
+}
+
+int ESISAPI
+ESIS_ParseFile(ESIS_Parser pe, FILE *inputFile)
+{
+  ESIS_SortHandlers_(pe);
   
   pe->infp  = inputFile;
   pe->outfp = NULL;
   
-  ParseLoop(pe);
+  if (pe->xp != NULL)
+    ParseBuffers(pe);
+  else {
+    ParseLoop(pe);
+    pe->ip = pe->iend = NULL;
+  }
   
   ERROR_GET();
   return pe->err == ESIS_ERROR_NONE;
 }
 
+int ESISAPI
 ESIS_FilterFile(ESIS_Parser pe, FILE *inputFile, FILE *outputFile)
 {
-  unsigned n_hi = pe->n_hi;
-  struct hi *p_hi = HANDLER;
-  
-  if (n_hi > 0U) {
-    unsigned k;
-    const char *hdbuf = pe->HD->buf;
-    
-    for (k = 0; k < n_hi; ++k)
-      p_hi[k].elemGI = hdbuf + p_hi[k].r_ElemGI;
-      
-    qsort(p_hi, n_hi, sizeof p_hi[0], cmp_hi);
-  }
+  ESIS_SortHandlers_(pe);
   
   pe->infp  = inputFile;
   pe->outfp = outputFile;
   
+  if (pe->xp != NULL)
+    ParseBuffers(pe);
+  else {
+    ParseLoop(pe);
+    pe->ip = pe->iend = NULL;
+  }
+  
+  ERROR_GET();
+  return pe->err == ESIS_ERROR_NONE;
+}
+
+/*
+ * Parse ESIS text in memory, scanning the bytes directly.
+ */
+static int ParseMemory(ESIS_Parser pe, const char *s, size_t len)
+{
+  ESIS_SortHandlers_(pe);
+  
+  pe->infp = NULL;
+  pe->ip   = (const byte *)s;
+  pe->iend = pe->ip + len;
+  
   ParseLoop(pe);
   
+  pe->ip = pe->iend = NULL;
   ERROR_GET();
   return pe->err == ESIS_ERROR_NONE;
 }
 
-#ifndef NDEBUG /* NOT IMPLEMENTED */
+/*
+ * The ESIS text reader can not stop and resume in the middle of the
+ * input: pieces before the final one are collected in the IN stack,
+ * a single final piece (like a mapped file) is parsed in place.
+ */
+
 int ESISAPI
 ESIS_Parse(ESIS_Parser pe, const char *s, size_t len, int isFinal)
 {
-  return 0;
+  void *buf;
+  
+  if (pe->xp != NULL) {
+    ESIS_SortHandlers_(pe);
+    return pe->parsefunc(pe, s, len, isFinal);
+  }
+  if (isFinal && (pe->IN->buf == NULL || pe->IN->top == 0U))
+    return ParseMemory(pe, s, len);
+    
+  if ((buf = ESIS_GetBuffer(pe, len)) == NULL)
+    return 0;
+  if (len > 0U)
+    memcpy(buf, s, len);
+  return ESIS_ParseBuffer(pe, len, isFinal);
 }
-#endif
 
 
-#ifndef NDEBUG /* NOT IMPLEMENTED */
 void * ESISAPI
 ESIS_GetBuffer(ESIS_Parser pe, size_t len)
 {
-  return NULL;
+  struct esis_stack_ *in = pe->IN;
+  
+  if (pe->xp != NULL)
+    return pe->bufferfunc(pe, len);
+    
+  if (in->buf == NULL)
+    esisStackInit(in);
+  if (!in->err && in->top + len > in->lim)
+    esisStackGrow(in, (in->top + len - in->lim > in->lim) ?
+                      in->top + len - in->lim : in->lim);
+  if (in->err) {
+    ERROR_SET(in->err);
+    return NULL;
+  }
+  return in->buf + in->top;
 }
-#endif
 
 
-#ifndef NDEBUG /* NOT IMPLEMENTED */
 int ESISAPI
 ESIS_ParseBuffer(ESIS_Parser pe, size_t len, int isFinal)
 {
-  return 0;
+  struct esis_stack_ *in = pe->IN;
+  int ok;
+  
+  if (pe->xp != NULL) {
+    ESIS_SortHandlers_(pe);
+    return pe->parsefunc(pe, NULL, len, isFinal);
+  }
+  if (in->buf == NULL)
+    return 0;
+    
+  in->top += len;
+  if (!isFinal)
+    return 1;
+  ok = ParseMemory(pe, (const char *)in->buf, in->top);
+  in->top = 0U;
+  return ok;
 }
-#endif
 
 
 ESIS_Parser ESISAPI
@@ -545,6 +671,11 @@ fail:
 
 void ESISAPI ESIS_ParserFree(ESIS_Parser pe)
 {
+  if (pe->map != NULL)
+    pe->mapfree(pe->map);
+  free(pe->IN->buf);
+  free(pe->HI->buf);
+  free(pe->HD->buf);
   free(pe->S->buf);
   free(pe);
 }
@@ -0,0 +1,168 @@
+/* esisxml.c */
+
+/*
+ * ESIS events from an Expat XML parser: the Expat callbacks look up
+ * the ESIS_ElementHandler for each element and call it directly, no
+ * ESIS text is produced and parsed in between.
+ */
+
+#ifndef ESIS_XMLPARSE
+#define ESIS_XMLPARSE
+#endif
+
+#include "esisio.h"
+#include "esisio_int.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The frame of an open element is pushed onto the S stack, followed by
+ * the element's GI, and links back to the frame of the enclosing one.
+ */
+struct xfr {
+  ref                 r_prev;   /* Frame of enclosing element.          */
+  ESIS_ElementHandler handler;  /* NULL if no handler for this element. */
+  void               *userData;
+  long                elemID;
+  ESIS_Elem           elem;
+};
+
+#define NO_FRAME  (~(ref)0U)
+#define FRAME(R_) ((struct xfr *)P(R_))
+#define GI(R_)    ((const ESIS_Char *)P((R_) + sizeof(struct xfr)))
+
+static void
+StartElement(void *userData, const XML_Char *name, const XML_Char **atts)
+{
+  ESIS_Parser pe = userData;
+  struct hi *p_hi;
+  struct xfr *fr;
+  ref r;
+
+  ERROR_RET();
+
+  /*
+   * Align the frame, the stack top is just after the previous GI.
+   */
+  r = TOP();
+  r = (r + sizeof(void *) - 1U) / sizeof(void *) * sizeof(void *);
+  esisStackPush(pe->S, NULL, r - TOP() + sizeof *fr);
+  esisStackPush(pe->S, name, strlen(name) + 1U);
+  ERROR_RET();
+
+  fr = FRAME(r);
+  fr->r_prev = pe->r_frame;
+  pe->r_frame = r;
+
+  if ((p_hi = ESIS_FindHandler_(pe, name)) != NULL) {
+    fr->handler  = p_hi->handler;
+    fr->userData = p_hi->userData;
+    fr->elemID   = p_hi->elemID;
+  } else {
+    fr->handler  = pe->handler;
+    fr->userData = pe->userData;
+    fr->elemID   = pe->elemID;
+  }
+  fr->elem.elemGI   = GI(r);
+  fr->elem.atts     = atts;
+  fr->elem.userData = 0U;
+
+  if (fr->handler != NULL)
+    fr->handler(fr->userData, ESIS_START, fr->elemID, &fr->elem, NULL, 0U);
+  else if (pe->writer != NULL)
+    ESIS_Start(pe->writer, name, atts);
+}
+
+static void
+EndElement(void *userData, const XML_Char *name)
+{
+  ESIS_Parser pe = userData;
+  struct xfr *fr;
+  ref r = pe->r_frame;
+
+  ERROR_RET();
+
+  fr = FRAME(r);
+  if (fr->handler != NULL) {
+    fr->elem.elemGI = GI(r);
+    fr->elem.atts   = NULL;
+    fr->handler(fr->userData, ESIS_END, fr->elemID, &fr->elem, NULL, 0U);
+  } else if (pe->writer != NULL)
+    ESIS_End(pe->writer, name);
+
+  pe->r_frame = fr->r_prev;
+  RELEASE(r);
+}
+
+static void
+CharacterData(void *userData, const XML_Char *s, int len)
+{
+  ESIS_Parser pe = userData;
+  struct xfr *fr;
+  ref r = pe->r_frame;
+
+  ERROR_RET();
+  if (r == NO_FRAME || len <= 0)
+    return;
+
+  fr = FRAME(r);
+  if (fr->handler != NULL) {
+    fr->elem.elemGI = GI(r);
+    fr->elem.atts   = NULL;
+    fr->handler(fr->userData, ESIS_CDATA, fr->elemID, &fr->elem,
+                s, (size_t)len);
+  } else if (pe->writer != NULL)
+    ESIS_Cdata(pe->writer, s, (size_t)len);
+}
+
+static int
+XmlParse(ESIS_Parser pe, const char *s, size_t len, int isFinal)
+{
+  XML_Parser xp = pe->xp;
+  int ok;
+
+  if (s == NULL)
+    ok = XML_ParseBuffer(xp, (int)len, isFinal);
+  else {
+    /*
+     * Expat takes an int length: feed very large inputs in pieces.
+     */
+    for (; len > INT_MAX; s += INT_MAX, len -= INT_MAX)
+      if (!XML_Parse(xp, s, INT_MAX, 0))
+        break;
+    ok = len <= INT_MAX && XML_Parse(xp, s, (int)len, isFinal);
+  }
+  if (!ok)
+    ERROR_SET(ESIS_ERROR_SYNTAX);
+
+  ERROR_GET();
+  return pe->err == ESIS_ERROR_NONE;
+}
+
+static void *
+XmlGetBuffer(ESIS_Parser pe, size_t len)
+{
+  if (len > INT_MAX)
+    return NULL;
+  return XML_GetBuffer((XML_Parser)pe->xp, (int)len);
+}
+
+ESIS_Parser ESISAPI
+ESIS_XmlParserCreate(XML_Parser xmlParser)
+{
+  ESIS_Parser pe = ESIS_ParserCreate(NULL);
+  if (pe == NULL) return NULL;
+
+  pe->xp         = xmlParser;
+  pe->parsefunc  = XmlParse;
+  pe->bufferfunc = XmlGetBuffer;
+  pe->writer     = NULL;
+  pe->r_frame    = NO_FRAME;
+
+  XML_SetUserData(xmlParser, pe);
+  XML_SetElementHandler(xmlParser, StartElement, EndElement);
+  XML_SetCharacterDataHandler(xmlParser, CharacterData);
+
+  return pe;
+}
@@ -106,7 +106,7 @@ int picolParseVar(picolParser *p) {
   if(!parened && *(p->p-1)==')') {p->p--; p->len++;}
   if (p->start == p->p) { /* It's just a single char string "$" */
     picolParseString(p);
-    p->start--; p->len++; /* back to the $ sign */
+    p->start--; /* back to the $ sign, which was already counted */
     p->type = PT_STR;
     return PICOL_OK;
   } else RETURN_PARSED(PT_VAR);
@@ -131,66 +131,130 @@ int picolSetFmtResult(picolInterp* i, char* fmt, int result) {
   return picolSetResult(i,buf);
 }
 int picolErr(picolInterp *i, char* str) {
-  char buf[MAXSTR] = "";
+  size_t size = strlen(str)+1;
+  char  *buf;
   picolCallFrame *cf;
-  APPEND(buf,str);
+  if(i->current) size += strlen(i->current)+32;
+  for(cf = i->callframe; cf->command && cf->parent; cf = cf->parent)
+    size += strlen(cf->command)+32;
+  buf = malloc(size);
+  strcpy(buf,str);
   if(i->current) {
-    APPEND(buf,"\n    while executing\n\"");
-    APPEND(buf,i->current); APPEND(buf,"\"");
+    strcat(buf,"\n    while executing\n\"");
+    strcat(buf,i->current); strcat(buf,"\"");
   }
   for(cf = i->callframe; cf->command && cf->parent; cf = cf->parent) {
-    APPEND(buf,"\n    invoked from within\n\"");
-    APPEND(buf,cf->command); APPEND(buf,"\"");
+    strcat(buf,"\n    invoked from within\n\"");
+    strcat(buf,cf->command); strcat(buf,"\"");
   }
   picolSetVar2(i,"::errorInfo",buf,1); /* not exactly the same as in Tcl... */
+  free(buf);
   picolSetResult(i,str);
   return PICOL_ERR;
 }
 int picolErr1(picolInterp *i, char* format, char* arg) {
   /* 'format' should contain exactly one %s specifier */
-  char buf[MAXSTR];
+  char *buf = malloc(strlen(format)+strlen(arg)+1);
+  int   rc;
   sprintf(buf,format,arg);
-  return picolErr(i,buf);
+  rc = picolErr(i,buf);
+  free(buf);
+  return rc;
+}
+/* Names of commands and variables are interned per interpreter: a name
+   entry holds the command and the global variable of that name, and the
+   variables of a proc callframe are a small vector searched by comparing
+   the name pointers. */
+void picolGrowNames(picolInterp *i) {
+  unsigned   size = 2*i->namesize, j;
+  picolName **names = calloc(size,sizeof(picolName*)), *n, *next;
+  for(j = 0; j < i->namesize; j++)
+    for(n = i->names[j]; n; n = next) {
+      next = n->next;
+      n->next = names[n->hash & (size-1)];
+      names[n->hash & (size-1)] = n;
+    }
+  free(i->names);
+  i->names    = names;
+  i->namesize = size;
+}
+unsigned picolHashStr(char *str) {
+  unsigned hash = 0;
+  for( ; *str; str++) hash = hash*31 + (unsigned char)*str;
+  return hash;
+}
+picolName* picolGetName(picolInterp *i, char *name, int create) {
+  unsigned   hash = picolHashStr(name);
+  picolName *n;
+  for(n = i->names[hash & (i->namesize-1)]; n; n = n->next)
+    if(n->hash == hash && EQ(n->name,name)) return n;
+  if(!create) return NULL;
+  if(i->nnames >= i->namesize) picolGrowNames(i);
+  n = calloc(1,sizeof(*n));
+  n->name = strdup(name);
+  n->hash = hash;
+  n->next = i->names[hash & (i->namesize-1)];
+  i->names[hash & (i->namesize-1)] = n;
+  i->nnames++;
+  return n;
+}
+picolVar* picolFrameVar(picolCallFrame *cf, picolName *n) {
+  int j;
+  if(!cf->parent) return n->global; /* global callframe: hashed */
+  for(j = 0; j < cf->nvars; j++) if(cf->vars[j]->name == n->name) return cf->vars[j];
+  return NULL;
+}
+picolVar* picolFrameAdd(picolCallFrame *cf, picolName *n) {
+  picolVar *v = calloc(1,sizeof(*v));
+  v->name = n->name; /* interned, not freed with the variable */
+  if(cf->nvars == cf->size) {
+    cf->size = (cf->size? 2*cf->size : 4);
+    cf->vars = realloc(cf->vars,cf->size*sizeof(picolVar*));
+  }
+  cf->vars[cf->nvars++] = v;
+  if(!cf->parent) n->global = v;
+  return v;
 }
 #define   picolGetVar(_i,_n)       picolGetVar2(_i,_n,0)
 #define   picolGetGlobalVar(_i,_n) picolGetVar2(_i,_n,1)
 picolVar *picolGetVar2(picolInterp *i, char *name, int glob) {
-  picolVar *v = i->callframe->vars;
+  picolCallFrame *c = i->callframe;
+  picolName      *n;
+  picolVar       *v;
   int       global = COLONED(name);
-  char buf[MAXSTR], buf2[MAXSTR], *cp, *cp2;
+  char *buf, *buf2, *cp, *cp2;
   if(global || glob) {
-    picolCallFrame *c = i->callframe;
     while(c->parent) c = c->parent;
-    v = c->vars;
     if(global) name += 2;  /* skip the "::" */
   }
   if((cp = strchr(name,'('))) { /* array element syntax? */
       picolArray* ap;
-      int found = 0;
+      buf  = malloc(strlen(name)+1);
+      buf2 = malloc(strlen(name)+8);
       strncpy(buf,name,cp-name);
       buf[cp-name] = '\0';
-      for( ;v; v = v->next) if (EQ(v->name,buf)) {found = 1; break;}
-      if(!found) return NULL;
-      if(!((ap = picolIsPtr(v->val)))) return NULL;
       strcpy(buf2,cp+1); /* copy the key from after the opening paren*/
-      if(!((cp = strchr(buf2,')')))) return NULL;
-      *cp = '\0';       /* overwrite closing paren */
-      v = picolArrGet1(ap,buf2);
-      if(!v) {
-        if(!((cp2 = getenv(buf2)))) return NULL;
-        strcpy(buf,"::env("); strcat(buf,buf2); strcat(buf,")");
-        return picolArrSet1(i, buf, cp2);
-      }
+      if((n = picolGetName(i,buf,0)) && (v = picolFrameVar(c,n))
+         && (ap = picolIsPtr(v->val)) && (cp = strchr(buf2,')'))) {
+        *cp = '\0';       /* overwrite closing paren */
+        v = picolArrGet1(ap,buf2);
+        if(!v && (cp2 = getenv(buf2))) {
+          strcpy(buf,buf2);
+          sprintf(buf2,"::env(%s)",buf);
+          v = picolArrSet1(i, buf2, cp2);
+        }
+      } else v = NULL;
+      free(buf); free(buf2);
       return v;
   }
-  for( ;v; v = v->next) {if (EQ(v->name,name)) return v;}
-  return NULL;
+  if(!((n = picolGetName(i,name,0)))) return NULL; /* never used */
+  return picolFrameVar(c,n);
 }
 #define picolSetVar(_i,_n,_v)       picolSetVar2(_i,_n,_v,0)
 #define picolSetGlobalVar(_i,_n,_v) picolSetVar2(_i,_n,_v,1)
 int     picolSetVar2(picolInterp *i, char *name, char *val,int glob) {
   picolVar       *v = picolGetVar(i,name);
-  picolCallFrame *c = i->callframe, *localc = c;
+  picolCallFrame *c = i->callframe;
   int             global = COLONED(name);
   if(glob||global) v = picolGetGlobalVar(i,name);
   /*printf("SetVar (%s) (%s) %d @ %p\n", name,val,glob,v);*/
@@ -208,11 +272,7 @@ int     picolSetVar2(picolInterp *i, char *name, char *val,int glob) {
       if(global) name += 2;
       while(c->parent) c = c->parent;
     }
-    v       = malloc(sizeof(*v));
-    v->name = strdup(name);
-    v->next = c->vars;
-    c->vars = v;
-    i->callframe = localc;
+    v = picolFrameAdd(c,picolGetName(i,name,1));
   }
   v->val = (val? strdup(val) : NULL);
   return PICOL_OK;
@@ -251,28 +311,55 @@ void picolInitInterp(picolInterp *i) {
   i->level     = 0;
   i->callframe = calloc(1,sizeof(picolCallFrame));
   i->result    = strdup("");
+  i->names     = calloc(DEFAULT_NAMESIZE,sizeof(picolName*));
+  i->namesize  = DEFAULT_NAMESIZE;
 }
 picolCmd *picolGetCmd(picolInterp *i, char *name) {
-  picolCmd *c;
-  for(c = i->commands; c; c = c->next) if (EQ(c->name,name)) return c;
-  return NULL;
+  picolName *n = picolGetName(i,name,0);
+  return (n? n->cmd : NULL);
 }
 int picolRegisterCmd(picolInterp *i, char *name, picol_Func f, void *pd) {
-  picolCmd *c = picolGetCmd(i,name);
-  if (c) return picolErr1(i,"command '%s' already defined", name);
+  picolName *n = picolGetName(i,name,1);
+  picolCmd  *c;
+  if (n->cmd) return picolErr1(i,"command '%s' already defined", name);
   c = malloc(sizeof(picolCmd));
-  c->name     = strdup(name);
+  c->name     = n->name;
   c->func     = f;
   c->privdata = pd;
   c->next     = i->commands;
   i->commands = c;
+  n->cmd      = c;
   return PICOL_OK;
 }
-char* picolList(char* buf, int argc, char** argv) {
-  int a;
-  buf[0] = '\0'; /* caller responsible for supplying large enough buffer */
-  for(a=0; a<argc; a++) LAPPEND_X(buf,argv[a]);
-  return buf;
+void picolStrAppend(picolStr *d, char *src) {
+  size_t n = strlen(src);
+  if(d->len+n+1 > d->size) {
+    d->size = 2*(d->len+n+1);
+    d->s    = realloc(d->s,d->size);
+  }
+  memcpy(d->s+d->len,src,n+1);
+  d->len += n;
+}
+void picolStrLappend(picolStr *d, char *src) { /* as LAPPEND_X */
+  int needbraces = (strchr(src,' ')!=NULL) || *src=='\0';
+  if(d->len)     picolStrAppend(d," ");
+  if(needbraces) picolStrAppend(d,"{");
+  picolStrAppend(d,src);
+  if(needbraces) picolStrAppend(d,"}");
+}
+char* picolStrDone(picolStr *d) { /* the string, for the caller to free */
+  return (d->s? d->s : strdup(""));
+}
+int picolSetStrResult(picolInterp *i, picolStr *d) { /* takes the string */
+  free(i->result);
+  i->result = picolStrDone(d);
+  return PICOL_OK;
+}
+char* picolListAlloc(int argc, char** argv) { /* caller frees the result */
+  picolStr d = {NULL,0,0};
+  int      a;
+  for(a = 0; a < argc; a++) picolStrLappend(&d,argv[a]);
+  return picolStrDone(&d);
 }
 char* picolParseList(char* start,char* trg) {
   char *cp = start;
@@ -297,10 +384,10 @@ char* picolParseList(char* start,char* trg) {
   }
   return cp;
 }
-void picolEscape(char *str) {
-  char buf[MAXSTR], *cp, *cp2;
+void picolEscape(char *str) { /* in place, the result is never longer */
+  char *cp, *cp2;
   int ichar;
-  for(cp = str, cp2 = buf; *cp; cp++) {
+  for(cp = str, cp2 = str; *cp; cp++) {
     if(*cp == '\\') {
       switch(*(cp+1)) {
       case 'n':  *cp2++ = '\n'; cp++; break;
@@ -315,56 +402,86 @@ void picolEscape(char *str) {
     } else *cp2++ = *cp;
   }
   *cp2 = '\0';
-  strcpy(str, buf);
 }
-#define picolEval(_i,_t)  picolEval2(_i,_t,1)
-#define picolSubst(_i,_t) picolEval2(_i,_t,0)
-int     picolEval2(picolInterp *i, char *t, int mode) { /*----------- EVAL! */
-  /* mode==0: subst only, mode==1: full eval */
-  picolParser p;
-  int         argc = 0, j;
-  char      **argv = NULL, buf[MAXSTR];
-  int         tlen, rc = PICOL_OK;
-  picolSetResult(i,"");
-  picolInitParser(&p,t);
+/* A script is parsed once into a list of tokens (separators dropped,
+   escapes resolved, command substitutions compiled too).  A proc keeps
+   its compiled body; other scripts (loop bodies, eval) are kept in a
+   cache slot by the hash of their text, so that they are not parsed
+   again on each evaluation.  A running script holds a reference, so
+   that it survives being evicted or its proc being redefined. */
+picolScript* picolCompile(picolInterp *i, char *text) {
+  picolParser  p;
+  picolScript *s = calloc(1,sizeof(*s));
+  picolToken  *tok;
+  int          prevtype, tlen, size = 0;
+  s->text     = strdup(text);
+  s->refcount = 1;
+  picolInitParser(&p,s->text);
   while(1) {
-    int prevtype = p.type;
+    prevtype = p.type;
+    p.expand = 0;
     picolGetToken(i, &p);
     if (p.type == PT_EOF) break;
+    if (p.type == PT_SEP) continue;
+    if (s->ntokens == size) {
+      size      = (size? 2*size : 8);
+      s->tokens = realloc(s->tokens, sizeof(picolToken)*size);
+    }
+    tok = &s->tokens[s->ntokens++];
     tlen = p.end - p.start + 1;
     if (tlen < 0) tlen = 0;
-    t = malloc(tlen+1);
-    memcpy(t, p.start, tlen);
-    t[tlen] = '\0';
-    /*printf("token (%s)\n", t);*/
-    if (p.type == PT_VAR) {
-      picolVar *v = picolGetVar(i,t);
-      if (v && !v->val) v = picolGetGlobalVar(i,t);
-      if(!v) rc = picolErr1(i,"can't read \"%s\": no such variable", t);
-      free(t);
-      if(!v) goto err;
+    tok->type    = p.type;
+    tok->newword = (prevtype == PT_SEP || prevtype == PT_EOL);
+    tok->expand  = p.expand;
+    tok->text    = malloc(tlen+1);
+    memcpy(tok->text, p.start, tlen);
+    tok->text[tlen] = '\0';
+    tok->cmd     = NULL;
+    if (p.type == PT_ESC && strchr(tok->text,'\\')) picolEscape(tok->text);
+    else if (p.type == PT_CMD) tok->cmd = picolCompile(i,tok->text);
+  }
+  return s;
+}
+void picolReleaseScript(picolScript *s) {
+  int k;
+  if(--s->refcount > 0) return;
+  for(k = 0; k < s->ntokens; k++) {
+    free(s->tokens[k].text);
+    if(s->tokens[k].cmd) picolReleaseScript(s->tokens[k].cmd);
+  }
+  free(s->tokens); free(s->text); free(s);
+}
+int picolEvalScript(picolInterp *i, picolScript *s, int mode) {
+  /* mode==0: subst only, mode==1: full eval */
+  picolToken *tok, *last = s->tokens + s->ntokens;
+  int         argc = 0, j, expand = 0, rc = PICOL_OK;
+  char      **argv = NULL, *t;
+  picolSetResult(i,"");
+  s->refcount++;
+  for(tok = s->tokens; tok < last; tok++) {
+    expand |= tok->expand;
+    if (tok->type == PT_VAR) {
+      picolVar *v = picolGetVar(i,tok->text);
+      if (v && !v->val) v = picolGetGlobalVar(i,tok->text);
+      if(!v) {
+        rc = picolErr1(i,"can't read \"%s\": no such variable", tok->text);
+        goto err;
+      }
       t = strdup(v->val);
-    } else if (p.type == PT_CMD) {
-      rc = picolEval(i,t);
-      free(t);
+    } else if (tok->type == PT_CMD) {
+      rc = picolEvalScript(i,tok->cmd,1);
       if (rc != PICOL_OK) goto err;
       t = strdup(i->result);
-    } else if (p.type == PT_ESC) {
-      if(strchr(t,'\\')) picolEscape(t);
-    } else if (p.type == PT_SEP) {
-      prevtype = p.type;
-      free(t);
-      continue;
-    }
+    } else if (tok->type != PT_EOL) t = strdup(tok->text);
     /* We have a complete command + args. Call it! */
-    if (p.type == PT_EOL) {
+    if (tok->type == PT_EOL) {
       picolCmd *c;
-      free(t);
       if(mode==0) { /* do a quasi-subst only */
-        rc = picolSetResult(i,strdup(picolList(buf,argc,argv)));
+        t  = picolListAlloc(argc,argv);
+        rc = picolSetResult(i,t);
+        free(t);
         goto err; /* not an error, if rc == PICOL_OK */
       }
-      prevtype = p.type;
       if (argc) {
         if ((c = picolGetCmd(i,argv[0])) == NULL) {
           if(EQ(argv[0],"")||*argv[0]=='#') goto err;
@@ -379,11 +496,14 @@ int     picolEval2(picolInterp *i, char *t, int mode) { /*----------- EVAL! */
           }
         }
         if(i->current) free(i->current);
-        i->current = strdup(picolList(buf,argc,argv));
+        i->current = picolListAlloc(argc,argv);
         if(i->trace) {printf("< %d: %s\n",i->level,i->current); fflush(stdout);}
         rc = c->func(i,argc,argv,c->privdata);
-        if(i->trace) {printf("> %d: {%s} -> {%s}\n",
-                             i->level,picolList(buf,argc,argv),i->result);}
+        if(i->trace) {
+          t = picolListAlloc(argc,argv);
+          printf("> %d: {%s} -> {%s}\n",i->level,t,i->result);
+          free(t);
+        }
         if (rc != PICOL_OK) goto err;
       }
       /* Prepare for the next command */
@@ -393,23 +513,23 @@ int     picolEval2(picolInterp *i, char *t, int mode) { /*----------- EVAL! */
       continue;
     }
     /* We have a new token, append to the previous or as new arg? */
-/*    printf("new token (%s), prevtype %d, expand %d\n",t,prevtype,p.expand);*/
-    if (prevtype == PT_SEP || prevtype == PT_EOL) {
-      if(!p.expand || strlen(t)) {
+    if (tok->newword) {
+      if(!expand || strlen(t)) {
         argv       = realloc(argv, sizeof(char*)*(argc+1));
         argv[argc] = t;
         argc++;
-        p.expand = 0;
-      }
-    } else if(p.expand) { /* slice in the words separately */
-      char buf[MAXSTR], *cp;
+        expand = 0;
+      } else free(t);
+    } else if(expand) { /* slice in the words separately */
+      char *buf = malloc(strlen(t)+1), *cp;
       FOREACH(buf,cp,t) {
         argv       = realloc(argv, sizeof(char*)*(argc+1));
         argv[argc] = strdup(buf);
         argc++;
       }
+      free(buf);
       free(t);
-      p.expand = 0;
+      expand = 0;
     } else { /* Interpolation */
       size_t oldlen = strlen(argv[argc-1]), tlen = strlen(t);
       argv[argc-1]  = realloc(argv[argc-1], oldlen+tlen+1);
@@ -417,40 +537,55 @@ int     picolEval2(picolInterp *i, char *t, int mode) { /*----------- EVAL! */
       argv[argc-1][oldlen+tlen] = '\0';
       free(t);
     }
-    prevtype = p.type;
   }
 err:
   for (j = 0; j < argc; j++) free(argv[j]);
   free(argv);
+  picolReleaseScript(s);
   return rc;
 }
+#define picolEval(_i,_t)  picolEval2(_i,_t,1)
+#define picolSubst(_i,_t) picolEval2(_i,_t,0)
+int     picolEval2(picolInterp *i, char *t, int mode) { /*----------- EVAL! */
+  unsigned      hash = picolHashStr(t);
+  picolScript **slot = &i->scripts[hash & (DEFAULT_CACHESIZE-1)];
+  if(!*slot || (*slot)->hash != hash || !EQ((*slot)->text,t)) {
+    if(*slot) picolReleaseScript(*slot);
+    *slot = picolCompile(i,t);
+    (*slot)->hash = hash;
+  }
+  return picolEvalScript(i,*slot,mode);
+}
 int picolCondition(picolInterp *i, char* str) {
   if(str) {
-    char buf[MAXSTR], buf2[MAXSTR], *argv[3], *cp;
+    char *buf, *buf2, *elem[3], *argv[3], *cp;
     int a = 0, rc;
+    picolCmd *c = NULL;
     rc = picolSubst(i,str);
     if(rc != PICOL_OK) return rc;
     /*printf("Condi: (%s) ->(%s)\n",str,i->result);*/
-    strcpy(buf2,i->result);
+    buf2 = strdup(i->result);
+    buf  = malloc(strlen(buf2)+1);
     /* ------- try whether the format suits [expr]... */
-    strcpy(buf,"llength "); LAPPEND(buf,i->result);
-    rc = picolEval(i,buf);
-    if(rc != PICOL_OK) return rc;
-    if(EQ(i->result,"3")) {
-      FOREACH(buf,cp,buf2) argv[a++] = strdup(buf);
-      if(picolGetCmd(i,argv[1])) { /* defined operator in center */
-        strcpy(buf,argv[1]);       /* translate to Polish :) */
-        LAPPEND(buf,argv[0]);      /* e.g. {1 > 2} -> {> 1 2} */
-        LAPPEND(buf,argv[2]);
-        for(a = 0; a < 3; a++) free(argv[a]);
-        rc = picolEval(i, buf);
-        return rc;
-      }
-    } /* .. otherwise, check for inequality to zero */
-    if(*str == '!') {strcpy(buf,"== 0 "); str++;} /* allow !$x */
-    else             strcpy(buf,"!= 0 ");
-    strcat(buf, str);
-    return picolEval(i, buf);
+    for(cp = buf2; a < 4 && (cp = picolParseList(cp,buf)); a++)
+      if(a < 3) elem[a] = strdup(buf);
+    free(buf); free(buf2);
+    if(a == 3 && (c = picolGetCmd(i,elem[1]))) { /* defined operator in center */
+      argv[0] = elem[1];                         /* translate to Polish :) */
+      argv[1] = elem[0];                         /* e.g. {1 > 2} -> {> 1 2} */
+      argv[2] = elem[2];
+      rc = c->func(i,3,argv,c->privdata);
+    }
+    for(a--; a >= 0; a--) if(a < 3) free(elem[a]);
+    if(c) return rc;
+    /* .. otherwise, check for inequality to zero */
+    buf2 = malloc(strlen(str)+6);
+    if(*str == '!') {strcpy(buf2,"== 0 "); str++;} /* allow !$x */
+    else             strcpy(buf2,"!= 0 ");
+    strcat(buf2, str);
+    rc = picolEval(i, buf2);
+    free(buf2);
+    return rc;
   } else return picolErr(i, "NULL condition");
 }
 int picolIsInt(char* str) {
@@ -466,18 +601,16 @@ void* picolIsPtr(char* str) {
 }
 void picolDropCallFrame(picolInterp *i) {
   picolCallFrame *cf = i->callframe;
-  picolVar *v, *next;
-  for(v = cf->vars; v; v = next) {
-    next = v->next;
-    free(v->name); free(v->val); free(v);
-  }
+  int j;
+  for(j = 0; j < cf->nvars; j++) {free(cf->vars[j]->val); free(cf->vars[j]);}
+  free(cf->vars);
   if(cf->command) free(cf->command);
   i->callframe = cf->parent;
   free(cf);
 }
 int picolCallProc(picolInterp *i, int argc, char **argv, void *pd) {
-  char **x=pd, *alist=x[0], *body=x[1], *p=strdup(alist), *tofree;
-  char buf[MAXSTR];
+  picolProc *x = pd;
+  char *p = strdup(x->args), *tofree, *buf;
   picolCallFrame *cf = calloc(1,sizeof(*cf));
   int a = 0, done = 0, errcode = PICOL_OK;
   if(!cf) {printf("could not allocate callframe\n"); exit(1);}
@@ -493,7 +626,9 @@ int picolCallProc(picolInterp *i, int argc, char **argv, void *pd) {
     if (p == start) break;
     if (*p == '\0') done=1; else *p = '\0';
     if(EQ(start,"args") && done) {
-      picolSetVar(i,start,picolList(buf,argc-a-1,argv+a+1));
+      buf = picolListAlloc(argc-a-1,argv+a+1);
+      picolSetVar(i,start,buf);
+      free(buf);
       a = argc-1;
       break;
     }
@@ -504,8 +639,9 @@ int picolCallProc(picolInterp *i, int argc, char **argv, void *pd) {
   }
   free(tofree);
   if (a != argc-1) goto arityerr;
-  cf->command = strdup(picolList(buf,argc,argv));
-  errcode     = picolEval(i,body);
+  cf->command = picolListAlloc(argc,argv);
+  errcode     = (x->script? picolEvalScript(i,x->script,1)
+                             : picolEval(i,x->body));
   if (errcode == PICOL_RETURN) errcode = PICOL_OK;
   picolDropCallFrame(i); /* remove the called proc callframe */
   i->level--;
@@ -545,24 +681,42 @@ COMMAND(abs) {
 }
 COMMAND(append) {
   picolVar* v;
-  char buf[MAXSTR] = "";
+  size_t size = 1;
+  char *buf, *cp;
   int a;
   ARITY2(argc > 1, "append varName ?value value ...?");
   v = picolGetVar(i,argv[1]);
-  if(v) strcpy(buf,v->val);
-  for(a = 2; a < argc; a++) APPEND(buf,argv[a]);
+  if(v && !v->val) v = picolGetGlobalVar(i,argv[1]);
+  if(v) size += strlen(v->val);
+  for(a = 2; a < argc; a++) size += strlen(argv[a]);
+  if(v) { /* grow the value in place instead of copying it to a new var */
+    cp = v->val = realloc(v->val, size);
+    for(a = 2; a < argc; a++) {cp += strlen(cp); strcpy(cp,argv[a]);}
+    return picolSetResult(i,v->val);
+  }
+  cp = buf = malloc(size);
+  *buf = '\0';
+  for(a = 2; a < argc; a++) {cp += strlen(cp); strcpy(cp,argv[a]);}
   picolSetVar(i,argv[1],buf);
-  return picolSetResult(i,buf);
+  picolSetResult(i,buf);
+  free(buf);
+  return PICOL_OK;
 }
 COMMAND(apply) {
-  char* procdata[2], *cp;
-  char buf[MAXSTR], buf2[MAXSTR];
+  picolProc procdata;
+  char *cp, *buf, *buf2;
+  int rc;
   ARITY2(argc >= 2, "apply {argl body} ?arg ...?");
+  buf  = malloc(strlen(argv[1])+1);
+  buf2 = calloc(1,strlen(argv[1])+1);
   cp = picolParseList(argv[1],buf);
   picolParseList(cp,buf2);
-  procdata[0] = buf;
-  procdata[1] = buf2;
-  return picolCallProc(i, argc-1, argv+1, (void*)procdata);
+  procdata.args   = buf;
+  procdata.body   = buf2;
+  procdata.script = NULL; /* the body is cached by its text */
+  rc = picolCallProc(i, argc-1, argv+1, (void*)&procdata);
+  free(buf); free(buf2);
+  return rc;
 }
 /*---------------------------------------------------- Array stuff */
 int picolHash(char* key, int modul) {
@@ -577,14 +731,14 @@ picolArray* picolArrCreate(picolInterp *i, char *name) {
     picolSetVar(i,name,buf);
     return ap;
 }
-char* picolArrGet(picolArray *ap, char* pat, char* buf, int mode) {
+picolStr* picolArrGet(picolArray *ap, char* pat, picolStr* buf, int mode) {
   int j;
   picolVar *v;
   for(j = 0; j < DEFAULT_ARRSIZE; j++) {
     for(v = ap->table[j]; v; v = v->next) {
       if (picolMatch(pat, v->name)) { /* mode==1: array names */
-        LAPPEND_X(buf,v->name);
-        if(mode==2) LAPPEND_X(buf,v->val); /* array get */
+        picolStrLappend(buf,v->name);
+        if(mode==2) picolStrLappend(buf,v->val); /* array get */
       }
     }
   }
@@ -617,7 +771,7 @@ picolVar* picolArrSet(picolArray* ap, char* key, char* value) {
   return v;
 }
 picolVar* picolArrSet1(picolInterp *i, char *name, char *value) {
-    char buf[MAXSTR], *cp;
+    char *buf = malloc(strlen(name)+1), *cp;
     picolArray *ap;
     picolVar   *v;
     cp = strchr(name,'(');
@@ -626,12 +780,15 @@ picolVar* picolArrSet1(picolInterp *i, char *name, char *value) {
     v = picolGetVar(i,buf);
     if(!v) ap = picolArrCreate(i,buf);
     else   ap = picolIsPtr(v->val);
-    if(!ap) return NULL;
+    v = NULL;
     strcpy(buf,cp+1);
     cp = strchr(buf,')');
-    if(!cp) return NULL; /*picolErr1(i, "bad array syntax %x", name);*/
-    *cp = '\0'; /* overwrite closing paren */
-    return picolArrSet(ap, buf, value);
+    if(ap && cp) { /* else picolErr1(i, "bad array syntax %x", name); */
+      *cp = '\0'; /* overwrite closing paren */
+      v = picolArrSet(ap, buf, value);
+    }
+    free(buf);
+    return v;
 }
 char* picolArrStat(picolArray *ap,char* buf) {
   int a, buckets=0, j, count[11], depth;
@@ -658,7 +815,8 @@ char* picolArrStat(picolArray *ap,char* buf) {
 COMMAND(array) {
   picolVar   *v;
   picolArray *ap = NULL;
-  char buf[MAXSTR] = "", buf2[MAXSTR], *cp;
+  char buf[MAXSTR] = "", *buf2, *cp;
+  picolStr list = {NULL,0,0};
   int mode = 0; /*default: array size */
   ARITY2(argc > 2, "array exists|get|names|set|size|statistics arrayName ?arg ...?");
   v = picolGetVar(i,argv[2]);
@@ -672,15 +830,21 @@ COMMAND(array) {
     if(     SUBCMD("names")) mode = 1;
     else if(SUBCMD("get"))   mode = 2;
     else if(argc != 3) return picolErr(i,"usage: array get|names|size a");
-    picolSetResult(i,picolArrGet(ap,pat,buf,mode));
+    picolSetStrResult(i,picolArrGet(ap,pat,&list,mode));
   } else if(SUBCMD("set")) {
+    char *key;
+    int   rc = PICOL_OK;
     ARITY2(argc == 4, "array set arrayName list")
     if(!v) ap = picolArrCreate(i,argv[2]);
-    FOREACH(buf,cp,argv[3]) {
+    key  = malloc(strlen(argv[3])+1); /* elements are never longer */
+    buf2 = malloc(strlen(argv[3])+1);
+    FOREACH(key,cp,argv[3]) {
       cp = picolParseList(cp, buf2);
-      if(!cp) return picolErr(i,"list must have even number of elements");
-      picolArrSet(ap,buf,buf2);
+      if(!cp) {rc = picolErr(i,"list must have even number of elements"); break;}
+      picolArrSet(ap,key,buf2);
     }
+    free(key); free(buf2);
+    if(rc != PICOL_OK) return rc;
   } else if(SUBCMD("statistics")) {
     ARITY2(argc == 3, "array statistics arrname");
     if(!v) return picolErr1(i,"no such array %s", argv[2]);
@@ -699,10 +863,19 @@ char* picolConcat(char* buf, int argc, char** argv) {
   }
   return buf;
 }
+char* picolConcatAlloc(int argc, char** argv) { /* caller frees the result */
+  size_t size = 1;
+  int    a;
+  for(a = 1; a < argc; a++) size += strlen(argv[a])+1;
+  return picolConcat(malloc(size),argc,argv);
+}
 COMMAND(concat) {
-  char buf[MAXSTR];
+  char *buf;
   ARITY2(argc > 0, "concat ?arg...?")
-  return picolSetResult(i,picolConcat(buf,argc,argv));
+  buf = picolConcatAlloc(argc,argv);
+  picolSetResult(i,buf);
+  free(buf);
+  return PICOL_OK;
 }
 COMMAND(continue) {ARITY(argc == 1); return PICOL_CONTINUE;}
 COMMAND(catch) {
@@ -732,9 +905,14 @@ COMMAND(clock) {
   return PICOL_OK;
 }
 COMMAND(eval) {
-  char buf[MAXSTR];
+  char *buf;
+  int   rc;
   ARITY2(argc >= 2, "eval arg ?arg ...?");
-  return picolEval(i, picolConcat(buf,argc,argv));
+  if(argc == 2) return picolEval(i, argv[1]);
+  buf = picolConcatAlloc(argc,argv);
+  rc  = picolEval(i, buf);
+  free(buf);
+  return rc;
 }
 int picol_EqNe(picolInterp *i, int argc, char **argv, void *pd) {
   int res;
@@ -747,11 +925,140 @@ COMMAND(error) {
   ARITY2(argc == 2, "error message")
   return picolErr(i,argv[1]);
 }
+#ifdef PICOL_ESIS /* ----------------- ESIS events handled by picol scripts */
+void picolEsisCopy(picolEsis *e, char *gi, int argc, char **argv) {
+  const ESIS_Char **atts;   /* write the current event, maybe as another GI */
+  int n = 0, a, k;
+  if(!gi) gi = (char*)e->elem->elemGI;
+  if(e->event == ESIS_CDATA)    ESIS_Cdata(e->writer,e->data,e->len);
+  else if(e->event == ESIS_END) ESIS_End(e->writer,gi);
+  else if(argc == 0)            ESIS_Start(e->writer,gi,e->elem->atts);
+  else {  /* pointers to the parser's attributes, with argv pairs replaced */
+    while(e->elem->atts && e->elem->atts[n]) n += 2;
+    atts = malloc((n+argc+1)*sizeof(*atts));
+    if(n) memcpy(atts,e->elem->atts,n*sizeof(*atts));
+    for(a = 0; a+1 < argc; a += 2) {
+      for(k = 0; k < n && strcmp(atts[k],argv[a]); k += 2);
+      if(k == n) {atts[k] = argv[a]; n += 2;}
+      atts[k+1] = argv[a+1];
+    }
+    atts[n] = NULL;
+    ESIS_Start(e->writer,gi,atts);
+    free(atts);
+  }
+}
+ESIS_Bool picolEsisEvent(void *userData, ESIS_ElemEvent ev, long elemID,
+                         ESIS_Elem *elem, const ESIS_Char *data, size_t len) {
+  picolEsisHandler *h = userData;
+  picolEsis        *e = h->esis;
+  if(e->rc != PICOL_OK) return ESIS_TRUE; /* skip the rest after an error */
+  e->event = ev; e->elem = elem; e->data = data; e->len = len;
+  if(*h->script[ev]) {
+    if(picolEval(e->interp,h->script[ev]) == PICOL_ERR) e->rc = PICOL_ERR;
+  } else picolEsisCopy(e,NULL,0,NULL); /* no script: pass the event on */
+  e->elem = NULL;
+  return ESIS_TRUE;
+}
+int picolEsisParse(picolInterp *i, picolEsis *e, char *fileName, int filter) {
+  picolEsisHandler *h;
+  FILE *fp = stdin;
+  int   ok;
+  if(e->parser) return picolErr(i,"esis: already parsing");
+  if(fileName && !(fp = fopen(fileName,"r")))
+    return picolErr1(i,"no file '%s'",fileName);
+  e->parser = ESIS_ParserCreate(NULL);
+  for(h = e->handlers; h; h = h->next)
+    ESIS_SetElementHandler(e->parser,picolEsisEvent,(*h->gi? h->gi : NULL),0L,h);
+  e->rc = PICOL_OK;
+  ok = filter? ESIS_FilterFile(e->parser,fp,stdout) : ESIS_ParseFile(e->parser,fp);
+  ESIS_ParserFree(e->parser);
+  e->parser = NULL;
+  if(fp != stdin) fclose(fp);
+  if(e->rc != PICOL_OK) return e->rc; /* the result is the script's error */
+  if(!ok) return picolErr(i,"esis: error in ESIS input");
+  return picolSetResult(i,"");
+}
+COMMAND(esis) {
+  picolEsis        *e = i->esis;
+  picolEsisHandler *h;
+  const ESIS_Char **atts;
+  picolStr          buf = {NULL,0,0};
+  int               a, k;
+  ARITY2(argc >= 2, "esis option ?arg ...?");
+  if(!e) {
+    e = i->esis = calloc(1,sizeof(*e));
+    e->interp = i;
+    e->writer = ESIS_WriterCreate(stdout,0U);
+  }
+  if(SUBCMD("handler")) {
+    ARITY2(argc == 3 || argc == 6, "esis handler elemGI ?startScript cdataScript endScript?");
+    for(h = e->handlers; h && !EQ(h->gi,argv[2]); h = h->next);
+    if(argc == 3) {
+      if(h) for(a = 0; a < 3; a++) picolStrLappend(&buf,h->script[a]);
+      return picolSetStrResult(i,&buf);
+    }
+    if(!h) {
+      h = calloc(1,sizeof(*h));
+      h->gi   = strdup(argv[2]);
+      h->esis = e;
+      h->next = e->handlers;
+      e->handlers = h;
+    } else for(a = 0; a < 3; a++) free(h->script[a]);
+    for(a = 0; a < 3; a++) h->script[a] = strdup(argv[a+3]);
+  } else if(SUBCMD("parse") || SUBCMD("filter")) {
+    ARITY2(argc <= 3, "esis parse|filter ?fileName?");
+    return picolEsisParse(i,e,(argc == 3? argv[2] : NULL),SUBCMD("filter"));
+  } else if(SUBCMD("start")) {
+    ARITY2(argc >= 3 && argc%2 == 1, "esis start elemGI ?name value ...?");
+    atts = malloc((argc-2)*sizeof(*atts));
+    for(a = 3; a < argc; a++) atts[a-3] = argv[a];
+    atts[argc-3] = NULL;
+    ESIS_Start(e->writer,argv[2],atts);
+    free(atts);
+  } else if(SUBCMD("cdata")) {
+    ARITY2(argc == 3, "esis cdata text");
+    ESIS_Cdata(e->writer,argv[2],strlen(argv[2]));
+  } else if(SUBCMD("end")) {
+    ARITY2(argc == 3, "esis end elemGI");
+    ESIS_End(e->writer,argv[2]);
+  } else {      /* the others need the event being handled */
+    if(!e->elem) return picolErr1(i,"esis %s: no current event",argv[1]);
+    if(SUBCMD("gi")) {
+      ARITY2(argc == 2, "esis gi");
+      return picolSetResult(i,(char*)e->elem->elemGI);
+    } else if(SUBCMD("attr")) { /* attributes are only passed on start */
+      ARITY2(argc <= 4, "esis attr ?name? ?default?");
+      atts = (e->event == ESIS_START)? e->elem->atts : NULL;
+      if(argc == 2) {
+        for(k = 0; atts && atts[k]; k++) picolStrLappend(&buf,(char*)atts[k]);
+        return picolSetStrResult(i,&buf);
+      }
+      for(k = 0; atts && atts[k] && strcmp(atts[k],argv[2]); k += 2);
+      if(atts && atts[k]) return picolSetResult(i,(char*)atts[k+1]);
+      return picolSetResult(i,(argc == 4? argv[3] : ""));
+    } else if(SUBCMD("data")) {
+      ARITY2(argc == 2, "esis data");
+      free(i->result);
+      i->result = malloc(e->len+1);
+      if(e->len) memcpy(i->result,e->data,e->len);
+      i->result[e->len] = '\0';
+      return PICOL_OK;
+    } else if(SUBCMD("copy")) {
+      ARITY2(argc == 2 || argc%2 == 1, "esis copy ?elemGI? ?name value ...?");
+      picolEsisCopy(e,(argc > 2? argv[2] : NULL),(argc > 3? argc-3 : 0),argv+3);
+    } else return picolErr(i,
+      "usage: esis attr|cdata|copy|data|end|filter|gi|handler|parse|start ...");
+  }
+  return picolSetResult(i,"");
+}
+#endif
 COMMAND(exec) {
-  char buf[MAXSTR]; /* This is far from the real thing, but may be useful */
+  char *buf; /* This is far from the real thing, but may be useful */
   ARITY2(argc > 1, "exec command ?arg...?")
   fflush(stdout);
-  system(picolConcat(buf,argc,argv));
+  buf = picolConcatAlloc(argc,argv);
+  system(buf);
+  free(buf);
   return picolSetResult(i,"");
 }
 COMMAND(exit) {
@@ -761,27 +1068,35 @@ COMMAND(exit) {
   exit(rc);
 }
 COMMAND(expr) {
-  char buf[MAXSTR] = "";        /* only simple cases supported */
-  int a;
+  char *buf, **av;        /* only simple cases supported */
+  int a, n = 0, rc;
+  picolCmd *c;
   ARITY2((argc%2)==0, "expr int1 op int2 ...");
   if(argc==2) {
     if(strchr(argv[1],' ')) { /* braced expression - roll it out */
-        strcpy(buf,"expr ");
-        APPEND(buf,argv[1]);
-        return picolEval(i,buf);
+        buf = malloc(strlen(argv[1])+6);
+        strcpy(buf,"expr "); strcat(buf,argv[1]);
+        rc = picolEval(i,buf);
+        free(buf);
+        return rc;
     } else return picolSetResult(i,argv[1]); /* single scalar */
   }
-  APPEND(buf,argv[2]);   /* operator first - Polish notation */
-  LAPPEND(buf,argv[1]);  /* {a + b + c} -> {+ a b c} */
-  for(a = 3; a < argc; a += 2) {
-    if(a < argc-1 && !EQ(argv[a+1],argv[2]))
-      return picolErr(i,"need equal operators");
-    LAPPEND(buf,argv[a]);
+  for(a = 3; a < argc-1; a += 2)
+    if(!EQ(argv[a+1],argv[2])) return picolErr(i,"need equal operators");
+  av = malloc(sizeof(char*)*argc);
+  av[n++] = argv[2];   /* operator first - Polish notation */
+  for(a = 1; a < argc; a += 2) av[n++] = argv[a]; /* {a + b + c} -> {+ a b c} */
+  if((c = picolGetCmd(i,av[0]))) rc = c->func(i,n,av,c->privdata);
+  else {               /* let [unknown] have a go */
+    buf = picolListAlloc(n,av);
+    rc  = picolEval(i, buf);
+    free(buf);
   }
-  return picolEval(i, buf);
+  free(av);
+  return rc;
 }
 COMMAND(file) {
-  char buf[MAXSTR], *cp;
+  char *cp;
   FILE* fp = NULL;
   int a;
   ARITY2(argc >= 3, "file option ?arg ...?");
@@ -799,13 +1114,15 @@ COMMAND(file) {
     } else picolSetBoolResult(i,(int)fp);
     if(fp) fclose(fp);
   } else if(SUBCMD("join")) {
-    strcpy(buf,argv[2]);
+    picolStr path = {NULL,0,0};
+    picolStrAppend(&path,argv[2]);
     for(a=3; a<argc; a++) {
         if(picolMatch("/*",argv[a]) || picolMatch("?:/*",argv[a]))
-            strcpy(buf,argv[a]);
-        else {APPEND(buf,"/"); APPEND(buf,argv[a]);}
+            path.len = 0;
+        else picolStrAppend(&path,"/");
+        picolStrAppend(&path,argv[a]);
     }
-    picolSetResult(i,buf);
+    picolSetStrResult(i,&path);
   } else if(SUBCMD("tail")) {
     cp = strrchr(argv[2],'/');
     if(!cp) cp = argv[2]-1;
@@ -848,11 +1165,13 @@ COMMAND(for) {
   }
 }
 COMMAND(foreach) {
-  char buf[MAXSTR] = "", buf2[MAXSTR]; /* only single list supported */
+  char *buf, *buf2; /* only single list supported */
   char *cp, *varp;
-  int rc, done=0;
+  int rc = PICOL_OK, done=0;
   ARITY2((argc%2)==0, "foreach varList list ?varList list ...? command");
   if(*argv[2] == '\0') return PICOL_OK;            /* empty data list */
+  buf  = malloc(strlen(argv[2])+1);
+  buf2 = malloc(strlen(argv[1])+1);
   varp = picolParseList(argv[1],buf2);
   cp   = picolParseList(argv[2],buf);
   while(cp || varp) {
@@ -860,7 +1179,7 @@ COMMAND(foreach) {
     varp = picolParseList(varp,buf2);
     if(!varp) {                            /* end of var list reached */
       rc = picolEval(i,argv[argc-1]);
-      if(rc == PICOL_ERR || rc == PICOL_BREAK) return rc;
+      if(rc == PICOL_ERR || rc == PICOL_BREAK) break;
       else varp = picolParseList(argv[1],buf2); /* cycle back to start */
       done = 1;
     } else done=0;
@@ -868,34 +1187,47 @@ COMMAND(foreach) {
     if(!cp && done) break;
     if(!cp) strcpy(buf,"");   /* empty string when data list exhausted */
   }
+  free(buf); free(buf2);
+  if(rc == PICOL_ERR || rc == PICOL_BREAK) return rc;
   return picolSetResult(i,"");
 }
 COMMAND(format) {
   int value;     /* limited to single integer or string argument so far */
   ARITY2(argc == 2 || argc == 3, "format formatString ?arg?")
   if(argc==2) return picolSetResult(i, argv[1]); /* identity */
-  if(strchr(argv[1],'s')) {
-    char buf[MAXSTR];
+  if(strchr(argv[1],'s')) { /* room for the string, and padding */
+    char *buf = malloc(strlen(argv[1])+strlen(argv[2])+MAXSTR);
     sprintf(buf,argv[1],argv[2]);
-    return picolSetResult(i, buf);
+    picolSetResult(i, buf);
+    free(buf);
+    return PICOL_OK;
   }
   SCAN_INT(value, argv[2]);
   return picolSetFmtResult(i, argv[1], value);
 }
 COMMAND(gets) {
-  char buf[MAXSTR], *getsrc;
+  char buf[MAXSTR], *getsrc = NULL;
+  picolStr line = {NULL,0,0};
   FILE* fp = stdin;
   ARITY2(argc == 2 || argc == 3, "gets channelId ?varName?")
   picolSetResult(i,"-1");
   if(!EQ(argv[1],"stdin")) SCAN_PTR(fp,argv[1]); /* caveat usor */
   if(!feof(fp)) {
-    getsrc = fgets(buf,sizeof(buf),fp);
-    if(feof(fp)) buf[0] = '\0';
-    else buf[strlen(buf)-1] = '\0'; /* chomp newline */
-    if (argc == 2) picolSetResult(i,buf);
-    else if(getsrc) {
-      picolSetVar(i,argv[2],buf);
-      picolSetIntResult(i,strlen(buf));
+    while(fgets(buf,sizeof(buf),fp)) { /* long lines take several reads */
+      getsrc = buf;
+      picolStrAppend(&line,buf);
+      if(line.s[line.len-1] == '\n') break;
+    }
+    if(feof(fp))     line.len = 0;
+    else if(line.len) line.len--;   /* chomp newline */
+    if(line.s) line.s[line.len] = '\0';
+    if (argc == 2) picolSetStrResult(i,&line);
+    else {
+      if(getsrc) {
+        picolSetVar(i,argv[2],line.s);
+        picolSetIntResult(i,line.len);
+      }
+      free(line.s);
     }
   }
   return PICOL_OK;
@@ -920,13 +1252,15 @@ COMMAND(if) {
   return picolSetResult(i,"");
 }
 int picol_InNi(picolInterp *i, int argc, char **argv, void *pd) {
-  char buf[MAXSTR], *cp;
-  int in = EQ(argv[0],"in");
+  char *buf, *cp;
+  int in = EQ(argv[0],"in"), found = 0;
   ARITY2(argc == 3, "in|ni element list");
   /* ARITY2 "ni element list" */
+  buf = malloc(strlen(argv[2])+1);
   FOREACH(buf,cp,argv[2])
-    if(EQ(buf,argv[1])) return picolSetBoolResult(i,in);
-  return picolSetBoolResult(i,!in);
+    if(EQ(buf,argv[1])) {found = 1; break;}
+  free(buf);
+  return picolSetBoolResult(i,(found? in : !in));
 }
 COMMAND(incr) {
   int value = 0, increment = 1;
@@ -940,7 +1274,8 @@ COMMAND(incr) {
   return picolSetIntResult(i, value);
 }
 COMMAND(info) {
-  char   buf[MAXSTR] = "", *pat = "*";
+  char   *pat = "*";
+  picolStr buf = {NULL,0,0};
   picolCmd *c = i->commands;
   int procs = SUBCMD("procs");
   ARITY2(argc == 2 || argc == 3,
@@ -948,25 +1283,23 @@ COMMAND(info) {
   if(argc == 3) pat = argv[2];
   if (SUBCMD("vars") || SUBCMD("globals")) {
     picolCallFrame *cf = i->callframe;
-    picolVar       *v;
+    int             j;
     if(SUBCMD("globals")) {while(cf->parent) cf = cf->parent;}
-    for(v = cf->vars; v; v = v->next) {
-      if(picolMatch(pat,v->name)) LAPPEND(buf,v->name);
+    for(j = cf->nvars-1; j >= 0; j--) { /* newest first */
+      if(picolMatch(pat,cf->vars[j]->name)) picolStrLappend(&buf,cf->vars[j]->name);
     }
-    picolSetResult(i,buf);
+    picolSetStrResult(i,&buf);
   } else if (SUBCMD("args") || SUBCMD("body")) {
     if(argc==2) return picolErr1(i,"usage: info %s procname", argv[1]);
-    for( ; c; c = c->next) {
-      if(EQ(c->name,argv[2])) {
-        char **pd = c->privdata;
-        if(pd) return picolSetResult(i,pd[(EQ(argv[1],"args")?0 : 1)]);
-        else   return picolErr1(i,"\"%s\" isn't a procedure", c->name);
-      }
+    if((c = picolGetCmd(i,argv[2]))) {
+      picolProc *pd = c->privdata;
+      if(pd) return picolSetResult(i,EQ(argv[1],"args")? pd->args : pd->body);
+      else   return picolErr1(i,"\"%s\" isn't a procedure", c->name);
     }
   } else if (SUBCMD("commands") || procs) {
     for( ; c; c = c->next)
-      if((!procs||c->privdata)&&picolMatch(pat,c->name)) LAPPEND(buf,c->name);
-    picolSetResult(i,buf);
+      if((!procs||c->privdata)&&picolMatch(pat,c->name)) picolStrLappend(&buf,c->name);
+    picolSetStrResult(i,&buf);
   } else if (SUBCMD("exists")) {
     if(argc != 3) return picolErr(i,"usage: info exists varName");
     picolSetBoolResult(i, (int)picolGetVar(i,argv[2]));
@@ -1014,120 +1347,156 @@ COMMAND(interp) {
   } else return picolErr(i,"usage: interp alias|create|eval ...");
 }
 COMMAND(join) {
-  char buf[MAXSTR] = "", buf2[MAXSTR]="", *with = " ", *cp, *cp2 = NULL;
+  char *buf, *buf2, *with = " ", *cp, *cp2;
+  int n = 0;
   ARITY2(argc == 2 || argc == 3, "join list ?joinString?")
   if(argc == 3) with = argv[2];
+  buf = malloc(strlen(argv[1])+1);
+  FOREACH(buf,cp,argv[1]) n++;
+  cp2 = buf2 = malloc(strlen(argv[1])+n*strlen(with)+1);
   for(cp=picolParseList(argv[1],buf); cp; cp=picolParseList(cp,buf)) {
-    APPEND(buf2,buf);
-    cp2 = buf2 + strlen(buf2);
-    if(*with) APPEND(buf2,with);
+    strcpy(cp2,buf);  cp2 += strlen(cp2);
+    strcpy(cp2,with); cp2 += strlen(with);
   }
-  if(cp2) *cp2 = '\0'; /* remove last separator */
-  return picolSetResult(i,buf2);
+  if(n) cp2 -= strlen(with); /* remove last separator */
+  *cp2 = '\0';
+  picolSetResult(i,buf2);
+  free(buf); free(buf2);
+  return PICOL_OK;
 }
 COMMAND(lappend) {
-  char buf[MAXSTR] = "";
-  int a;
+  char *buf, *list;
   picolVar *v;
   ARITY2(argc >= 2, "lappend varName ?value value ...?");
-  if((v = picolGetVar(i,argv[1]))) strcpy(buf, v->val);
-  for(a = 2; a < argc; a++) LAPPEND(buf,argv[a]);
+  v = picolGetVar(i,argv[1]);
+  if(v && !v->val) v = picolGetGlobalVar(i,argv[1]);
+  list = picolListAlloc(argc-2,argv+2);
+  buf  = malloc((v? strlen(v->val) : 0)+strlen(list)+2);
+  strcpy(buf, (v? v->val : ""));
+  if(*buf && *list) strcat(buf," ");
+  strcat(buf,list);
   picolSetVar(i,argv[1],buf);
-  return picolSetResult(i,buf);
+  picolSetResult(i,buf);
+  free(list); free(buf);
+  return PICOL_OK;
 }
 COMMAND(lindex) {
-  char buf[MAXSTR] = "", *cp;
+  char *buf, *cp;
   int n = 0, idx;
   ARITY2(argc == 3, "lindex list index")
   SCAN_INT(idx,argv[2]);
+  buf = malloc(strlen(argv[1])+1); /* elements are never longer */
   for(cp=picolParseList(argv[1],buf); cp; cp=picolParseList(cp,buf), n++)
-    if(n==idx) return picolSetResult(i,buf);
+    if(n==idx) {picolSetResult(i,buf); break;}
+  free(buf);
   return PICOL_OK;
 }
 COMMAND(linsert) {
-  char buf[MAXSTR] = "", buf2[MAXSTR]="", *cp;
+  char *buf, *cp;
+  picolStr buf2 = {NULL,0,0};
   int pos = -1, j=0, a, atend=0;
   ARITY2(argc >= 3, "linsert list index element ?element ...?")
   if(!EQ(argv[2],"end")) {SCAN_INT(pos,argv[2]);}
   else atend = 1;
+  buf = malloc(strlen(argv[1])+1);
   FOREACH(buf,cp,argv[1]) {
-    if(!atend && pos==j) for(a=3; a < argc; a++) LAPPEND(buf2, argv[a]);
-    LAPPEND(buf2,buf);
+    if(!atend && pos==j) for(a=3; a < argc; a++) picolStrLappend(&buf2, argv[a]);
+    picolStrLappend(&buf2,buf);
     j++;
   }
-  if(atend) for(a=3; a<argc; a++) LAPPEND(buf2, argv[a]);
-  return picolSetResult(i, buf2);
+  if(atend) for(a=3; a<argc; a++) picolStrLappend(&buf2, argv[a]);
+  free(buf);
+  return picolSetStrResult(i, &buf2);
 }
 COMMAND(list) {
-  char buf[MAXSTR] = "";
-  int a;
+  char *buf;
   /* ARITY2 "list ?value ...?" for documentation */
-  for(a=1; a<argc; a++) LAPPEND(buf,argv[a]);
-  return picolSetResult(i,buf);
+  buf = picolListAlloc(argc-1,argv+1);
+  picolSetResult(i,buf);
+  free(buf);
+  return PICOL_OK;
 }
 COMMAND(llength) {
-  char buf[MAXSTR], *cp;
+  char *buf, *cp;
   int n = 0;
   ARITY2(argc == 2, "llength list")
+  buf = malloc(strlen(argv[1])+1);
   FOREACH(buf,cp,argv[1])  n++;
+  free(buf);
   return picolSetIntResult(i,n);
 }
 COMMAND(lrange) {
-  char buf[MAXSTR] = "", buf2[MAXSTR] = "", *cp;
+  char *buf, *cp;
+  picolStr buf2 = {NULL,0,0};
   int from, to = LONG_MAX, a = 0;
   ARITY2(argc == 4, "lrange list first last")
   SCAN_INT(from,argv[2]);
   if(!EQ(argv[3],"end")) SCAN_INT(to,argv[3]);
+  buf = malloc(strlen(argv[1])+1);
   FOREACH(buf,cp,argv[1]) {
-    if(a>=from && a<=to) LAPPEND(buf2,buf);
+    if(a>=from && a<=to) picolStrLappend(&buf2,buf);
     a++;
   }
-  return picolSetResult(i,buf2);
+  free(buf);
+  return picolSetStrResult(i,&buf2);
 }
 COMMAND(lreplace) {
-  char buf[MAXSTR] = "", *what = "", *cp;
-  char buf2[MAXSTR]="";
+  char *buf, *what = "", *cp;
+  picolStr buf2 = {NULL,0,0};
   int from, to = LONG_MAX, a = 0, done = 0, j;
   if(argc == 5) what = argv[4];
   ARITY2(argc >= 4, "lreplace list first last ?element element ...?")
   SCAN_INT(from,argv[2]);
   if(!EQ(argv[3],"end")) SCAN_INT(to,argv[3]);
+  buf = malloc(strlen(argv[1])+1);
   FOREACH(buf,cp,argv[1]) {
-    if(a<from || a>to) {LAPPEND(buf2,buf);}
+    if(a<from || a>to) {picolStrLappend(&buf2,buf);}
     else if(!done) {
-      for(j=4; j<argc; j++) LAPPEND(buf2,argv[j]);
+      for(j=4; j<argc; j++) picolStrLappend(&buf2,argv[j]);
       done = 1;
     }
     a++;
   }
-  return picolSetResult(i,buf2);
+  free(buf);
+  return picolSetStrResult(i,&buf2);
 }
 COMMAND(lsearch) {
-  char buf[MAXSTR] = "", *cp;
-  int j = 0; 
+  char *buf, *cp;
+  int j = 0, found = -1;
   ARITY2(argc == 3, "lsearch list pattern")
+  buf = malloc(strlen(argv[1])+1);
   FOREACH(buf,cp,argv[1]) {
-    if(picolMatch(argv[2],buf)) return picolSetIntResult(i,j);
+    if(picolMatch(argv[2],buf)) {found = j; break;}
     j++;
   }
-  return picolSetResult(i,"-1");
+  free(buf);
+  return picolSetIntResult(i,found);
 }
 COMMAND(lset) {
-  char buf[MAXSTR] = "", buf2[MAXSTR]="", *cp;
+  char *buf, *cp;
+  picolStr buf2 = {NULL,0,0};
   picolVar *var; int pos, a=0;
   ARITY2(argc == 4, "lset listVar index value")
   GET_VAR(var,argv[1]);
   if(!var->val) var = picolGetGlobalVar(i,argv[1]);
   if(!var) return picolErr1(i, "no variable %s", argv[1]);
   SCAN_INT(pos,argv[2]);
+  buf = malloc(strlen(var->val)+1);
   FOREACH(buf,cp,var->val) {
-    if(a==pos) {LAPPEND(buf2,argv[3]);}
-    else        LAPPEND(buf2,buf);
+    if(a==pos) {picolStrLappend(&buf2,argv[3]);}
+    else        picolStrLappend(&buf2,buf);
     a++;
   }
-  if(pos < 0 || pos > a) return picolErr(i,"list index out of range");
-  picolSetVar(i,var->name,buf2);
-  return picolSetResult(i,buf2);
+  free(buf);
+  if(pos < 0 || pos > a) {
+    free(buf2.s);
+    return picolErr(i,"list index out of range");
+  }
+  buf = picolStrDone(&buf2);
+  picolSetVar(i,var->name,buf);
+  picolSetResult(i,buf);
+  free(buf);
+  return PICOL_OK;
 }
 /* ----------- sort functions for lsort ---------------- */
 int qsort_cmp(const void* a, const void *b) {
@@ -1138,15 +1507,24 @@ int qsort_cmp_int(const void* a, const void *b) {
   int diff = atoi(*(const char**)a)-atoi(*(const char**)b);
   return (diff > 0? 1: diff < 0? -1: 0);}
 
+int picolLsort(picolInterp *i, int argc, char **argv, void *pd);
 COMMAND(lsort) {
-  char buf[MAXSTR] = "_l "; /* dispatch to helper function picolLsort */
+  char *list = argv[argc-1], *buf, *cp, **av;
+  int ac = 0, n = 1, rc;
   ARITY2(argc == 2 || argc == 3, "lsort ?-decreasing|-integer|-unique? list")
-  APPEND(buf,argv[1]);
-  if(argc==3) {APPEND(buf," "); APPEND(buf,argv[2]);}
-  return picolEval(i,buf);
+  buf = malloc(strlen(list)+1); /* elements are never longer */
+  FOREACH(buf,cp,list) ac++;
+  av = malloc(sizeof(char*)*(ac+2));
+  av[0] = "_l";            /* dispatch to helper function picolLsort */
+  if(argc==3) av[n++] = strdup(argv[1]);
+  FOREACH(buf,cp,list) av[n++] = strdup(buf);
+  rc = picolLsort(i,n,av,NULL);
+  while(--n > 0) free(av[n]);
+  free(av); free(buf);
+  return rc;
 }
 int picolLsort(picolInterp *i, int argc, char **argv, void *pd) {
-  char buf[MAXSTR] = "";
+  picolStr buf = {NULL,0,0};
   char** av = argv+1;
   int ac = argc-1, a;
   if(argc<2) return picolSetResult(i,"");
@@ -1157,12 +1535,12 @@ int picolLsort(picolInterp *i, int argc, char **argv, void *pd) {
   } else if(argc>2 && EQ(argv[1],"-unique")) {
     qsort(++av,--ac,sizeof(char*),qsort_cmp);
     for(a=0; a<ac; a++) {
-      if(a==0 || !EQ(av[a],av[a-1])) LAPPEND(buf,av[a]);
+      if(a==0 || !EQ(av[a],av[a-1])) picolStrLappend(&buf,av[a]);
     }
-    return picolSetResult(i,buf);
+    return picolSetStrResult(i,&buf);
   } else qsort(av,ac,sizeof(char*),qsort_cmp);
-  picolSetResult(i,picolList(buf,ac,av));
-  return PICOL_OK;
+  for(a=0; a<ac; a++) picolStrLappend(&buf,av[a]);
+  return picolSetStrResult(i,&buf);
 }
 int picol_Math(picolInterp *i, int argc, char **argv, void *pd) {
   int a = 0, b = 0, c = -1, p;
@@ -1219,19 +1597,24 @@ COMMAND(pid) {
   return picolSetIntResult(i,getpid());
 }
 COMMAND(proc) {
-  char **procdata = NULL;
+  picolProc *procdata = NULL;
   picolCmd* c = picolGetCmd(i,argv[1]);
   ARITY2(argc == 4, "proc name args body");
   if(c) procdata = c->privdata;
   if(!procdata) {
-    procdata = malloc(sizeof(char*)*2);
+    procdata = calloc(1,sizeof(*procdata));
     if(c) {
       c->privdata = procdata;
       c->func = picolCallProc; /* may override C-coded cmds */
     }
   }
-  procdata[0] = strdup(argv[2]); /* arguments list */
-  procdata[1] = strdup(argv[3]); /* procedure body */
+  if(procdata->script) { /* redefined: a running call holds its own ref */
+    picolReleaseScript(procdata->script);
+    free(procdata->args); free(procdata->body);
+  }
+  procdata->args   = strdup(argv[2]); /* arguments list */
+  procdata->body   = strdup(argv[3]); /* procedure body */
+  procdata->script = picolCompile(i,procdata->body);
   if(!c) picolRegisterCmd(i,argv[1],picolCallProc,procdata);
   return PICOL_OK;
 }
@@ -1264,29 +1647,38 @@ COMMAND(rand) {
   return picolSetIntResult(i, n? rand()%n : rand());
 }
 COMMAND(read) {
-  char  buf[MAXSTR*64];
-  int   size = sizeof(buf)-1;
+  char     buf[MAXSTR];
+  int      size = -1, n;  /* all of it, by default */
+  picolStr data = {NULL,0,0};
   FILE *fp = NULL;
   ARITY2(argc == 2 || argc == 3, "read channelId ?size?")
   SCAN_PTR(fp, argv[1]); /* caveat usor */
   if(argc==3) SCAN_INT(size,argv[2]);
-  buf[fread(buf,1,size,fp)] = '\0';
-  return picolSetResult(i,buf); 
+  while(size != 0) {
+    n = (size < 0 || size >= (int)sizeof(buf))? (int)sizeof(buf)-1 : size;
+    if((n = fread(buf,1,n,fp)) <= 0) break;
+    buf[n] = '\0';
+    picolStrAppend(&data,buf);
+    if(size > 0) size -= n;
+  }
+  return picolSetStrResult(i,&data);
 }
 COMMAND(rename) {
-  int found = 0;
-  picolCmd *c, *last = NULL;
+  picolName *n, *n2;
+  picolCmd  *c, **cp;
   ARITY2(argc == 3, "rename oldName newName")
-    for(c = i->commands; c; last = c, c=c->next) {
-      if(EQ(c->name,argv[1])) {
-        if(!last && EQ(argv[2],"")) i->commands = c->next; /* delete first */
-        else if(EQ(argv[2],""))     last->next = c->next;  /* delete other */
-        else           c->name = strdup(argv[2]); /* overwrite, don't free */
-        found = 1;
-        break;
-      }
-    }
-  if(!found) return picolErr1(i,"can't rename %s: no such command",argv[1]);
+  n = picolGetName(i,argv[1],0);
+  if(!n || !((c = n->cmd))) return picolErr1(i,"can't rename %s: no such command",argv[1]);
+  if(EQ(argv[2],"")) {
+    for(cp = &i->commands; *cp != c; cp = &(*cp)->next) ;
+    *cp = c->next;  /* unlink, don't free: it may be executing */
+  } else {
+    n2 = picolGetName(i,argv[2],1);
+    if(n2->cmd) return picolErr1(i,"can't rename to %s: command already exists",argv[2]);
+    c->name = n2->name;
+    n2->cmd = c;
+  }
+  n->cmd = NULL;
   return PICOL_OK;
 }
 COMMAND(return) {
@@ -1324,14 +1716,20 @@ COMMAND(set) {
     }
 }
 int picolSource(picolInterp *i,char *filename) {
-  char buf[MAXSTR*64];
+  char *buf;
+  long  size;
   int rc;
   FILE *fp = fopen(filename,"r");
   if (!fp) return picolErr1(i,"No such file or directory '%s'",filename);
   picolSetVar(i,"::_script_",filename);
-  buf[fread(buf,1,sizeof(buf),fp)] = '\0';
+  fseek(fp,0,SEEK_END);
+  size = ftell(fp);
+  fseek(fp,0,SEEK_SET);
+  buf = malloc(size+1);
+  buf[fread(buf,1,size,fp)] = '\0';
   fclose(fp);
   rc = picolEval(i,buf);
+  free(buf);
   picolSetVar(i,"::_script_",""); /* script only known during [source] */
   return rc;
 }
@@ -1340,28 +1738,29 @@ COMMAND(source) {
   return picolSource(i, argv[1]);
 }
 COMMAND(split) {
-  char *split = " ", *cp, *start;
-  char buf[MAXSTR] = "", buf2[MAXSTR] = "";
+  char *split = " ", *cp, *start, *buf2;
+  picolStr buf = {NULL,0,0};
   ARITY2(argc == 2 || argc == 3, "split string ?splitChars?");
   if(argc==3) split = argv[2];
+  buf2 = calloc(1,strlen(argv[1])+2);
   if(EQ(split,"")) {
     for(cp = argv[1]; *cp; cp++) {
       buf2[0] = *cp;
-      LAPPEND(buf, buf2);
+      picolStrLappend(&buf, buf2);
     }
   } else {
     for(cp = argv[1], start=cp; *cp; cp++) {
       if(strchr(split,*cp)) {
         strncpy(buf2,start,cp-start);
-        buf2[strlen(buf2)] = '\0';
-        LAPPEND(buf,buf2);
-        buf2[0] = '\0';
+        buf2[cp-start] = '\0';
+        picolStrLappend(&buf,buf2);
         start = cp+1;
       }
     }
-    LAPPEND(buf,start);
+    picolStrLappend(&buf,start);
   }
-  return  picolSetResult(i,buf);
+  free(buf2);
+  return picolSetStrResult(i,&buf);
 }
 char* picolStrRev(char *str) {
   char *cp = str, *cp2 = str + strlen(str)-1, tmp;
@@ -1377,7 +1776,7 @@ char* picolToUpper(char *str) {
   return str;
   }
 COMMAND(string) {
-  char buf[MAXSTR] = "\0";
+  char buf[2] = "\0", *cp;
   ARITY2(argc >= 3, "string option string ?arg..?")
     if(SUBCMD("length")) picolSetIntResult(i,strlen(argv[2]));
 
@@ -1433,15 +1832,18 @@ COMMAND(string) {
       if(EQ(argv[4],"end")) to = maxi; else SCAN_INT(to,argv[4]);
       if(from < 0) from = 0; else if(from > maxi) from = maxi;
       if(to < 0)   to = 0;   else if(to > maxi)   to   = maxi;
-      strncpy(buf,&argv[2][from],to-from+1);
-      buf[to] = '\0';
-      picolSetResult(i,buf);
+      cp = calloc(1,maxi+2);
+      strncpy(cp,&argv[2][from],to-from+1);
+      cp[to] = '\0';
+      picolSetResult(i,cp);
+      free(cp);
 
     } else if(SUBCMD("repeat")) {
+      picolStr rep = {NULL,0,0};
       int j, n; SCAN_INT(n,argv[3]);
       ARITY2(argc == 4, "string repeat string count") 
-      for(j=0;j<n;j++) APPEND(buf,argv[2]);
-      picolSetResult(i,buf);
+      for(j=0;j<n;j++) picolStrAppend(&rep,argv[2]);
+      picolSetStrResult(i,&rep);
 
     } else if(SUBCMD("reverse")) {
       ARITY2(argc == 3, "string reverse str")
@@ -1465,9 +1867,12 @@ COMMAND(string) {
         for( ; end>=start;end--) {if(strchr(trimchars,*end)==NULL) break;}
       }
       len = end - start+1;
-      strncpy(buf,start,len);
-      buf[len] = '\0';
-      return picolSetResult(i,buf);
+      cp  = malloc(len+1);
+      strncpy(cp,start,len);
+      cp[len] = '\0';
+      picolSetResult(i,cp);
+      free(cp);
+      return PICOL_OK;
       
     } else return picolErr1(i,
           "bad option '%s', must be compare, equal, first, index, is int, last,\
@@ -1480,18 +1885,22 @@ COMMAND(subst) {
   return picolSubst(i,argv[1]);
 }
 COMMAND(switch) {
-  char *cp, buf[MAXSTR] = "";
-  int fallthrough = 0, a;
+  char *cp, *buf;
+  int fallthrough = 0, a, rc;
   ARITY2(argc > 2, "switch string pattern body ... ?default body?")
     if(argc==3) { /* braced body variant */
+      buf = malloc(strlen(argv[2])+1);
       FOREACH(buf,cp,argv[2]) {
         if(fallthrough || EQ(buf,argv[1]) || EQ(buf,"default")) {
           cp = picolParseList(cp,buf);
-          if(!cp) return picolErr(i,"switch: list must have an even number");
-          if(EQ(buf,"-")) fallthrough = 1;
-          else return picolEval(i,buf);
+          if(!cp) rc = picolErr(i,"switch: list must have an even number");
+          else if(EQ(buf,"-")) {fallthrough = 1; continue;}
+          else rc = picolEval(i,buf);
+          free(buf);
+          return rc;
         }
       }
+      free(buf);
     } else {     /* unbraced body */
       if(argc%2) return picolErr(i,"switch: list must have an even number");
       for(a = 2; a < argc; a++) {
@@ -1522,19 +1931,25 @@ COMMAND(trace) {
   return PICOL_OK;
 }
 COMMAND(unset) {
-  picolVar *v, *lastv = NULL;
+  picolCallFrame *cf = i->callframe;
+  picolName      *n;
+  int             j;
   ARITY2(argc == 2, "unset varName")
-    for(v = i->callframe->vars; v; lastv = v, v = v->next) {
-      if(EQ(v->name,argv[1])) {
-        if(!lastv) i->callframe->vars = v->next;
-        else       lastv->next = v->next; /* may need to free? */
+  if((n = picolGetName(i,argv[1],0))) {
+    for(j = 0; j < cf->nvars; j++) {
+      if(cf->vars[j]->name == n->name) {
+        free(cf->vars[j]->val); free(cf->vars[j]);
+        memmove(cf->vars+j,cf->vars+j+1,(cf->nvars-j-1)*sizeof(picolVar*));
+        cf->nvars--;
+        if(!cf->parent) n->global = NULL;
         break;
       }
     }
+  }
   return picolSetResult(i,"");
 }
 COMMAND(uplevel) {
-  char buf[MAXSTR];
+  char *buf;
   int rc, delta;
   picolCallFrame* cf = i->callframe;
   ARITY2(argc >= 3, "uplevel level command ?arg...?");
@@ -1542,17 +1957,19 @@ COMMAND(uplevel) {
   else SCAN_INT(delta,argv[1]);
   for( ;delta>0 && i->callframe->parent; delta--)
     i->callframe = i->callframe->parent; 
-  rc = picolEval(i, picolConcat(buf,argc-1,argv+1));
+  buf = picolConcatAlloc(argc-1,argv+1);
+  rc  = picolEval(i, buf);
+  free(buf);
   i->callframe = cf; /* back to normal */
   return rc;
 }
 COMMAND(variable) {
-  char buf[MAXSTR];     /* limited to :: namespace so far */
+  char *av[2];          /* limited to :: namespace so far */
   int a, rc = PICOL_OK;
   ARITY2(argc>1, "variable ?name value...? name ?value?")
     for(a = 1; a < argc && rc == PICOL_OK; a++) {
-      strcpy(buf,"global "); strcat(buf,argv[a]);
-      rc = picolEval(i,buf);
+      av[0] = "global"; av[1] = argv[a];
+      rc = picol_global(i,2,av,NULL);
       if(rc == PICOL_OK && a < argc-1) {
         rc = picolSetGlobalVar(i,argv[a],argv[a+1]); a++;
       }
@@ -1592,6 +2009,9 @@ void picolRegisterCoreCmds(picolInterp *i) {
   picolRegisterCmd(i,"eof",    picolFileUtil,NULL);
   picolRegisterCmd(i,"eq",     picol_EqNe,NULL);
   picolRegisterCmd(i,"error",  picol_error,NULL);
+#ifdef PICOL_ESIS
+  picolRegisterCmd(i,"esis",   picol_esis,NULL);
+#endif
   picolRegisterCmd(i,"eval",   picol_eval,NULL);
   picolRegisterCmd(i,"exec",   picol_exec,NULL);
   picolRegisterCmd(i,"exit",   picol_exit,NULL);
@@ -1686,8 +2106,10 @@ int main(int argc, char **argv) {
       if(v) puts(v->val);
     } else puts(i->result);
   } else {    /* first arg is file to source, rest goes to argv */
+    char *args = picolConcatAlloc(argc-1,argv+1);
     picolSetVar(i,   "argv0",argv[1]);
-    picolSetVar(i,   "argv", picolConcat(buf,argc-1,argv+1));
+    picolSetVar(i,   "argv", args);
+    free(args);
     picolSetIntVar(i,"argc",argc-2);
     rc = picolSource(i,argv[1]);
     if(rc != PICOL_OK) {
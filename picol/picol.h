@@ -6,7 +6,7 @@
 #define PICOL_H
 
 #define PICOL_PATCHLEVEL "0.1.22"
-#define MAXSTR 4096
+#define MAXSTR 4096 /* size of work buffers, values themselves are unlimited */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,6 +14,9 @@
 #include <ctype.h>
 #include <time.h>
 #include <limits.h>
+#ifdef PICOL_ESIS
+#   include <esisio.h> /* 'esis' command, see picol_esis */
+#endif
 
 #ifndef _MSC_VER
 #   include <unistd.h>
@@ -67,6 +70,10 @@
 enum {PICOL_OK, PICOL_ERR, PICOL_RETURN, PICOL_BREAK, PICOL_CONTINUE};
 enum {PT_ESC,PT_STR,PT_CMD,PT_VAR,PT_SEP,PT_EOL,PT_EOF, PT_XPND};
 
+#define DEFAULT_ARRSIZE 16
+#define DEFAULT_NAMESIZE 64   /* initial size of the name table, a power of 2 */
+#define DEFAULT_CACHESIZE 256 /* slots of the script cache, a power of 2 */
+
 /* ------------------------------------------------------------------- types */
 typedef struct picolParser {
   char  *text;
@@ -79,6 +86,31 @@ typedef struct picolParser {
   int    expand;      /* true after {*} */
 } picolParser;
 
+typedef struct picolToken { /* a word or command end of a compiled script */
+  int                 type;    /* PT_ESC, PT_STR, PT_VAR, PT_CMD or PT_EOL */
+  int                 newword; /* 1 if it starts a word, else appended */
+  int                 expand;  /* 1 if preceded by {*} */
+  char               *text;    /* backslash escapes resolved for PT_ESC */
+  struct picolScript *cmd;     /* compiled command of a PT_CMD */
+} picolToken;
+
+typedef struct picolScript { /* script text parsed once, see picolCompile */
+  char       *text;
+  unsigned    hash;
+  int         ntokens, refcount;
+  picolToken *tokens;
+} picolScript;
+
+typedef struct picolProc { /* private data of a proc */
+  char        *args, *body;
+  picolScript *script;         /* body compiled by 'proc', or NULL */
+} picolProc;
+
+typedef struct picolStr { /* growing string, 's' is NULL until appended to */
+  char   *s;
+  size_t  len, size;
+} picolStr;
+
 typedef struct picolVar {
   char            *name, *val;
   struct picolVar *next;
@@ -94,8 +126,17 @@ typedef struct picolCmd {
   struct picolCmd *next;
 } picolCmd;
 
+typedef struct picolName { /* interned name of commands and variables */
+  char             *name;
+  unsigned          hash;
+  picolCmd         *cmd;    /* command of this name, or NULL */
+  picolVar         *global; /* global variable of this name, or NULL */
+  struct picolName *next;
+} picolName;
+
 typedef struct picolCallFrame {
-  picolVar              *vars;
+  picolVar             **vars;  /* small vector, names compared as pointers */
+  int                    nvars, size;
   char                  *command;
   struct picolCallFrame *parent; /* parent is NULL at top level */
 } picolCallFrame;
@@ -103,23 +144,49 @@ typedef struct picolCallFrame {
 typedef struct picolInterp {
   int             level;              /* Level of nesting */
   picolCallFrame *callframe;
-  picolCmd       *commands;
+  picolCmd       *commands;       /* newest first, for 'info commands' */
+  picolName     **names;          /* hash table of interned names */
+  unsigned        nnames, namesize;
+  picolScript    *scripts[DEFAULT_CACHESIZE]; /* eval'd text, by hash */
+#ifdef PICOL_ESIS
+  struct picolEsis *esis;         /* state of 'esis', created on first use */
+#endif
   char           *current;        /* currently executed command */
   char           *result;
   int             trace; /* 1 to display each command, 0 if not */
 } picolInterp;
 
-#define DEFAULT_ARRSIZE 16
-
 typedef struct picolArray {
   picolVar *table[DEFAULT_ARRSIZE];
   int       size;
 } picolArray;
 
+#ifdef PICOL_ESIS
+typedef struct picolEsisHandler { /* scripts run on the events of one GI */
+  char                    *gi;        /* "" for the default handler */
+  char                    *script[3]; /* by ESIS_START, ESIS_CDATA, ESIS_END */
+  struct picolEsis        *esis;
+  struct picolEsisHandler *next;
+} picolEsisHandler;
+
+typedef struct picolEsis {
+  picolInterp      *interp;
+  picolEsisHandler *handlers;
+  ESIS_Parser       parser; /* while parsing, else NULL */
+  ESIS_Writer       writer; /* ESIS output of copy/start/cdata/end to stdout */
+  ESIS_ElemEvent    event;  /* the event being handled, valid if elem */
+  ESIS_Elem        *elem;
+  const ESIS_Char  *data;   /* character data of an ESIS_CDATA event */
+  size_t            len;
+  int               rc;     /* PICOL_ERR after a handler script failed */
+} picolEsis;
+#endif
+
 /* ------------------- prototypes -- so far only some needed forward decl's */
 picolVar*    picolArrGet1(picolArray *ap, char *key);
 picolVar*    picolArrSet1(picolInterp *i, char *name, char *value);
 picolInterp* picolCreateInterp(void);
+picolName*   picolGetName(picolInterp *i, char *name, int create);
 void*        picolIsPtr(char* str);
 int          picolSetVar2(picolInterp *i, char *name, char *val,int glob);
 
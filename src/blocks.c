@@ -20,6 +20,8 @@
 #include "inlines.h"
 #include "houdini.h"
 #include "buffer.h"
+#include "outline.h"
+#include "stats.h"
 
 #define CODE_INDENT 4
 #define TAB_STOP 4
@@ -30,6 +32,35 @@
 
 #define peek_at(i, n) (i)->data[n]
 
+// The block starts that are possible for the first non-space character
+// of a line, so that open_new_blocks only runs the scanners that can
+// match.  A line of prose starting with a letter needs none of them.
+#define BLOCK_START_QUOTE 1   // >
+#define BLOCK_START_ATX 2     // #
+#define BLOCK_START_FENCE 4   // ` ~
+#define BLOCK_START_HTML 8    // <
+#define BLOCK_START_SETEXT 16 // = -
+#define BLOCK_START_BREAK 32  // * - _
+#define BLOCK_START_LIST 64   // * - + 0-9
+
+static const uint8_t BLOCK_STARTS[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 96, 64, 0, 112, 0, 0,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 0, 0, 8, 16, 1, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 32,
+    4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
 static bool S_last_line_blank(const cmark_node *node) {
   return (node->flags & CMARK_NODE__LAST_LINE_BLANK) != 0;
 }
@@ -66,6 +97,7 @@ static cmark_node *make_block(cmark_mem *mem, cmark_node_type tag,
   e = (cmark_node *)mem->calloc(1, sizeof(*e));
   cmark_strbuf_init(mem, &e->content, 32);
   e->type = (uint16_t)tag;
+  STATS_ADD(nodes[tag], 1);
   e->flags = CMARK_NODE__OPEN;
   e->start_line = start_line;
   e->start_column = start_column;
@@ -80,18 +112,13 @@ static cmark_node *make_document(cmark_mem *mem) {
   return e;
 }
 
-cmark_parser *cmark_parser_new_with_mem(int options, cmark_mem *mem) {
-  cmark_node *document;
-  cmark_parser *parser = (cmark_parser *)mem->calloc(1, sizeof(cmark_parser));
-  
-  parser->mem = mem;
-
-  document = make_document(mem);
-
-  cmark_strbuf_init(mem, &parser->curline, 256);
-  cmark_strbuf_init(mem, &parser->linebuf, 0);
+// Start a new document.
+static void S_parser_init(cmark_parser *parser, int options) {
+  cmark_node *document = make_document(parser->mem);
 
-  parser->refmap = cmark_reference_map_new(mem);
+  document->as.document.max_output = parser->budget.limits.max_output;
+  memset(&parser->doc_stats, 0, sizeof(parser->doc_stats));
+  parser->doc_stats.nodes[CMARK_NODE_DOCUMENT] = 1;
   parser->root = document;
   parser->current = document;
   parser->line_number = 0;
@@ -105,7 +132,23 @@ cmark_parser *cmark_parser_new_with_mem(int options, cmark_mem *mem) {
   parser->last_line_length = 0;
   parser->options = options;
   parser->last_buffer_ended_with_cr = false;
+}
 
+cmark_parser *cmark_parser_new_with_mem(int options, cmark_mem *mem) {
+  cmark_parser *parser = (cmark_parser *)mem->calloc(1, sizeof(cmark_parser));
+  STATS_ENTER(&parser->stats);
+
+  parser->mem = mem;
+
+  cmark_strbuf_init(mem, &parser->curline, 256);
+  cmark_strbuf_init(mem, &parser->linebuf, 0);
+
+  parser->refmap = cmark_reference_map_new(mem);
+  parser->inline_ws =
+      cmark_inline_workspace_new(mem, &parser->budget, &parser->doc_stats);
+  S_parser_init(parser, options);
+
+  STATS_LEAVE();
   return parser;
 }
 
@@ -114,14 +157,50 @@ cmark_parser *cmark_parser_new(int options) {
   return cmark_parser_new_with_mem(options, &DEFAULT_MEM_ALLOCATOR);
 }
 
+void cmark_parser_reset(cmark_parser *parser, int options) {
+  STATS_ENTER(&parser->stats);
+  if (parser->root != NULL) {
+    // the last document was not finished
+    cmark_node_free(parser->root);
+  }
+  cmark_strbuf_clear(&parser->curline);
+  cmark_strbuf_clear(&parser->linebuf);
+  cmark_reference_map_clear(parser->refmap);
+  parser->budget.nodes = 0;
+  parser->budget.steps = 0;
+  parser->budget.references = 0;
+#ifdef CMARK_STATS
+  memset(&parser->stats, 0, sizeof(parser->stats));
+#endif
+  S_parser_init(parser, options);
+  STATS_LEAVE();
+}
+
 void cmark_parser_free(cmark_parser *parser) {
   cmark_mem *mem = parser->mem;
+  if (parser->root != NULL) {
+    // the document was not finished
+    cmark_node_free(parser->root);
+  }
   cmark_strbuf_free(&parser->curline);
   cmark_strbuf_free(&parser->linebuf);
   cmark_reference_map_free(parser->refmap);
+  cmark_inline_workspace_free(parser->inline_ws);
   mem->free(parser);
 }
 
+void cmark_parser_set_shared_references(cmark_parser *parser,
+                                        const cmark_reference_map *map) {
+  parser->refmap->shared = map;
+}
+
+void cmark_parser_set_limits(cmark_parser *parser,
+                             const cmark_limits *limits) {
+  parser->budget.limits = *limits;
+  if (parser->root != NULL)
+    parser->root->as.document.max_output = limits->max_output;
+}
+
 static cmark_node *finalize(cmark_parser *parser, cmark_node *b);
 
 // Returns true if line has only space characters, else false.
@@ -226,6 +305,7 @@ static bool ends_with_blank_line(cmark_node *node) {
 
 static cmark_node *finalize(cmark_parser *parser, cmark_node *b) {
   bufsize_t pos;
+  bufsize_t offset;
   cmark_node *item;
   cmark_node *subitem;
   cmark_node *parent;
@@ -258,12 +338,20 @@ static cmark_node *finalize(cmark_parser *parser, cmark_node *b) {
 
   switch (S_type(b)) {
   case CMARK_NODE_PARAGRAPH:
-    while (cmark_strbuf_at(node_content, 0) == '[' &&
+    // reference definitions are parsed in place, and all of them are
+    // dropped from the content at once
+    offset = 0;
+    while (cmark_strbuf_at(node_content, offset) == '[' &&
+           (parser->budget.limits.max_references == 0 ||
+            parser->budget.references <
+                parser->budget.limits.max_references) &&
            (pos = cmark_parse_reference_inline(parser->mem, node_content,
-                                               parser->refmap))) {
+                                               offset, parser->refmap))) {
 
-      cmark_strbuf_drop(node_content, pos);
+      offset = pos;
+      parser->budget.references++;
     }
+    cmark_strbuf_drop(node_content, offset);
     if (is_blank(node_content, 0)) {
       // remove blank node (former reference def)
       cmark_node_free(b);
@@ -295,10 +383,14 @@ static cmark_node *finalize(cmark_parser *parser, cmark_node *b) {
       cmark_strbuf_drop(node_content, pos);
     }
     b->as.code.literal = cmark_chunk_buf_detach(node_content);
+    cmark_doc_stats_add(&parser->doc_stats, b->as.code.literal.data,
+                        b->as.code.literal.len, true);
     break;
 
   case CMARK_NODE_HTML_BLOCK:
     b->as.literal = cmark_chunk_buf_detach(node_content);
+    cmark_doc_stats_add(&parser->doc_stats, b->as.literal.data,
+                        b->as.literal.len, false);
     break;
 
   case CMARK_NODE_LIST:      // determine tight/loose status
@@ -351,6 +443,8 @@ static cmark_node *add_child(cmark_parser *parser, cmark_node *parent,
 
   child = make_block(parser->mem, block_type, parser->line_number, start_column);
   child->parent = parent;
+  parser->budget.nodes++;
+  parser->doc_stats.nodes[block_type]++;
 
   if (parent->last_child) {
     parent->last_child->next = child;
@@ -366,7 +460,8 @@ static cmark_node *add_child(cmark_parser *parser, cmark_node *parent,
 // Walk through node and all children, recursively, parsing
 // string content into inline content where appropriate.
 static void process_inlines(cmark_mem *mem, cmark_node *root,
-                            cmark_reference_map *refmap, int options) {
+                            cmark_reference_map *refmap,
+                            cmark_inline_workspace *ws, int options) {
   cmark_iter *iter = cmark_iter_new(root);
   cmark_node *cur;
   cmark_event_type ev_type;
@@ -375,7 +470,7 @@ static void process_inlines(cmark_mem *mem, cmark_node *root,
     cur = cmark_iter_get_node(iter);
     if (ev_type == CMARK_EVENT_ENTER) {
       if (contains_inlines(S_type(cur))) {
-        cmark_parse_inlines(mem, cur, refmap, options);
+        cmark_parse_inlines(mem, cur, refmap, ws, options);
       }
     }
   }
@@ -383,6 +478,57 @@ static void process_inlines(cmark_mem *mem, cmark_node *root,
   cmark_iter_free(iter);
 }
 
+// Hand what inline parsing needs over to the document, and mark the
+// blocks containing inlines, to be parsed when their children are first
+// looked at.  The parser gets a new reference map.
+static void defer_inlines(cmark_parser *parser) {
+  cmark_mem *mem = parser->mem;
+  cmark_lazy_inlines *lazy =
+      (cmark_lazy_inlines *)mem->calloc(1, sizeof(cmark_lazy_inlines));
+  cmark_iter *iter = cmark_iter_new(parser->root);
+  cmark_node *cur;
+
+  lazy->refmap = parser->refmap;
+  lazy->budget = parser->budget;
+  lazy->options = parser->options;
+  lazy->ws = cmark_inline_workspace_new(mem, &lazy->budget, &lazy->doc_stats);
+  parser->refmap = cmark_reference_map_new(mem);
+  parser->refmap->shared = lazy->refmap->shared;
+  parser->root->as.document.lazy = lazy;
+
+  while (cmark_iter_next(iter) != CMARK_EVENT_DONE) {
+    cur = cmark_iter_get_node(iter);
+    if (contains_inlines(S_type(cur)))
+      cur->flags |= CMARK_NODE__INLINES_PENDING;
+  }
+
+  cmark_iter_free(iter);
+}
+
+void cmark_node_parse_pending(cmark_node *node) {
+  cmark_node *root = node;
+  cmark_lazy_inlines *lazy;
+
+  // cleared first, as parsing adds children to the node
+  node->flags &= ~CMARK_NODE__INLINES_PENDING;
+  while (root->parent != NULL)
+    root = root->parent;
+  lazy = S_type(root) == CMARK_NODE_DOCUMENT ? root->as.document.lazy : NULL;
+  if (lazy == NULL || !contains_inlines(S_type(node)))
+    return;
+
+  cmark_parse_inlines(cmark_node_mem(node), node, lazy->refmap, lazy->ws,
+                      lazy->options);
+  if (lazy->options & CMARK_OPT_NORMALIZE)
+    cmark_consolidate_text_nodes(node);
+}
+
+void cmark_lazy_inlines_free(cmark_mem *mem, cmark_lazy_inlines *lazy) {
+  cmark_reference_map_free(lazy->refmap);
+  cmark_inline_workspace_free(lazy->ws);
+  mem->free(lazy);
+}
+
 // Attempts to parse a list item marker (bullet or enumerated).
 // On success, returns length of the marker, and populates
 // data with the details.  On failure, returns 0.
@@ -481,12 +627,24 @@ static int lists_match(cmark_list *list_data, cmark_list *item_data) {
 }
 
 static cmark_node *finalize_document(cmark_parser *parser) {
+  STATS_START(t_finalize);
   while (parser->current != parser->root) {
     parser->current = finalize(parser, parser->current);
   }
 
   finalize(parser, parser->root);
-  process_inlines(parser->mem, parser->root, parser->refmap, parser->options);
+  STATS_STOP(finalize_ns, t_finalize);
+
+  if (parser->outline != NULL) {
+    // the outline needs no inlines
+  } else if (parser->options & CMARK_OPT_LAZY_INLINES) {
+    defer_inlines(parser);
+  } else {
+    STATS_START(t_inline);
+    process_inlines(parser->mem, parser->root, parser->refmap,
+                    parser->inline_ws, parser->options);
+    STATS_STOP(inline_ns, t_inline);
+  }
 
   return parser->root;
 }
@@ -521,6 +679,44 @@ cmark_node *cmark_parse_document(const char *buffer, size_t len, int options) {
   return document;
 }
 
+cmark_outline *cmark_parse_outline(const char *buffer, size_t len,
+                                   int options) {
+  cmark_parser *parser = cmark_parser_new(options);
+  cmark_outline *outline = cmark_outline_new(parser->mem);
+  cmark_node *block;
+
+  parser->outline = outline;
+  S_parser_feed(parser, (const unsigned char *)buffer, len, true);
+  finalize_document(parser);
+
+  while ((block = parser->root->first_child) != NULL) {
+    cmark_outline_add_block(outline, block);
+    cmark_node_free(block);
+  }
+  cmark_outline_add_references(outline, parser->refmap);
+
+  cmark_parser_free(parser);
+  return outline;
+}
+
+cmark_reference_map *cmark_parse_references(const char *buffer, size_t len,
+                                            int options) {
+  cmark_parser *parser = cmark_parser_new(options);
+  cmark_outline *outline = cmark_outline_new(parser->mem);
+  cmark_reference_map *map;
+
+  // parsed like an outline, so that no tree is built
+  parser->outline = outline;
+  S_parser_feed(parser, (const unsigned char *)buffer, len, true);
+  finalize_document(parser);
+
+  map = parser->refmap;
+  parser->refmap = cmark_reference_map_new(parser->mem);
+  cmark_parser_free(parser);
+  cmark_outline_free(outline);
+  return map;
+}
+
 void cmark_parser_feed(cmark_parser *parser, const char *buffer, size_t len) {
   S_parser_feed(parser, (const unsigned char *)buffer, len, false);
 }
@@ -529,6 +725,7 @@ static void S_parser_feed(cmark_parser *parser, const unsigned char *buffer,
                           size_t len, bool eof) {
   const unsigned char *end = buffer + len;
   static const uint8_t repl[] = {239, 191, 189};
+  STATS_ENTER(&parser->stats);
 
   if (parser->last_buffer_ended_with_cr && *buffer == '\n') {
     // skip NL if last buffer ended with CR ; see #117
@@ -589,6 +786,7 @@ static void S_parser_feed(cmark_parser *parser, const unsigned char *buffer,
       }
     }
   }
+  STATS_LEAVE();
 }
 
 static void chop_trailing_hashtags(cmark_chunk *ch) {
@@ -852,9 +1050,26 @@ done:
   return container;
 }
 
+// Number of block quotes and lists containing 'node', and 'node' itself.
+static int S_nesting_depth(cmark_node *node) {
+  int depth = 0;
+  for (; node != NULL; node = node->parent) {
+    if (S_type(node) == CMARK_NODE_BLOCK_QUOTE ||
+        S_type(node) == CMARK_NODE_LIST)
+      depth++;
+  }
+  return depth;
+}
+
+static CMARK_INLINE bool S_may_nest(cmark_parser *parser, int depth) {
+  return parser->budget.limits.max_nesting <= 0 ||
+         depth < parser->budget.limits.max_nesting;
+}
+
 static void open_new_blocks(cmark_parser *parser, cmark_node **container,
                             cmark_chunk *input, bool all_matched) {
   bool indented;
+  uint8_t starts;
   cmark_list *data = NULL;
   bool maybe_lazy = S_type(parser->current) == CMARK_NODE_PARAGRAPH;
   cmark_node_type cont_type = S_type(*container);
@@ -863,14 +1078,29 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
   bool save_partially_consumed_tab;
   int save_offset;
   int save_column;
+  int depth = parser->budget.limits.max_nesting > 0
+                  ? S_nesting_depth(*container)
+                  : 0;
 
   while (cont_type != CMARK_NODE_CODE_BLOCK &&
          cont_type != CMARK_NODE_HTML_BLOCK) {
 
     S_find_first_nonspace(parser, input);
     indented = parser->indent >= CODE_INDENT;
+    starts = BLOCK_STARTS[peek_at(input, parser->first_nonspace)];
+
+    if (cmark_budget_exhausted(&parser->budget)) {
+      // no more blocks, the line is text
+      break;
+    }
+
+    if (!indented && starts == 0) {
+      // no block can start here: the line continues or starts a paragraph
+      break;
+    }
 
-    if (!indented && peek_at(input, parser->first_nonspace) == '>') {
+    if (!indented && (starts & BLOCK_START_QUOTE) &&
+        S_may_nest(parser, depth)) {
 
       bufsize_t blockquote_startpos = parser->first_nonspace;
 
@@ -882,9 +1112,12 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
       }
       *container = add_child(parser, *container, CMARK_NODE_BLOCK_QUOTE,
                              blockquote_startpos + 1);
+      if (parser->budget.limits.max_nesting > 0)
+        depth = S_nesting_depth(*container);
 
-    } else if (!indented && (matched = scan_atx_heading_start(
-                                 input, parser->first_nonspace))) {
+    } else if (!indented && (starts & BLOCK_START_ATX) &&
+               (matched = scan_atx_heading_start(input,
+                                                 parser->first_nonspace))) {
       bufsize_t hashpos;
       int level = 0;
       bufsize_t heading_startpos = parser->first_nonspace;
@@ -905,8 +1138,9 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
       (*container)->as.heading.level = level;
       (*container)->as.heading.setext = false;
 
-    } else if (!indented && (matched = scan_open_code_fence(
-                                 input, parser->first_nonspace))) {
+    } else if (!indented && (starts & BLOCK_START_FENCE) &&
+               (matched = scan_open_code_fence(input,
+                                               parser->first_nonspace))) {
       *container = add_child(parser, *container, CMARK_NODE_CODE_BLOCK,
                              parser->first_nonspace + 1);
       (*container)->as.code.fenced = true;
@@ -919,31 +1153,35 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
                        parser->first_nonspace + matched - parser->offset,
                        false);
 
-    } else if (!indented && ((matched = scan_html_block_start(
-                                  input, parser->first_nonspace)) ||
-                             (cont_type != CMARK_NODE_PARAGRAPH &&
-                              (matched = scan_html_block_start_7(
-                                   input, parser->first_nonspace))))) {
+    } else if (!indented && (starts & BLOCK_START_HTML) &&
+               ((matched = scan_html_block_start(input,
+                                                 parser->first_nonspace)) ||
+                (cont_type != CMARK_NODE_PARAGRAPH &&
+                 (matched = scan_html_block_start_7(
+                      input, parser->first_nonspace))))) {
       *container = add_child(parser, *container, CMARK_NODE_HTML_BLOCK,
                              parser->first_nonspace + 1);
       (*container)->as.html_block_type = matched;
       // note, we don't adjust parser->offset because the tag is part of the
       // text
-    } else if (!indented && cont_type == CMARK_NODE_PARAGRAPH &&
+    } else if (!indented && (starts & BLOCK_START_SETEXT) &&
+               cont_type == CMARK_NODE_PARAGRAPH &&
                (lev =
                     scan_setext_heading_line(input, parser->first_nonspace))) {
       (*container)->type = (uint16_t)CMARK_NODE_HEADING;
       (*container)->as.heading.level = lev;
       (*container)->as.heading.setext = true;
       S_advance_offset(parser, input, input->len - 1 - parser->offset, false);
-    } else if (!indented &&
+    } else if (!indented && (starts & BLOCK_START_BREAK) &&
                !(cont_type == CMARK_NODE_PARAGRAPH && !all_matched) &&
                (matched = scan_thematic_break(input, parser->first_nonspace))) {
       // it's only now that we know the line is not part of a setext heading:
       *container = add_child(parser, *container, CMARK_NODE_THEMATIC_BREAK,
                              parser->first_nonspace + 1);
       S_advance_offset(parser, input, input->len - 1 - parser->offset, false);
-    } else if ((!indented || cont_type == CMARK_NODE_LIST) &&
+    } else if ((starts & BLOCK_START_LIST) &&
+               (!indented || cont_type == CMARK_NODE_LIST) &&
+               (cont_type == CMARK_NODE_LIST || S_may_nest(parser, depth)) &&
                (matched = parse_list_marker(
                     parser->mem, input, parser->first_nonspace,
                     (*container)->type == CMARK_NODE_PARAGRAPH, &data))) {
@@ -990,6 +1228,8 @@ static void open_new_blocks(cmark_parser *parser, cmark_node **container,
           !lists_match(&((*container)->as.list), data)) {
         *container = add_child(parser, *container, CMARK_NODE_LIST,
                                parser->first_nonspace + 1);
+        if (parser->budget.limits.max_nesting > 0)
+          depth = S_nesting_depth(*container);
 
         memcpy(&((*container)->as.list), data, sizeof(*data));
       }
@@ -1140,6 +1380,19 @@ static void add_text_to_container(cmark_parser *parser, cmark_node *container,
   }
 }
 
+// Take the entries of the closed top-level blocks for the outline, and
+// free them.  The last one is kept, as the next line may still mark it
+// as ending with a blank line.
+static void outline_closed_blocks(cmark_parser *parser) {
+  cmark_node *block;
+
+  while ((block = parser->root->first_child) != parser->root->last_child &&
+         !(block->flags & CMARK_NODE__OPEN)) {
+    cmark_outline_add_block(parser->outline, block);
+    cmark_node_free(block);
+  }
+}
+
 /* See http://spec.commonmark.org/0.24/#phase-1-block-structure */
 static void S_process_line(cmark_parser *parser, const unsigned char *buffer,
                            bufsize_t bytes) {
@@ -1147,6 +1400,7 @@ static void S_process_line(cmark_parser *parser, const unsigned char *buffer,
   bool all_matched = true;
   cmark_node *container;
   cmark_chunk input;
+  STATS_START(t_line);
 
   if (parser->options & CMARK_OPT_VALIDATE_UTF8)
     cmark_utf8proc_check(&parser->curline, buffer, bytes);
@@ -1166,6 +1420,8 @@ static void S_process_line(cmark_parser *parser, const unsigned char *buffer,
   input.len = parser->curline.size;
 
   parser->line_number++;
+  parser->budget.steps++;
+  STATS_ADD(lines, 1);
 
   last_matched_container = check_open_blocks(parser, &input, &all_matched);
 
@@ -1178,6 +1434,9 @@ static void S_process_line(cmark_parser *parser, const unsigned char *buffer,
 
   add_text_to_container(parser, container, last_matched_container, &input);
 
+  if (parser->outline != NULL)
+    outline_closed_blocks(parser);
+
 finished:
   parser->last_line_length = input.len;
   if (parser->last_line_length &&
@@ -1188,9 +1447,13 @@ finished:
     parser->last_line_length -= 1;
 
   cmark_strbuf_clear(&parser->curline);
+  STATS_STOP(block_ns, t_line);
 }
 
 cmark_node *cmark_parser_finish(cmark_parser *parser) {
+  cmark_node *document;
+  STATS_ENTER(&parser->stats);
+
   if (parser->linebuf.size) {
     S_process_line(parser, parser->linebuf.ptr, parser->linebuf.size);
     cmark_strbuf_clear(&parser->linebuf);
@@ -1198,16 +1461,29 @@ cmark_node *cmark_parser_finish(cmark_parser *parser) {
 
   finalize_document(parser);
 
-  if (parser->options & CMARK_OPT_NORMALIZE) {
+  // with lazy inlines, each block is normalized once its inlines are parsed
+  if ((parser->options & CMARK_OPT_NORMALIZE) &&
+      !(parser->options & CMARK_OPT_LAZY_INLINES)) {
+    STATS_START(t_consolidate);
     cmark_consolidate_text_nodes(parser->root);
+    STATS_STOP(consolidate_ns, t_consolidate);
   }
 
-  cmark_strbuf_free(&parser->curline);
-
 #if CMARK_DEBUG_NODES
   if (cmark_node_check(parser->root, stderr)) {
     abort();
   }
 #endif
-  return parser->root;
+  // the document belongs to the caller now, with its statistics unless
+  // its inlines are still to be parsed
+  document = parser->root;
+  if (!(parser->options & CMARK_OPT_LAZY_INLINES)) {
+    document->as.document.stats =
+        (cmark_doc_stats *)parser->mem->calloc(1, sizeof(cmark_doc_stats));
+    *document->as.document.stats = parser->doc_stats;
+  }
+  parser->root = NULL;
+  parser->current = NULL;
+  STATS_LEAVE();
+  return document;
 }
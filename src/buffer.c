@@ -57,6 +57,20 @@ void cmark_strbuf_grow(cmark_strbuf *buf, bufsize_t target_size) {
   buf->asize = new_size;
 }
 
+void cmark_strbuf_reserve(cmark_strbuf *buf, size_t size) {
+  bufsize_t new_size;
+
+  if (size == 0 || size > (size_t)(INT32_MAX / 2) ||
+      (bufsize_t)size < buf->asize)
+    return;
+
+  new_size = ((bufsize_t)size + 1 + 7) & ~7;
+  buf->ptr = (unsigned char *)buf->mem->realloc(buf->asize ? buf->ptr : NULL,
+                                                new_size);
+  buf->asize = new_size;
+  buf->ptr[buf->size] = '\0';
+}
+
 bufsize_t cmark_strbuf_len(const cmark_strbuf *buf) { return buf->size; }
 
 void cmark_strbuf_free(cmark_strbuf *buf) {
@@ -46,6 +46,12 @@ void cmark_strbuf_init(cmark_mem *mem, cmark_strbuf *buf,
  */
 void cmark_strbuf_grow(cmark_strbuf *buf, bufsize_t target_size);
 
+/**
+ * Allocate room for `size` bytes up front, without the oversizing of
+ * `cmark_strbuf_grow`.  A size the buffer cannot hold is ignored.
+ */
+void cmark_strbuf_reserve(cmark_strbuf *buf, size_t size);
+
 void cmark_strbuf_free(cmark_strbuf *buf);
 void cmark_strbuf_swap(cmark_strbuf *buf_a, cmark_strbuf *buf_b);
 
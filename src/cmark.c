@@ -5,6 +5,7 @@
 #include "houdini.h"
 #include "cmark.h"
 #include "buffer.h"
+#include "stats.h"
 
 int cmark_version() { return CMARK_VERSION; }
 
@@ -14,6 +15,8 @@ static void *xcalloc(size_t nmem, size_t size) {
   void *ptr = calloc(nmem, size);
   if (!ptr)
     abort();
+  STATS_ADD(allocs, 1);
+  STATS_ADD(alloc_bytes, nmem * size);
   return ptr;
 }
 
@@ -21,6 +24,8 @@ static void *xrealloc(void *ptr, size_t size) {
   void *new_ptr = realloc(ptr, size);
   if (!new_ptr)
     abort();
+  STATS_ADD(reallocs, 1);
+  STATS_ADD(realloc_bytes, size);
   return new_ptr;
 }
 
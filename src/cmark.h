@@ -250,6 +250,92 @@ CMARK_EXPORT
 void cmark_iter_reset(cmark_iter *iter, cmark_node *current,
                       cmark_event_type event_type);
 
+/**
+ * ## Flat Trees
+ *
+ * A flat tree is a copy of a tree as an array of the events an
+ * iterator returns for it, followed by a pool with the strings of the
+ * nodes.  It is a single block of memory without pointers: it is
+ * walked with a plain loop, without allocations, and it can be copied,
+ * stored, or shared between threads and processes as a block of
+ * `cmark_flat_size()` bytes.  A copy with the alignment of a `double`
+ * can be used where the original is, except with `cmark_flat_free`.
+ *
+ *     cmark_flat *flat = cmark_flatten(root);
+ *     const cmark_flat_event *ev = cmark_flat_events(flat);
+ *     size_t i, n = cmark_flat_count(flat);
+ *
+ *     for (i = 0; i < n; i++) {
+ *         if (ev[i].type == CMARK_NODE_TEXT)
+ *             puts(cmark_flat_string(flat, ev[i].literal));
+ *     }
+ *     cmark_flat_free(flat);
+ */
+
+typedef struct cmark_flat cmark_flat;
+
+/** An event of a flat tree.  The ENTER and EXIT events of a node carry
+ * the same fields but 'event' and 'match'.  Strings are given as
+ * offsets into the string pool (see `cmark_flat_string`) and lengths.
+ */
+typedef struct cmark_flat_event {
+  unsigned char type;        /* cmark_node_type */
+  unsigned char event;       /* CMARK_EVENT_ENTER or CMARK_EVENT_EXIT */
+  unsigned short flags;      /* CMARK_FLAT_*, bullet char in bits 8-15 */
+  int depth;                 /* 0 for the root */
+  int number;                /* heading level or list start */
+  unsigned int match;        /* the node's other event, itself for leaves */
+  unsigned int literal;      /* literal, URL or on_enter */
+  unsigned int literal_len;
+  unsigned int info;         /* fence info, title or on_exit */
+  unsigned int info_len;
+  int start_line;
+  int start_column;
+  int end_line;
+  int end_column;
+} cmark_flat_event;
+
+/** An ordered list. */
+#define CMARK_FLAT_ORDERED (1 << 0)
+/** An ordered list delimited by parentheses. */
+#define CMARK_FLAT_PAREN (1 << 1)
+/** A tight list, or a paragraph in an item of a tight list. */
+#define CMARK_FLAT_TIGHT (1 << 2)
+/** A fenced code block. */
+#define CMARK_FLAT_FENCED (1 << 3)
+
+/** Returns a flat copy of the tree under 'root', to be freed with
+ * `cmark_flat_free`.
+ */
+CMARK_EXPORT
+cmark_flat *cmark_flatten(cmark_node *root);
+
+/** Frees a flat tree returned by `cmark_flatten`.
+ */
+CMARK_EXPORT
+void cmark_flat_free(cmark_flat *flat);
+
+/** Returns the size in bytes of the block holding 'flat'.
+ */
+CMARK_EXPORT
+size_t cmark_flat_size(const cmark_flat *flat);
+
+/** Returns the number of events of 'flat'.
+ */
+CMARK_EXPORT
+size_t cmark_flat_count(const cmark_flat *flat);
+
+/** Returns the events of 'flat'.
+ */
+CMARK_EXPORT
+const cmark_flat_event *cmark_flat_events(const cmark_flat *flat);
+
+/** Returns the NUL-terminated string at 'offset' in the string pool of
+ * 'flat'.
+ */
+CMARK_EXPORT
+const char *cmark_flat_string(const cmark_flat *flat, unsigned int offset);
+
 /**
  * ## Accessors
  */
@@ -476,6 +562,15 @@ cmark_parser *cmark_parser_new_with_mem(int options, cmark_mem *mem);
 CMARK_EXPORT
 void cmark_parser_free(cmark_parser *parser);
 
+/** Prepares 'parser' for a new document with the given options, as if
+ * it had just been created, but keeps the buffers and the limits it
+ * has allocated and set, and its shared reference map.  The reference
+ * definitions of the previous document are dropped, as is the document
+ * itself if `cmark_parser_finish` was not called.
+ */
+CMARK_EXPORT
+void cmark_parser_reset(cmark_parser *parser, int options);
+
 /** Feeds a string of length 'len' to 'parser'.
  */
 CMARK_EXPORT
@@ -486,6 +581,80 @@ void cmark_parser_feed(cmark_parser *parser, const char *buffer, size_t len);
 CMARK_EXPORT
 cmark_node *cmark_parser_finish(cmark_parser *parser);
 
+/** Statistics collected by a parser, if the library was built with
+ * `CMARK_STATS` (`cmake -DCMARK_STATS=ON`): the time spent in each
+ * phase, in nanoseconds, and some counters.
+ *
+ * * `block_ns`: block parsing, line by line (including the blocks
+ *   closed by a line, and their reference definitions).
+ * * `finalize_ns`: closing the blocks still open at the end.
+ * * `inline_ns`: inline parsing.
+ * * `consolidate_ns`: consolidating text nodes (`CMARK_OPT_NORMALIZE`).
+ * * `nodes`: nodes created, by type.
+ * * `allocs`, `alloc_bytes`, `reallocs`, `realloc_bytes`: calls to the
+ *   default allocator, and the bytes requested.
+ * * `ref_lookups`, `ref_hits`: reference map lookups, and successful
+ *   ones.
+ * * `delim_peak`: maximal depth of the emphasis delimiter stack.
+ */
+typedef struct cmark_stats {
+  double block_ns;
+  double finalize_ns;
+  double inline_ns;
+  double consolidate_ns;
+  size_t lines;
+  size_t nodes[CMARK_NODE_LAST_INLINE + 1];
+  size_t allocs;
+  size_t alloc_bytes;
+  size_t reallocs;
+  size_t realloc_bytes;
+  size_t ref_lookups;
+  size_t ref_hits;
+  size_t delim_peak;
+} cmark_stats;
+
+/** Copies the statistics collected by 'parser' so far into 'stats'.
+ * Returns 1 on success, 0 if the library was built without
+ * `CMARK_STATS` (and 'stats' is zeroed).
+ */
+CMARK_EXPORT
+int cmark_parser_get_stats(cmark_parser *parser, cmark_stats *stats);
+
+/** Limits on the resources a parser may use for one document, for
+ * untrusted input.  A limit of 0 means no limit.
+ *
+ * * `max_nesting`: depth of nested block quotes and lists.  A block
+ *   quote or list marker beyond it is kept as literal text.
+ * * `max_nodes`: nodes in the document (approximately).
+ * * `max_steps`: units of parsing work (a line, an inline element,
+ *   a delimiter examined in emphasis matching).
+ * * `max_delimiters`: emphasis delimiters in a paragraph awaiting
+ *   a match; further ones are kept as literal text.
+ * * `max_references`: reference link definitions; further ones are
+ *   kept as paragraph text.
+ * * `max_output`: bytes of output rendered from the document.  The
+ *   renderers leave out the nodes starting beyond it (the enclosing
+ *   nodes are closed properly), so the output may exceed it by one
+ *   node.
+ *
+ * Once `max_nodes` or `max_steps` is reached no more blocks are
+ * started, and the rest of each block is kept as literal text.
+ */
+typedef struct cmark_limits {
+  int max_nesting;
+  size_t max_nodes;
+  size_t max_steps;
+  size_t max_delimiters;
+  size_t max_references;
+  size_t max_output;
+} cmark_limits;
+
+/** Sets the limits of 'parser' (see `cmark_limits`); call it before
+ * the first `cmark_parser_feed`.
+ */
+CMARK_EXPORT
+void cmark_parser_set_limits(cmark_parser *parser, const cmark_limits *limits);
+
 /** Parse a CommonMark document in 'buffer' of length 'len'.
  * Returns a pointer to a tree of nodes.  The memory allocated for
  * the node tree should be released using 'cmark_node_free'
@@ -501,6 +670,133 @@ cmark_node *cmark_parse_document(const char *buffer, size_t len, cmark_option_t
 CMARK_EXPORT
 cmark_node *cmark_parse_file(FILE *f, cmark_option_t options);
 
+/**
+ * ## Outlines
+ *
+ * An outline lists the headings, the fenced code blocks and the link
+ * reference definitions of a document, for indexing and tables of
+ * contents.  It is made by the block parser alone: inlines are not
+ * parsed, and each top-level block is dropped once it is closed and
+ * its entries are taken, so the tree is never built as a whole.
+ *
+ *     cmark_outline *outline = cmark_parse_outline(text, len, 0);
+ *     const cmark_outline_entry *e = cmark_outline_entries(outline);
+ *     size_t i, n = cmark_outline_count(outline);
+ *
+ *     for (i = 0; i < n; i++) {
+ *         if (e[i].type == CMARK_OUTLINE_HEADING)
+ *             printf("%d %s\n", e[i].level,
+ *                    cmark_outline_string(outline, e[i].text));
+ *     }
+ *     cmark_outline_free(outline);
+ */
+
+typedef struct cmark_outline cmark_outline;
+
+typedef enum {
+  CMARK_OUTLINE_HEADING = 1,
+  CMARK_OUTLINE_CODE,
+  CMARK_OUTLINE_REFERENCE
+} cmark_outline_type;
+
+/** An entry of an outline.  Strings are given as offsets into the
+ * string pool (see `cmark_outline_string`) and lengths.  Headings and
+ * code blocks come in document order, followed by the reference
+ * definitions in the order they were defined.
+ */
+typedef struct cmark_outline_entry {
+  int type;                 /* cmark_outline_type */
+  int level;                /* heading level, 0 for the others */
+  unsigned int text;        /* heading source, info string or label */
+  unsigned int text_len;
+  unsigned int url;         /* reference URL, empty for the others */
+  unsigned int url_len;
+  int start_line;           /* positions are 0 for references */
+  int start_column;
+  int end_line;
+  int end_column;
+} cmark_outline_entry;
+
+/** Returns the outline of the CommonMark document in 'buffer' of
+ * length 'len', to be freed with `cmark_outline_free`.  Heading text is
+ * the source of the heading's inlines, with leading and trailing
+ * whitespace removed; reference labels are normalized, as for lookup.
+ */
+CMARK_EXPORT
+cmark_outline *cmark_parse_outline(const char *buffer, size_t len,
+                                   cmark_option_t options);
+
+/** Frees an outline returned by `cmark_parse_outline`.
+ */
+CMARK_EXPORT
+void cmark_outline_free(cmark_outline *outline);
+
+/** Returns the number of entries of 'outline'.
+ */
+CMARK_EXPORT
+size_t cmark_outline_count(const cmark_outline *outline);
+
+/** Returns the entries of 'outline'.
+ */
+CMARK_EXPORT
+const cmark_outline_entry *cmark_outline_entries(const cmark_outline *outline);
+
+/** Returns the NUL-terminated string at 'offset' in the string pool of
+ * 'outline'.
+ */
+CMARK_EXPORT
+const char *cmark_outline_string(const cmark_outline *outline,
+                                 unsigned int offset);
+
+/**
+ * ## Shared reference maps
+ *
+ * Link reference definitions common to many documents, like a site-wide
+ * glossary, can be parsed once into a reference map that is attached
+ * to any number of parsers, on any number of threads.  It is never
+ * changed after it is made, and is looked up after the definitions of
+ * the document itself, which take precedence.
+ *
+ *     cmark_reference_map *glossary =
+ *         cmark_parse_references(text, len, CMARK_OPT_DEFAULT);
+ *
+ *     cmark_parser_set_shared_references(parser, glossary);
+ *     ... parse any number of documents ...
+ *     cmark_parser_free(parser);
+ *     cmark_reference_map_free(glossary);
+ */
+
+typedef struct cmark_reference_map cmark_reference_map;
+
+/** Returns the link reference definitions of the CommonMark document in
+ * 'buffer' of length 'len', to be freed with `cmark_reference_map_free`.
+ * Only the block structure is parsed, as for `cmark_parse_outline`; the
+ * rest of the document is dropped.
+ */
+CMARK_EXPORT
+cmark_reference_map *cmark_parse_references(const char *buffer, size_t len,
+                                            cmark_option_t options);
+
+/** Frees a reference map returned by `cmark_parse_references`, after
+ * the parsers it is attached to, and the documents they parsed with
+ * `CMARK_OPT_LAZY_INLINES`, are freed.
+ */
+CMARK_EXPORT
+void cmark_reference_map_free(cmark_reference_map *map);
+
+/** Returns the number of reference definitions in 'map'.
+ */
+CMARK_EXPORT
+size_t cmark_reference_map_count(const cmark_reference_map *map);
+
+/** Makes 'parser' look up the link references that a document does not
+ * define itself in 'map' (NULL to detach it).  The map stays attached
+ * across `cmark_parser_reset`.
+ */
+CMARK_EXPORT
+void cmark_parser_set_shared_references(cmark_parser *parser,
+                                        const cmark_reference_map *map);
+
 /**
  * ## Rendering
  */
@@ -518,6 +814,23 @@ char *cmark_render_xml(cmark_node *root, cmark_option_t options);
 CMARK_EXPORT
 char *cmark_render_html(cmark_node *root, cmark_option_t options);
 
+/** Returns an estimate of the length of `cmark_render_html(root,
+ * options)`, for callers that manage their own output buffers.  It is
+ * computed from counts the parser keeps for each document, or for a
+ * tree that was not parsed or is not a document, from a walk over
+ * 'root'.  A parsed document changed afterwards keeps its counts, so
+ * the estimate is a hint and not a bound.
+ */
+CMARK_EXPORT
+size_t cmark_render_html_size_hint(cmark_node *root, cmark_option_t options);
+
+/** Render a flat tree as an HTML fragment, the same as
+ * `cmark_render_html` renders the tree it was made from.  It is the
+ * caller's responsibility to free the returned buffer.
+ */
+CMARK_EXPORT
+char *cmark_render_html_flat(const cmark_flat *flat, cmark_option_t options);
+
 /** Render a 'node' tree as an XHTML fragment.  It is up to the user
  * to add an appropriate header and footer.
  */
@@ -591,6 +904,16 @@ char *cmark_render_latex(cmark_node *root, cmark_option_t options, int width);
  */
 #define CMARK_OPT_SMART (1 << 10)
 
+/** Parse the inlines of a paragraph or heading only when its children
+ * are first accessed, with `cmark_node_first_child`,
+ * `cmark_node_last_child`, an iterator or a renderer, so that looking
+ * only at the block structure skips most of the parsing.  Reference
+ * definitions are kept with the document for this.  As accessing the
+ * children may then change the tree, a document parsed this way must
+ * not be read from several threads at once.
+ */
+#define CMARK_OPT_LAZY_INLINES (1 << 11)
+
 /** Generate ISO HTML, eg suppress the `start` attribute in `<ol>`.
  * (Added <mh@tin-pot.net> 2015-10-18.)
  */
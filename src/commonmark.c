@@ -466,11 +466,16 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
   return 1;
 }
 
+// The bytes of markup around each type of node, for the size estimate.
+static const unsigned char COMMONMARK_OVERHEAD[CMARK_NODE_LAST_INLINE + 1] = {
+    0, 0, 4, 1, 4, 9, 2, 2, 2, 4, 6, 0, 1, 3, 2, 0, 0, 2, 4, 4, 5};
+
 char *cmark_render_commonmark(cmark_node *root, int options, int width) {
   if (options & CMARK_OPT_HARDBREAKS) {
     // disable breaking on width, since it has
     // a different meaning with OPT_HARDBREAKS
     width = 0;
   }
-  return cmark_render(root, options, width, outc, S_render_node);
+  return cmark_render(root, options, width, outc, S_render_node,
+                      cmark_node_estimate_size(root, COMMONMARK_OVERHEAD, 1));
 }
@@ -0,0 +1,123 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "node.h"
+#include "cmark.h"
+#include "flat.h"
+
+static const int S_leaf_mask =
+    (1 << CMARK_NODE_HTML_BLOCK) | (1 << CMARK_NODE_THEMATIC_BREAK) |
+    (1 << CMARK_NODE_CODE_BLOCK) | (1 << CMARK_NODE_TEXT) |
+    (1 << CMARK_NODE_SOFTBREAK) | (1 << CMARK_NODE_LINEBREAK) |
+    (1 << CMARK_NODE_CODE) | (1 << CMARK_NODE_HTML_INLINE);
+
+static unsigned int S_put_string(char *pool, size_t *used, cmark_chunk *c,
+                                 unsigned int *len) {
+  size_t offset = *used;
+
+  if (c == NULL || c->len <= 0) {
+    *len = 0;
+    return 0;
+  }
+  memcpy(pool + offset, c->data, c->len);
+  pool[offset + c->len] = '\0';
+  *used += c->len + 1;
+  *len = (unsigned int)c->len;
+  return (unsigned int)offset;
+}
+
+cmark_flat *cmark_flatten(cmark_node *root) {
+  cmark_mem *mem;
+  cmark_iter *iter;
+  cmark_event_type ev_type;
+  cmark_node *cur;
+  cmark_chunk *literal, *info;
+  cmark_flat *flat;
+  cmark_flat_event *events, *ev;
+  char *pool;
+  size_t nevents = 0, pool_size = 1, used = 1, depth = 0, max_depth = 0;
+  size_t i, size, *open;
+
+  if (root == NULL)
+    return NULL;
+  mem = cmark_node_mem(root);
+
+  // Count the events, the bytes of the strings and the depth.
+  iter = cmark_iter_new(root);
+  while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+    cur = cmark_iter_get_node(iter);
+    nevents++;
+    if (ev_type == CMARK_EVENT_EXIT) {
+      depth--;
+      continue;
+    }
+    if (((1 << cur->type) & S_leaf_mask) == 0 && ++depth > max_depth)
+      max_depth = depth;
+    cmark_flat_node_strings(cur, &literal, &info);
+    if (literal != NULL && literal->len > 0)
+      pool_size += literal->len + 1;
+    if (info != NULL && info->len > 0)
+      pool_size += info->len + 1;
+  }
+
+  size = sizeof(cmark_flat) + nevents * sizeof(cmark_flat_event) + pool_size;
+  flat = (cmark_flat *)mem->calloc(1, size);
+  flat->mem = mem;
+  flat->size = size;
+  flat->nevents = nevents;
+  flat->max_output = cmark_node_output_limit(root);
+  flat->pool = size - pool_size;
+  events = (cmark_flat_event *)CMARK_FLAT_EVENTS(flat);
+  pool = (char *)flat + flat->pool;
+
+  // The indices of the ENTER events of the open containers.
+  open = (size_t *)mem->calloc(max_depth + 1, sizeof(size_t));
+
+  depth = 0;
+  cmark_iter_free(iter);
+  iter = cmark_iter_new(root);
+  for (i = 0; (ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE; i++) {
+    cur = cmark_iter_get_node(iter);
+    ev = &events[i];
+    if (ev_type == CMARK_EVENT_EXIT) {
+      assert(depth > 0);
+      depth--;
+      *ev = events[open[depth]];
+      ev->event = CMARK_EVENT_EXIT;
+      ev->match = (unsigned int)open[depth];
+      events[open[depth]].match = (unsigned int)i;
+      continue;
+    }
+    cmark_flat_event_init(ev, cur, CMARK_EVENT_ENTER, &literal, &info);
+    ev->depth = (int)depth;
+    ev->match = (unsigned int)i;
+    ev->literal = S_put_string(pool, &used, literal, &ev->literal_len);
+    ev->info = S_put_string(pool, &used, info, &ev->info_len);
+    if (((1 << cur->type) & S_leaf_mask) == 0)
+      open[depth++] = i;
+  }
+  assert(depth == 0 && used == pool_size);
+
+  mem->free(open);
+  cmark_iter_free(iter);
+  return flat;
+}
+
+void cmark_flat_free(cmark_flat *flat) {
+  if (flat != NULL)
+    flat->mem->free(flat);
+}
+
+size_t cmark_flat_size(const cmark_flat *flat) { return flat->size; }
+
+size_t cmark_flat_count(const cmark_flat *flat) { return flat->nevents; }
+
+const cmark_flat_event *cmark_flat_events(const cmark_flat *flat) {
+  return CMARK_FLAT_EVENTS(flat);
+}
+
+const char *cmark_flat_string(const cmark_flat *flat, unsigned int offset) {
+  return CMARK_FLAT_POOL(flat) + offset;
+}
@@ -0,0 +1,123 @@
+#ifndef CMARK_FLAT_H
+#define CMARK_FLAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "cmark.h"
+#include "chunk.h"
+#include "memory.h"
+#include "node.h"
+
+// A flat tree is a single block: this header, the events, and the
+// string pool.  Strings are NUL-terminated, and the empty string is at
+// offset 0 of the pool.
+struct cmark_flat {
+  cmark_mem *mem;
+  size_t size;
+  size_t nevents;
+  size_t max_output;
+  size_t pool;
+};
+
+// The strings of a node, as stored in the two string fields of its
+// events.
+static CMARK_INLINE void cmark_flat_node_strings(cmark_node *node,
+                                                 cmark_chunk **literal,
+                                                 cmark_chunk **info) {
+  *literal = NULL;
+  *info = NULL;
+  switch (node->type) {
+  case CMARK_NODE_TEXT:
+  case CMARK_NODE_CODE:
+  case CMARK_NODE_HTML_BLOCK:
+  case CMARK_NODE_HTML_INLINE:
+    *literal = &node->as.literal;
+    break;
+  case CMARK_NODE_CODE_BLOCK:
+    *literal = &node->as.code.literal;
+    *info = &node->as.code.info;
+    break;
+  case CMARK_NODE_LINK:
+  case CMARK_NODE_IMAGE:
+    *literal = &node->as.link.url;
+    *info = &node->as.link.title;
+    break;
+  case CMARK_NODE_CUSTOM_BLOCK:
+  case CMARK_NODE_CUSTOM_INLINE:
+    *literal = &node->as.custom.on_enter;
+    *info = &node->as.custom.on_exit;
+    break;
+  default:
+    break;
+  }
+}
+
+// The CMARK_FLAT_* flags of a node.
+static CMARK_INLINE unsigned short cmark_flat_node_flags(cmark_node *node) {
+  cmark_node *grandparent;
+  unsigned short flags = 0;
+
+  switch (node->type) {
+  case CMARK_NODE_LIST:
+    if (node->as.list.list_type == CMARK_ORDERED_LIST)
+      flags |= CMARK_FLAT_ORDERED;
+    if (node->as.list.delimiter == CMARK_PAREN_DELIM)
+      flags |= CMARK_FLAT_PAREN;
+    if (node->as.list.tight)
+      flags |= CMARK_FLAT_TIGHT;
+    flags |= (unsigned short)(node->as.list.bullet_char << 8);
+    break;
+  case CMARK_NODE_PARAGRAPH:
+    grandparent = node->parent ? node->parent->parent : NULL;
+    if (grandparent != NULL && grandparent->type == CMARK_NODE_LIST &&
+        grandparent->as.list.tight)
+      flags |= CMARK_FLAT_TIGHT;
+    break;
+  case CMARK_NODE_CODE_BLOCK:
+    if (node->as.code.fenced)
+      flags |= CMARK_FLAT_FENCED;
+    break;
+  default:
+    break;
+  }
+  return flags;
+}
+
+// Fill 'ev' with the event 'ev_type' of 'node', as cmark_flatten does
+// except for the depth, the match and the string offsets, and point
+// 'literal' and 'info' to the node's strings (or NULL).
+static CMARK_INLINE void
+cmark_flat_event_init(cmark_flat_event *ev, cmark_node *node,
+                      cmark_event_type ev_type, cmark_chunk **literal,
+                      cmark_chunk **info) {
+  memset(ev, 0, sizeof(*ev));
+  ev->type = (unsigned char)node->type;
+  ev->event = (unsigned char)ev_type;
+  ev->flags = cmark_flat_node_flags(node);
+  if (node->type == CMARK_NODE_HEADING)
+    ev->number = node->as.heading.level;
+  else if (node->type == CMARK_NODE_LIST)
+    ev->number = node->as.list.start;
+  ev->start_line = node->start_line;
+  ev->start_column = node->start_column;
+  ev->end_line = node->end_line;
+  ev->end_column = node->end_column;
+  cmark_flat_node_strings(node, literal, info);
+  if (*literal != NULL && (*literal)->len > 0)
+    ev->literal_len = (unsigned int)(*literal)->len;
+  if (*info != NULL && (*info)->len > 0)
+    ev->info_len = (unsigned int)(*info)->len;
+}
+
+#define CMARK_FLAT_EVENTS(flat) ((const cmark_flat_event *)((flat) + 1))
+#define CMARK_FLAT_POOL(flat) ((const char *)(flat) + (flat)->pool)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -9,6 +9,7 @@
 #include "buffer.h"
 #include "houdini.h"
 #include "scanners.h"
+#include "flat.h"
 
 #if defined(_MSC_VER) && _MSC_VER <= 1500 /* MSVC 9.0 */
 #define snprintf _snprintf
@@ -33,53 +34,52 @@ struct render_state {
   cmark_node *plain;
 };
 
-static void S_render_sourcepos(cmark_node *node, cmark_strbuf *html,
+static void S_render_sourcepos(const cmark_flat_event *ev, cmark_strbuf *html,
                                int options) {
   char buffer[BUFFER_SIZE];
   if (CMARK_OPT_SOURCEPOS & options) {
     snprintf(buffer, BUFFER_SIZE, " data-sourcepos=\"%d:%d-%d:%d\"",
-             cmark_node_get_start_line(node), cmark_node_get_start_column(node),
-             cmark_node_get_end_line(node), cmark_node_get_end_column(node));
+             ev->start_line, ev->start_column, ev->end_line, ev->end_column);
     cmark_strbuf_puts(html, buffer);
   }
 }
 
-static int S_render_node(cmark_node *node, cmark_event_type ev_type,
-                         struct render_state *state, int options) {
-  cmark_node *parent;
-  cmark_node *grandparent;
-  cmark_strbuf *html = state->html;
-  char start_heading[] = "<h0";
-  char end_heading[] = "</h0";
-  bool tight;
-  char buffer[BUFFER_SIZE];
+// Render an event inside the alt text of an image, as plain text.
+static void S_render_plain(const cmark_flat_event *ev,
+                           const unsigned char *literal, cmark_strbuf *html) {
+  switch (ev->type) {
+  case CMARK_NODE_TEXT:
+  case CMARK_NODE_CODE:
+  case CMARK_NODE_HTML_INLINE:
+    escape_html(html, literal, (bufsize_t)ev->literal_len);
+    break;
 
-  bool entering = (ev_type == CMARK_EVENT_ENTER);
+  case CMARK_NODE_LINEBREAK:
+  case CMARK_NODE_SOFTBREAK:
+    cmark_strbuf_putc(html, ' ');
+    break;
 
-  if (state->plain == node) { // back at original node
-    state->plain = NULL;
+  default:
+    break;
   }
+}
 
-  if (state->plain != NULL) {
-    switch (node->type) {
-    case CMARK_NODE_TEXT:
-    case CMARK_NODE_CODE:
-    case CMARK_NODE_HTML_INLINE:
-      escape_html(html, node->as.literal.data, node->as.literal.len);
-      break;
-
-    case CMARK_NODE_LINEBREAK:
-    case CMARK_NODE_SOFTBREAK:
-      cmark_strbuf_putc(html, ' ');
-      break;
+// Render an event, of a node or of a flat tree, with the node's strings
+// 'literal' and 'info' (see cmark_flat_event).
+static void S_render_event(const cmark_flat_event *ev,
+                           const unsigned char *literal,
+                           const unsigned char *info, cmark_strbuf *html,
+                           int options) {
+  bufsize_t literal_len = (bufsize_t)ev->literal_len;
+  bufsize_t info_len = (bufsize_t)ev->info_len;
+  cmark_chunk url;
+  char start_heading[] = "<h0";
+  char end_heading[] = "</h0";
+  char buffer[BUFFER_SIZE];
 
-    default:
-      break;
-    }
-    return 1;
-  }
+  bool entering = (ev->event == CMARK_EVENT_ENTER);
 
-  switch (node->type) {
+  switch (ev->type) {
   case CMARK_NODE_DOCUMENT:
     break;
 
@@ -87,7 +87,7 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     if (entering) {
       cr(html);
       cmark_strbuf_puts(html, "<blockquote");
-      S_render_sourcepos(node, html, options);
+      S_render_sourcepos(ev, html, options);
       cmark_strbuf_puts(html, ">\n");
     } else {
       cr(html);
@@ -95,38 +95,30 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     }
     break;
 
-  case CMARK_NODE_LIST: {
-    cmark_list_type list_type = node->as.list.list_type;
-    int start = node->as.list.start;
-
+  case CMARK_NODE_LIST:
     if (entering) {
       cr(html);
-      if (list_type == CMARK_BULLET_LIST) {
+      if (!(ev->flags & CMARK_FLAT_ORDERED)) {
         cmark_strbuf_puts(html, "<ul");
-        S_render_sourcepos(node, html, options);
-        cmark_strbuf_puts(html, ">\n");
-      } else if (start == 1) {
+      } else if (ev->number == 1) {
         cmark_strbuf_puts(html, "<ol");
-        S_render_sourcepos(node, html, options);
-        cmark_strbuf_puts(html, ">\n");
       } else {
-        snprintf(buffer, BUFFER_SIZE, "<ol start=\"%d\"", start);
+        snprintf(buffer, BUFFER_SIZE, "<ol start=\"%d\"", ev->number);
         cmark_strbuf_puts(html, buffer);
-        S_render_sourcepos(node, html, options);
-        cmark_strbuf_puts(html, ">\n");
       }
+      S_render_sourcepos(ev, html, options);
+      cmark_strbuf_puts(html, ">\n");
     } else {
-      cmark_strbuf_puts(html,
-                        list_type == CMARK_BULLET_LIST ? "</ul>\n" : "</ol>\n");
+      cmark_strbuf_puts(html, (ev->flags & CMARK_FLAT_ORDERED) ? "</ol>\n"
+                                                               : "</ul>\n");
     }
     break;
-  }
 
   case CMARK_NODE_ITEM:
     if (entering) {
       cr(html);
       cmark_strbuf_puts(html, "<li");
-      S_render_sourcepos(node, html, options);
+      S_render_sourcepos(ev, html, options);
       cmark_strbuf_putc(html, '>');
     } else {
       cmark_strbuf_puts(html, "</li>\n");
@@ -136,12 +128,12 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
   case CMARK_NODE_HEADING:
     if (entering) {
       cr(html);
-      start_heading[2] = (char)('0' + node->as.heading.level);
+      start_heading[2] = (char)('0' + ev->number);
       cmark_strbuf_puts(html, start_heading);
-      S_render_sourcepos(node, html, options);
+      S_render_sourcepos(ev, html, options);
       cmark_strbuf_putc(html, '>');
     } else {
-      end_heading[3] = (char)('0' + node->as.heading.level);
+      end_heading[3] = (char)('0' + ev->number);
       cmark_strbuf_puts(html, end_heading);
       cmark_strbuf_puts(html, ">\n");
     }
@@ -149,26 +141,20 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
 
   case CMARK_NODE_CODE_BLOCK:
     cr(html);
-
-    if (node->as.code.info.len == 0) {
-      cmark_strbuf_puts(html, "<pre");
-      S_render_sourcepos(node, html, options);
+    cmark_strbuf_puts(html, "<pre");
+    S_render_sourcepos(ev, html, options);
+    if (info_len == 0) {
       cmark_strbuf_puts(html, "><code>");
     } else {
       bufsize_t first_tag = 0;
-      while (first_tag < node->as.code.info.len &&
-             !cmark_isspace(node->as.code.info.data[first_tag])) {
+      while (first_tag < info_len && !cmark_isspace(info[first_tag])) {
         first_tag += 1;
       }
-
-      cmark_strbuf_puts(html, "<pre");
-      S_render_sourcepos(node, html, options);
       cmark_strbuf_puts(html, "><code class=\"language-");
-      escape_html(html, node->as.code.info.data, first_tag);
+      escape_html(html, info, first_tag);
       cmark_strbuf_puts(html, "\">");
     }
-
-    escape_html(html, node->as.code.literal.data, node->as.code.literal.len);
+    escape_html(html, literal, literal_len);
     cmark_strbuf_puts(html, "</code></pre>\n");
     break;
 
@@ -177,7 +163,7 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     if (options & CMARK_OPT_SAFE) {
       cmark_strbuf_puts(html, "<!-- raw HTML omitted -->");
     } else {
-      cmark_strbuf_put(html, node->as.literal.data, node->as.literal.len);
+      cmark_strbuf_put(html, literal, literal_len);
     }
     cr(html);
     break;
@@ -185,11 +171,9 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
   case CMARK_NODE_CUSTOM_BLOCK:
     cr(html);
     if (entering) {
-      cmark_strbuf_put(html, node->as.custom.on_enter.data,
-                       node->as.custom.on_enter.len);
+      cmark_strbuf_put(html, literal, literal_len);
     } else {
-      cmark_strbuf_put(html, node->as.custom.on_exit.data,
-                       node->as.custom.on_exit.len);
+      cmark_strbuf_put(html, info, info_len);
     }
     cr(html);
     break;
@@ -197,23 +181,16 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
   case CMARK_NODE_THEMATIC_BREAK:
     cr(html);
     cmark_strbuf_puts(html, "<hr");
-    S_render_sourcepos(node, html, options);
+    S_render_sourcepos(ev, html, options);
     cmark_strbuf_puts(html, " />\n");
     break;
 
   case CMARK_NODE_PARAGRAPH:
-    parent = cmark_node_parent(node);
-    grandparent = cmark_node_parent(parent);
-    if (grandparent != NULL && grandparent->type == CMARK_NODE_LIST) {
-      tight = grandparent->as.list.tight;
-    } else {
-      tight = false;
-    }
-    if (!tight) {
+    if (!(ev->flags & CMARK_FLAT_TIGHT)) {
       if (entering) {
         cr(html);
         cmark_strbuf_puts(html, "<p");
-        S_render_sourcepos(node, html, options);
+        S_render_sourcepos(ev, html, options);
         cmark_strbuf_putc(html, '>');
       } else {
         cmark_strbuf_puts(html, "</p>\n");
@@ -222,7 +199,7 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     break;
 
   case CMARK_NODE_TEXT:
-    escape_html(html, node->as.literal.data, node->as.literal.len);
+    escape_html(html, literal, literal_len);
     break;
 
   case CMARK_NODE_LINEBREAK:
@@ -241,7 +218,7 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
 
   case CMARK_NODE_CODE:
     cmark_strbuf_puts(html, "<code>");
-    escape_html(html, node->as.literal.data, node->as.literal.len);
+    escape_html(html, literal, literal_len);
     cmark_strbuf_puts(html, "</code>");
     break;
 
@@ -249,71 +226,51 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     if (options & CMARK_OPT_SAFE) {
       cmark_strbuf_puts(html, "<!-- raw HTML omitted -->");
     } else {
-      cmark_strbuf_put(html, node->as.literal.data, node->as.literal.len);
+      cmark_strbuf_put(html, literal, literal_len);
     }
     break;
 
   case CMARK_NODE_CUSTOM_INLINE:
     if (entering) {
-      cmark_strbuf_put(html, node->as.custom.on_enter.data,
-                       node->as.custom.on_enter.len);
+      cmark_strbuf_put(html, literal, literal_len);
     } else {
-      cmark_strbuf_put(html, node->as.custom.on_exit.data,
-                       node->as.custom.on_exit.len);
+      cmark_strbuf_put(html, info, info_len);
     }
     break;
 
   case CMARK_NODE_STRONG:
-    if (entering) {
-      cmark_strbuf_puts(html, "<strong>");
-    } else {
-      cmark_strbuf_puts(html, "</strong>");
-    }
+    cmark_strbuf_puts(html, entering ? "<strong>" : "</strong>");
     break;
 
   case CMARK_NODE_EMPH:
-    if (entering) {
-      cmark_strbuf_puts(html, "<em>");
-    } else {
-      cmark_strbuf_puts(html, "</em>");
-    }
+    cmark_strbuf_puts(html, entering ? "<em>" : "</em>");
     break;
 
   case CMARK_NODE_LINK:
+  case CMARK_NODE_IMAGE:
     if (entering) {
-      cmark_strbuf_puts(html, "<a href=\"");
-      if (!((options & CMARK_OPT_SAFE) &&
-            scan_dangerous_url(&node->as.link.url, 0))) {
-        houdini_escape_href(html, node->as.link.url.data,
-                            node->as.link.url.len);
+      cmark_strbuf_puts(html, ev->type == CMARK_NODE_LINK ? "<a href=\""
+                                                          : "<img src=\"");
+      url.data = (unsigned char *)literal;
+      url.len = literal_len;
+      url.alloc = 0;
+      if (!((options & CMARK_OPT_SAFE) && literal_len > 0 &&
+            scan_dangerous_url(&url, 0))) {
+        houdini_escape_href(html, literal, literal_len);
       }
-      if (node->as.link.title.len) {
-        cmark_strbuf_puts(html, "\" title=\"");
-        escape_html(html, node->as.link.title.data, node->as.link.title.len);
+      if (ev->type == CMARK_NODE_IMAGE) {
+        cmark_strbuf_puts(html, "\" alt=\"");
+        break;
       }
-      cmark_strbuf_puts(html, "\">");
-    } else {
-      cmark_strbuf_puts(html, "</a>");
     }
-    break;
-
-  case CMARK_NODE_IMAGE:
-    if (entering) {
-      cmark_strbuf_puts(html, "<img src=\"");
-      if (!((options & CMARK_OPT_SAFE) &&
-            scan_dangerous_url(&node->as.link.url, 0))) {
-        houdini_escape_href(html, node->as.link.url.data,
-                            node->as.link.url.len);
-      }
-      cmark_strbuf_puts(html, "\" alt=\"");
-      state->plain = node;
-    } else {
-      if (node->as.link.title.len) {
+    if (entering || ev->type == CMARK_NODE_IMAGE) {
+      if (info_len) {
         cmark_strbuf_puts(html, "\" title=\"");
-        escape_html(html, node->as.link.title.data, node->as.link.title.len);
+        escape_html(html, info, info_len);
       }
-
-      cmark_strbuf_puts(html, "\" />");
+      cmark_strbuf_puts(html, ev->type == CMARK_NODE_LINK ? "\">" : "\" />");
+    } else {
+      cmark_strbuf_puts(html, "</a>");
     }
     break;
 
@@ -321,21 +278,66 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
     assert(false);
     break;
   }
+}
+
+static CMARK_INLINE const unsigned char *S_chunk_data(cmark_chunk *c) {
+  return c != NULL && c->len > 0 ? c->data : (const unsigned char *)"";
+}
+
+static int S_render_node(cmark_node *node, cmark_event_type ev_type,
+                         struct render_state *state, int options) {
+  cmark_flat_event ev;
+  cmark_chunk *literal, *info;
+
+  if (state->plain == node) { // back at original node
+    state->plain = NULL;
+  }
 
-  // cmark_strbuf_putc(html, 'x');
+  cmark_flat_event_init(&ev, node, ev_type, &literal, &info);
+  if (state->plain != NULL) {
+    S_render_plain(&ev, S_chunk_data(literal), state->html);
+    return 1;
+  }
+
+  S_render_event(&ev, S_chunk_data(literal), S_chunk_data(info), state->html,
+                 options);
+  if (node->type == CMARK_NODE_IMAGE && ev_type == CMARK_EVENT_ENTER)
+    state->plain = node;
   return 1;
 }
 
+// The bytes of markup around each type of node, without and with
+// source positions, for the size hint.  Escaping adds about 4 bytes
+// to each escapable character.
+static const unsigned char HTML_OVERHEAD[2][CMARK_NODE_LAST_INLINE + 1] = {
+    {0, 0, 27, 11, 10, 25, 1, 1, 8, 10, 7, 0, 1, 7, 13, 0, 0, 9, 17, 15, 20},
+    {0, 0, 54, 38, 37, 52, 1, 1, 35, 37, 34, 0, 1, 7, 13, 0, 0, 9, 17, 15,
+     20}};
+
+size_t cmark_render_html_size_hint(cmark_node *root, int options) {
+  return cmark_node_estimate_size(
+      root, HTML_OVERHEAD[(options & CMARK_OPT_SOURCEPOS) != 0], 4);
+}
+
 char *cmark_render_html(cmark_node *root, int options) {
   char *result;
   cmark_strbuf html = CMARK_BUF_INIT(cmark_node_mem(root));
   cmark_event_type ev_type;
   cmark_node *cur;
   struct render_state state = {&html, NULL};
+  size_t max_output = cmark_node_output_limit(root);
   cmark_iter *iter = cmark_iter_new(root);
 
+  cmark_strbuf_reserve(&html, cmark_render_html_size_hint(root, options));
+
   while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
     cur = cmark_iter_get_node(iter);
+    if (max_output && ev_type == CMARK_EVENT_ENTER &&
+        (size_t)html.size >= max_output) {
+      // output limit reached, leave out this node
+      cmark_iter_reset(iter, cur, CMARK_EVENT_EXIT);
+      continue;
+    }
     S_render_node(cur, ev_type, &state, options);
   }
   result = (char *)cmark_strbuf_detach(&html);
@@ -343,3 +345,42 @@ char *cmark_render_html(cmark_node *root, int options) {
   cmark_iter_free(iter);
   return result;
 }
+
+char *cmark_render_html_flat(const cmark_flat *flat, int options) {
+  extern cmark_mem DEFAULT_MEM_ALLOCATOR;
+  cmark_strbuf html = CMARK_BUF_INIT(&DEFAULT_MEM_ALLOCATOR);
+  const cmark_flat_event *events = CMARK_FLAT_EVENTS(flat);
+  const cmark_flat_event *ev;
+  const char *pool = CMARK_FLAT_POOL(flat);
+  const unsigned char *overhead =
+      HTML_OVERHEAD[(options & CMARK_OPT_SOURCEPOS) != 0];
+  size_t i, plain_end = 0, size = flat->size - flat->pool;
+
+  for (i = 0; i < flat->nevents; i++) {
+    if (events[i].event == CMARK_EVENT_ENTER)
+      size += overhead[events[i].type];
+  }
+  if (flat->max_output && size > flat->max_output)
+    size = flat->max_output;
+  cmark_strbuf_reserve(&html, size);
+
+  for (i = 0; i < flat->nevents; i++) {
+    ev = &events[i];
+    if (flat->max_output && ev->event == CMARK_EVENT_ENTER &&
+        (size_t)html.size >= flat->max_output) {
+      // output limit reached, leave out this node
+      i = ev->match;
+      continue;
+    }
+    if (i < plain_end) {
+      // in the alt text of an image
+      S_render_plain(ev, (const unsigned char *)pool + ev->literal, &html);
+      continue;
+    }
+    S_render_event(ev, (const unsigned char *)pool + ev->literal,
+                   (const unsigned char *)pool + ev->info, &html, options);
+    if (ev->type == CMARK_NODE_IMAGE && ev->event == CMARK_EVENT_ENTER)
+      plain_end = ev->match;
+  }
+  return (char *)cmark_strbuf_detach(&html);
+}
@@ -12,6 +12,7 @@
 #include "utf8.h"
 #include "scanners.h"
 #include "inlines.h"
+#include "stats.h"
 
 static const char *EMDASH = "\xE2\x80\x94";
 static const char *ENDASH = "\xE2\x80\x93";
@@ -30,19 +31,19 @@ static const char *RIGHTSINGLEQUOTE = "\xE2\x80\x99";
 #define make_emph(mem) make_simple(mem, CMARK_NODE_EMPH)
 #define make_strong(mem) make_simple(mem, CMARK_NODE_STRONG)
 
-#define MAXBACKTICKS 1000
+#define DELIM_BLOCK_SIZE 256
 
 typedef struct delimiter {
   struct delimiter *previous;
   struct delimiter *next;
   cmark_node *inl_text;
+  bufsize_t slot;
   unsigned char delim_char;
   bool can_open;
   bool can_close;
 } delimiter;
 
 typedef struct bracket {
-  struct bracket *previous;
   struct delimiter *previous_delimiter;
   cmark_node *inl_text;
   bufsize_t position;
@@ -51,28 +52,86 @@ typedef struct bracket {
   bool bracket_after;
 } bracket;
 
+typedef struct {
+  bufsize_t len;
+  bufsize_t pos;
+} backtick_run;
+
+// Stacks and tables for inline parsing, kept by the parser and reused
+// for every block with inline content.
+//
+// Delimiters are linked by pointer, so they are allocated in blocks
+// which never move; slots above the last delimiter on the stack are
+// reused.  Brackets are only ever pushed and popped, and live in a
+// plain array.  The backtick runs of a subject are indexed on its
+// first code span.
+struct cmark_inline_workspace {
+  cmark_mem *mem;
+  cmark_budget *budget;
+  cmark_doc_stats *doc_stats;
+  delimiter **delim_blocks;
+  bufsize_t delim_nblocks;
+  bufsize_t delim_top;
+  bracket *brackets;
+  bufsize_t nbrackets;
+  bufsize_t brackets_alloc;
+  backtick_run *runs;
+  bufsize_t nruns;
+  bufsize_t runs_alloc;
+};
+
 typedef struct {
   cmark_mem *mem;
   cmark_chunk input;
   bufsize_t pos;
   cmark_reference_map *refmap;
+  cmark_inline_workspace *ws;
   delimiter *last_delim;
-  bracket *last_bracket;
-  bufsize_t backticks[MAXBACKTICKS + 1];
-  bool scanned_for_backticks;
+  bool backticks_indexed;
+  size_t ndelims; // delimiters on the stack, awaiting a match
 } subject;
 
 static CMARK_INLINE bool S_is_line_end_char(char c) {
   return (c == '\n' || c == '\r');
 }
 
+// Lower bounds for the opener search in process_emphasis: whether a
+// closer matches an opener depends on its character, its length mod 3
+// and whether it can open, so a closer that found no opener bounds the
+// search only for later closers alike in all three.
+typedef delimiter *openers_bottom_t[6][128];
+
+static CMARK_INLINE int openers_bottom_class(delimiter *closer) {
+  return (closer->can_open ? 3 : 0) + closer->inl_text->as.literal.len % 3;
+}
+
+// The length of `opener` changed, or it went away together with the
+// delimiters after it: lower the bounds resting on any of them.
+static void lower_openers_bottom(openers_bottom_t openers_bottom,
+                                 delimiter *opener) {
+  static const unsigned char delim_chars[] = {'*', '_', '\'', '"'};
+  delimiter *bottom;
+  size_t i;
+  int cls;
+
+  for (cls = 0; cls < 6; cls++) {
+    for (i = 0; i < sizeof(delim_chars); i++) {
+      bottom = openers_bottom[cls][delim_chars[i]];
+      if (bottom != NULL && bottom->slot >= opener->slot)
+        openers_bottom[cls][delim_chars[i]] = opener->previous;
+    }
+  }
+}
+
 static delimiter *S_insert_emph(subject *subj, delimiter *opener,
-                                delimiter *closer);
+                                delimiter *closer,
+                                openers_bottom_t openers_bottom);
 
 static int parse_inline(subject *subj, cmark_node *parent, int options);
 
 static void subject_from_buf(cmark_mem *mem, subject *e, cmark_strbuf *buffer,
-                             cmark_reference_map *refmap);
+                             cmark_reference_map *refmap,
+                             cmark_inline_workspace *ws);
 static bufsize_t subject_find_special_char(subject *subj, int options);
 
 // Create an inline with a literal string value.
@@ -82,6 +141,7 @@ static CMARK_INLINE cmark_node *make_literal(cmark_mem *mem, cmark_node_type t,
   cmark_strbuf_init(mem, &e->content, 0);
   e->type = t;
   e->as.literal = s;
+  STATS_ADD(nodes[t], 1);
   return e;
 }
 
@@ -90,6 +150,7 @@ static CMARK_INLINE cmark_node *make_simple(cmark_mem *mem, cmark_node_type t) {
   cmark_node *e = (cmark_node *)mem->calloc(1, sizeof(*e));
   cmark_strbuf_init(mem, &e->content, 0);
   e->type = t;
+  STATS_ADD(nodes[t], 1);
   return e;
 }
 
@@ -147,21 +208,52 @@ static CMARK_INLINE cmark_node *make_autolink(cmark_mem *mem, cmark_chunk url,
   return link;
 }
 
+cmark_inline_workspace *cmark_inline_workspace_new(cmark_mem *mem,
+                                                   cmark_budget *budget,
+                                                   cmark_doc_stats *doc_stats) {
+  cmark_inline_workspace *ws =
+      (cmark_inline_workspace *)mem->calloc(1, sizeof(*ws));
+  ws->mem = mem;
+  ws->budget = budget;
+  ws->doc_stats = doc_stats;
+  return ws;
+}
+
+void cmark_inline_workspace_free(cmark_inline_workspace *ws) {
+  cmark_mem *mem;
+  bufsize_t i;
+
+  if (ws == NULL)
+    return;
+  mem = ws->mem;
+  for (i = 0; i < ws->delim_nblocks; i++) {
+    mem->free(ws->delim_blocks[i]);
+  }
+  mem->free(ws->delim_blocks);
+  mem->free(ws->brackets);
+  mem->free(ws->runs);
+  mem->free(ws);
+}
+
+// The workspace `ws` may be NULL for a subject without emphasis, links
+// or code spans (reference definitions).
 static void subject_from_buf(cmark_mem *mem, subject *e, cmark_strbuf *buffer,
-                             cmark_reference_map *refmap) {
-  int i;
+                             cmark_reference_map *refmap,
+                             cmark_inline_workspace *ws) {
   e->mem = mem;
   e->input.data = buffer->ptr;
   e->input.len = buffer->size;
   e->input.alloc = 0;
   e->pos = 0;
   e->refmap = refmap;
+  e->ws = ws;
   e->last_delim = NULL;
-  e->last_bracket = NULL;
-  for (i=0; i <= MAXBACKTICKS; i++) {
-    e->backticks[i] = 0;
+  if (ws != NULL) {
+    ws->delim_top = 0;
+    ws->nbrackets = 0;
   }
-  e->scanned_for_backticks = false;
+  e->backticks_indexed = false;
+  e->ndelims = 0;
 }
 
 static CMARK_INLINE int isbacktick(int c) { return (c == '`'); }
@@ -221,6 +313,43 @@ static CMARK_INLINE cmark_chunk take_while(subject *subj, int (*f)(int)) {
   return cmark_chunk_dup(&subj->input, startpos, len);
 }
 
+static int backtick_run_cmp(const void *a, const void *b) {
+  const backtick_run *x = (const backtick_run *)a;
+  const backtick_run *y = (const backtick_run *)b;
+  if (x->len != y->len)
+    return x->len < y->len ? -1 : 1;
+  return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+// Index all runs of backticks in the subject, ordered by length and
+// then position.  memchr skips the text between runs.
+static void index_backtick_runs(subject *subj) {
+  cmark_inline_workspace *ws = subj->ws;
+  const unsigned char *data = subj->input.data;
+  const unsigned char *p;
+  bufsize_t len = subj->input.len;
+  bufsize_t pos = 0, start;
+
+  ws->nruns = 0;
+  while (pos < len &&
+         (p = (const unsigned char *)memchr(data + pos, '`', len - pos))) {
+    start = (bufsize_t)(p - data);
+    pos = start + 1;
+    while (pos < len && data[pos] == '`')
+      pos++;
+    if (ws->nruns == ws->runs_alloc) {
+      ws->runs_alloc = ws->runs_alloc ? 2 * ws->runs_alloc : 32;
+      ws->runs = (backtick_run *)subj->mem->realloc(
+          ws->runs, ws->runs_alloc * sizeof(backtick_run));
+    }
+    ws->runs[ws->nruns].len = pos - start;
+    ws->runs[ws->nruns].pos = start;
+    ws->nruns++;
+  }
+  qsort(ws->runs, ws->nruns, sizeof(backtick_run), backtick_run_cmp);
+  subj->backticks_indexed = true;
+}
+
 // Try to process a backtick code span that began with a
 // span of ticks of length openticklength length (already
 // parsed).  Return 0 if you don't find matching closing
@@ -228,43 +357,30 @@ static CMARK_INLINE cmark_chunk take_while(subject *subj, int (*f)(int)) {
 // after the closing backticks.
 static bufsize_t scan_to_closing_backticks(subject *subj,
                                            bufsize_t openticklength) {
-
-  bool found = false;
-  if (openticklength > MAXBACKTICKS) {
-    // we limit backtick string length because of the array subj->backticks:
-    return 0;
-  }
-  if (subj->scanned_for_backticks &&
-      subj->backticks[openticklength] <= subj->pos) {
-    // return if we already know there's no closer
+  backtick_run *runs;
+  bufsize_t lo = 0, hi, mid;
+
+  if (!subj->backticks_indexed)
+    index_backtick_runs(subj);
+
+  // find the first run of the same length at or after the current
+  // position (the character there is never a backtick, so runs are
+  // never split):
+  runs = subj->ws->runs;
+  hi = subj->ws->nruns;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (runs[mid].len < openticklength ||
+        (runs[mid].len == openticklength && runs[mid].pos < subj->pos))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == subj->ws->nruns || runs[lo].len != openticklength)
     return 0;
-  }
-  while (!found) {
-    // read non backticks
-    unsigned char c;
-    bufsize_t numticks = 0;
-    while ((c = peek_char(subj)) && c != '`') {
-      advance(subj);
-    }
-    if (is_eof(subj)) {
-      break;
-    }
 
-    while (peek_char(subj) == '`') {
-      advance(subj);
-      numticks++;
-    }
-    // store position of ender
-    if (numticks <= MAXBACKTICKS) {
-      subj->backticks[numticks] = subj->pos - numticks;
-    }
-    if (numticks == openticklength) {
-      return (subj->pos);
-    }
-  }
-  // got through whole input without finding closer
-  subj->scanned_for_backticks = true;
-  return 0;
+  subj->pos = runs[lo].pos + openticklength;
+  return subj->pos;
 }
 
 // Parse backtick code section or raw backticks, return an inline.
@@ -372,30 +488,50 @@ static void remove_delimiter(subject *subj, delimiter *delim) {
   if (delim == NULL)
     return;
   if (delim->next == NULL) {
-    // end of list:
+    // end of list, release its slot and any free ones below:
     assert(delim == subj->last_delim);
     subj->last_delim = delim->previous;
+    subj->ws->delim_top =
+        delim->previous == NULL ? 0 : delim->previous->slot + 1;
   } else {
     delim->next->previous = delim->previous;
   }
   if (delim->previous != NULL) {
     delim->previous->next = delim->next;
   }
-  subj->mem->free(delim);
+  subj->ndelims--;
+}
+
+static CMARK_INLINE bracket *last_bracket(subject *subj) {
+  cmark_inline_workspace *ws = subj->ws;
+  return ws->nbrackets > 0 ? &ws->brackets[ws->nbrackets - 1] : NULL;
 }
 
 static void pop_bracket(subject *subj) {
-  bracket *b;
-  if (subj->last_bracket == NULL)
-    return;
-  b = subj->last_bracket;
-  subj->last_bracket = subj->last_bracket->previous;
-  subj->mem->free(b);
+  if (subj->ws->nbrackets > 0)
+    subj->ws->nbrackets--;
 }
 
 static void push_delimiter(subject *subj, unsigned char c, bool can_open,
                            bool can_close, cmark_node *inl_text) {
-  delimiter *delim = (delimiter *)subj->mem->calloc(1, sizeof(delimiter));
+  cmark_inline_workspace *ws = subj->ws;
+  bufsize_t block = ws->delim_top / DELIM_BLOCK_SIZE;
+  delimiter *delim;
+
+  if (ws->budget->limits.max_delimiters &&
+      subj->ndelims >= ws->budget->limits.max_delimiters) {
+    // the run stays literal text
+    return;
+  }
+  if (block == ws->delim_nblocks) {
+    ws->delim_blocks = (delimiter **)subj->mem->realloc(
+        ws->delim_blocks, (block + 1) * sizeof(delimiter *));
+    ws->delim_blocks[block] =
+        (delimiter *)subj->mem->calloc(DELIM_BLOCK_SIZE, sizeof(delimiter));
+    ws->delim_nblocks++;
+  }
+  delim = &ws->delim_blocks[block][ws->delim_top % DELIM_BLOCK_SIZE];
+  delim->slot = ws->delim_top++;
   delim->delim_char = c;
   delim->can_open = can_open;
   delim->can_close = can_close;
@@ -406,21 +542,29 @@ static void push_delimiter(subject *subj, unsigned char c, bool can_open,
     delim->previous->next = delim;
   }
   subj->last_delim = delim;
+  subj->ndelims++;
+  STATS_MAX(delim_peak, subj->ndelims);
 }
 
 static void push_bracket(subject *subj, bool image, cmark_node *inl_text) {
-  bracket *b = (bracket *)subj->mem->calloc(1, sizeof(bracket));
-  if (subj->last_bracket != NULL) {
-    subj->last_bracket->bracket_after = true;
+  cmark_inline_workspace *ws = subj->ws;
+  bracket *b;
+
+  if (ws->nbrackets == ws->brackets_alloc) {
+    ws->brackets_alloc = ws->brackets_alloc ? 2 * ws->brackets_alloc : 16;
+    ws->brackets = (bracket *)subj->mem->realloc(
+        ws->brackets, ws->brackets_alloc * sizeof(bracket));
   }
+  if (ws->nbrackets > 0) {
+    ws->brackets[ws->nbrackets - 1].bracket_after = true;
+  }
+  b = &ws->brackets[ws->nbrackets++];
   b->image = image;
   b->active = true;
   b->inl_text = inl_text;
-  b->previous = subj->last_bracket;
   b->previous_delimiter = subj->last_delim;
   b->position = subj->pos;
   b->bracket_after = false;
-  subj->last_bracket = b;
 }
 
 // Assumes the subject has a c at the current position.
@@ -517,13 +661,16 @@ static void process_emphasis(subject *subj, delimiter *stack_bottom) {
   delimiter *old_closer;
   bool opener_found;
   bool odd_match;
-  delimiter *openers_bottom[128];
+  int cls;
+  openers_bottom_t openers_bottom;
 
   // initialize openers_bottom:
-  openers_bottom['*'] = stack_bottom;
-  openers_bottom['_'] = stack_bottom;
-  openers_bottom['\''] = stack_bottom;
-  openers_bottom['"'] = stack_bottom;
+  for (cls = 0; cls < 6; cls++) {
+    openers_bottom[cls]['*'] = stack_bottom;
+    openers_bottom[cls]['_'] = stack_bottom;
+    openers_bottom[cls]['\''] = stack_bottom;
+    openers_bottom[cls]['"'] = stack_bottom;
+  }
 
   // move back to first relevant delim.
   while (closer != NULL && closer->previous != stack_bottom) {
@@ -531,32 +678,34 @@ static void process_emphasis(subject *subj, delimiter *stack_bottom) {
   }
 
   // now move forward, looking for closers, and handling each
-  while (closer != NULL) {
+  while (closer != NULL && !cmark_budget_exhausted(subj->ws->budget)) {
     if (closer->can_close) {
       // Now look backwards for first matching opener:
+      cls = openers_bottom_class(closer);
       opener = closer->previous;
       opener_found = false;
-      odd_match = false;
       while (opener != NULL && opener != stack_bottom &&
-             opener != openers_bottom[closer->delim_char]) {
-        // interior closer of size 2 can't match opener of size 1
-        // or of size 1 can't match 2
-        odd_match = (closer->can_open || opener->can_close) &&
-                    ((opener->inl_text->as.literal.len +
-                      closer->inl_text->as.literal.len) %
-                         3 ==
-                     0);
-        if (opener->delim_char == closer->delim_char && opener->can_open &&
-            !odd_match) {
-          opener_found = true;
-          break;
+             opener != openers_bottom[cls][closer->delim_char]) {
+        subj->ws->budget->steps++;
+        if (opener->delim_char == closer->delim_char && opener->can_open) {
+          // interior closer of size 2 can't match opener of size 1
+          // or of size 1 can't match 2
+          odd_match = (closer->can_open || opener->can_close) &&
+                      ((opener->inl_text->as.literal.len +
+                        closer->inl_text->as.literal.len) %
+                           3 ==
+                       0);
+          if (!odd_match) {
+            opener_found = true;
+            break;
+          }
         }
         opener = opener->previous;
       }
       old_closer = closer;
       if (closer->delim_char == '*' || closer->delim_char == '_') {
         if (opener_found) {
-          closer = S_insert_emph(subj, opener, closer);
+          closer = S_insert_emph(subj, opener, closer, openers_bottom);
         } else {
           closer = closer->next;
         }
@@ -564,26 +713,29 @@ static void process_emphasis(subject *subj, delimiter *stack_bottom) {
         cmark_chunk_free(subj->mem, &closer->inl_text->as.literal);
         closer->inl_text->as.literal = cmark_chunk_literal(RIGHTSINGLEQUOTE);
         if (opener_found) {
+          bufsize_t len = opener->inl_text->as.literal.len;
           cmark_chunk_free(subj->mem, &opener->inl_text->as.literal);
           opener->inl_text->as.literal = cmark_chunk_literal(LEFTSINGLEQUOTE);
+          if (opener->inl_text->as.literal.len != len)
+            lower_openers_bottom(openers_bottom, opener);
         }
         closer = closer->next;
       } else if (closer->delim_char == '"') {
         cmark_chunk_free(subj->mem, &closer->inl_text->as.literal);
         closer->inl_text->as.literal = cmark_chunk_literal(RIGHTDOUBLEQUOTE);
         if (opener_found) {
+          bufsize_t len = opener->inl_text->as.literal.len;
           cmark_chunk_free(subj->mem, &opener->inl_text->as.literal);
           opener->inl_text->as.literal = cmark_chunk_literal(LEFTDOUBLEQUOTE);
+          if (opener->inl_text->as.literal.len != len)
+            lower_openers_bottom(openers_bottom, opener);
         }
         closer = closer->next;
       }
-      if (!opener_found && !odd_match) {
-        // set lower bound for future searches for openers
-        // (we don't do this with 'odd_match' set because
-        // a ** that didn't match an earlier * might turn into
-        // an opener, and the * might be matched by something
-        // else.
-        openers_bottom[old_closer->delim_char] = old_closer->previous;
+      if (!opener_found) {
+        // set lower bound for future searches for openers of the
+        // same class (nothing down to here matches them either):
+        openers_bottom[cls][old_closer->delim_char] = old_closer->previous;
         if (!old_closer->can_open) {
           // we can remove a closer that can't be an
           // opener, once we've seen there's no
@@ -602,7 +754,8 @@ static void process_emphasis(subject *subj, delimiter *stack_bottom) {
 }
 
 static delimiter *S_insert_emph(subject *subj, delimiter *opener,
-                                delimiter *closer) {
+                                delimiter *closer,
+                                openers_bottom_t openers_bottom) {
   delimiter *delim, *tmp_delim;
   bufsize_t use_delims;
   cmark_node *opener_inl = opener->inl_text;
@@ -625,6 +778,8 @@ static delimiter *S_insert_emph(subject *subj, delimiter *opener,
   opener_inl->as.literal.len = opener_num_chars;
   closer_inl->as.literal.len = closer_num_chars;
 
+  lower_openers_bottom(openers_bottom, opener);
+
   // free delimiters between opener and closer
   delim = closer->previous;
   while (delim != NULL && delim != opener) {
@@ -636,6 +791,8 @@ static delimiter *S_insert_emph(subject *subj, delimiter *opener,
   // create new emph or strong, and splice it in to our inlines
   // between the opener and closer
   emph = use_delims == 1 ? make_emph(subj->mem) : make_strong(subj->mem);
+  subj->ws->budget->nodes++;
+  subj->ws->doc_stats->nodes[emph->type]++;
 
   tmp = opener_inl->next;
   while (tmp && tmp != closer_inl) {
@@ -866,6 +1023,38 @@ static bufsize_t manual_scan_link_url(cmark_chunk *input, bufsize_t offset) {
     return -1;
   return i - offset;
 }
+// Count a node just added to the document, for the size estimate of
+// the renderers.
+static void count_inline(subject *subj, cmark_node *node) {
+  cmark_doc_stats *stats = subj->ws->doc_stats;
+
+  stats->nodes[node->type]++;
+  switch (node->type) {
+  case CMARK_NODE_TEXT:
+  case CMARK_NODE_CODE:
+    cmark_doc_stats_add(stats, node->as.literal.data, node->as.literal.len,
+                        true);
+    break;
+  case CMARK_NODE_HTML_INLINE:
+    cmark_doc_stats_add(stats, node->as.literal.data, node->as.literal.len,
+                        false);
+    break;
+  case CMARK_NODE_LINK:
+  case CMARK_NODE_IMAGE:
+    cmark_doc_stats_add(stats, node->as.link.url.data, node->as.link.url.len,
+                        false);
+    cmark_doc_stats_add(stats, node->as.link.title.data,
+                        node->as.link.title.len, false);
+    if (node->first_child != NULL) {
+      // an autolink comes with its text
+      count_inline(subj, node->first_child);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
 // Return a link, an image, or a literal close bracket.
 static cmark_node *handle_close_bracket(subject *subj) {
   bufsize_t initial_pos, after_link_text_pos;
@@ -881,12 +1070,13 @@ static cmark_node *handle_close_bracket(subject *subj) {
   int found_label;
   cmark_node *tmp, *tmpnext;
   bool is_image;
+  bufsize_t i;
 
   advance(subj); // advance past ]
   initial_pos = subj->pos;
 
   // get last [ or ![
-  opener = subj->last_bracket;
+  opener = last_bracket(subj);
 
   if (opener == NULL) {
     return make_str(subj->mem, cmark_chunk_literal("]"));
@@ -977,8 +1167,10 @@ noMatch:
 
 match:
   inl = make_simple(subj->mem, is_image ? CMARK_NODE_IMAGE : CMARK_NODE_LINK);
+  subj->ws->budget->nodes++;
   inl->as.link.url = url;
   inl->as.link.title = title;
+  count_inline(subj, inl);
   cmark_node_insert_before(opener->inl_text, inl);
   // Add link text:
   tmp = opener->inl_text->next;
@@ -998,8 +1190,9 @@ match:
   // delimiters. (This code can be removed if we decide to allow links
   // inside links.)
   if (!is_image) {
-    opener = subj->last_bracket;
-    while (opener != NULL) {
+    i = subj->ws->nbrackets;
+    while (i-- > 0) {
+      opener = &subj->ws->brackets[i];
       if (!opener->image) {
         if (!opener->active) {
           break;
@@ -1007,7 +1200,6 @@ match:
           opener->active = false;
         }
       }
-      opener = opener->previous;
     }
   }
 
@@ -1089,6 +1281,16 @@ static int parse_inline(subject *subj, cmark_node *parent, int options) {
   if (c == 0) {
     return 0;
   }
+  if (cmark_budget_exhausted(subj->ws->budget)) {
+    // out of nodes or steps, the rest is text:
+    new_inl = make_str(subj->mem, cmark_chunk_dup(&subj->input, subj->pos,
+                                                  subj->input.len - subj->pos));
+    subj->pos = subj->input.len;
+    cmark_node_append_child(parent, new_inl);
+    count_inline(subj, new_inl);
+    return 0;
+  }
+  subj->ws->budget->steps++;
   switch (c) {
   case '\r':
   case '\n':
@@ -1150,6 +1352,8 @@ static int parse_inline(subject *subj, cmark_node *parent, int options) {
   }
   if (new_inl != NULL) {
     cmark_node_append_child(parent, new_inl);
+    subj->ws->budget->nodes++;
+    count_inline(subj, new_inl);
   }
 
   return 1;
@@ -1157,22 +1361,18 @@ static int parse_inline(subject *subj, cmark_node *parent, int options) {
 
 // Parse inlines from parent's string_content, adding as children of parent.
 extern void cmark_parse_inlines(cmark_mem *mem, cmark_node *parent,
-                                cmark_reference_map *refmap, int options) {
+                                cmark_reference_map *refmap,
+                                cmark_inline_workspace *ws, int options) {
   subject subj;
-  subject_from_buf(mem, &subj, &parent->content, refmap);
+  subject_from_buf(mem, &subj, &parent->content, refmap, ws);
   cmark_chunk_rtrim(&subj.input);
 
   while (!is_eof(&subj) && parse_inline(&subj, parent, options))
     ;
 
+  // empties the delimiter stack:
   process_emphasis(&subj, NULL);
-  // free bracket and delim stack
-  while (subj.last_delim) {
-    pop_bracket(&subj);
-  }
-  while (subj.last_bracket) {
-    pop_bracket(&subj);
-  }
+  // unmatched brackets are left for the next subject to reset
 }
 
 // Parse zero or more space characters, including at most one newline.
@@ -1183,11 +1383,12 @@ static void spnl(subject *subj) {
   }
 }
 
-// Parse reference.  Assumes string begins with '[' character.
+// Parse reference.  Assumes string begins with '[' character at 'offset'.
 // Modify refmap if a reference is encountered.
 // Return 0 if no reference found, otherwise position of subject
 // after reference is parsed.
 bufsize_t cmark_parse_reference_inline(cmark_mem *mem, cmark_strbuf *input,
+                                       bufsize_t offset,
                                        cmark_reference_map *refmap) {
   subject subj;
 
@@ -1198,7 +1399,8 @@ bufsize_t cmark_parse_reference_inline(cmark_mem *mem, cmark_strbuf *input,
   bufsize_t matchlen = 0;
   bufsize_t beforetitle;
 
-  subject_from_buf(mem, &subj, input, NULL);
+  subject_from_buf(mem, &subj, input, NULL, NULL);
+  subj.pos = offset;
 
   // parse label:
   if (!link_label(&subj, &lab) || lab.len == 0)
@@ -5,13 +5,22 @@
 extern "C" {
 #endif
 
+typedef struct cmark_inline_workspace cmark_inline_workspace;
+
 cmark_chunk cmark_clean_url(cmark_mem *mem, cmark_chunk *url);
 cmark_chunk cmark_clean_title(cmark_mem *mem, cmark_chunk *title);
 
+cmark_inline_workspace *
+cmark_inline_workspace_new(cmark_mem *mem, struct cmark_budget *budget,
+                           struct cmark_doc_stats *doc_stats);
+void cmark_inline_workspace_free(cmark_inline_workspace *ws);
+
 void cmark_parse_inlines(cmark_mem *mem, cmark_node *parent,
-                         cmark_reference_map *refmap, int options);
+                         cmark_reference_map *refmap,
+                         cmark_inline_workspace *ws, int options);
 
 bufsize_t cmark_parse_reference_inline(cmark_mem *mem, cmark_strbuf *input,
+                                       bufsize_t offset,
                                        cmark_reference_map *refmap);
 
 #ifdef __cplusplus
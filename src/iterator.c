@@ -49,6 +49,7 @@ cmark_event_type cmark_iter_next(cmark_iter *iter) {
 
   /* roll forward to next item, setting both fields */
   if (ev_type == CMARK_EVENT_ENTER && !S_is_leaf(node)) {
+    cmark_node_ensure_inlines(node);
     if (node->first_child == NULL) {
       /* stay on this node but exit */
       iter->next.ev_type = CMARK_EVENT_EXIT;
@@ -6,6 +6,7 @@
 #include "memory.h"
 #include "cmark.h"
 #include "node.h"
+#include "stats.h"
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
 #include <io.h>
@@ -34,6 +35,7 @@ void print_usage() {
   printf("  --safe           Suppress raw HTML and dangerous URLs\n");
   printf("  --smart          Use smart punctuation\n");
   printf("  --normalize      Consolidate adjacent text nodes\n");
+  printf("  --stats          Print parser statistics to stderr\n");
   printf("  --help, -h       Print usage information\n");
   printf("  --version        Print version\n");
 }
@@ -69,6 +71,41 @@ static void print_document(cmark_node *document, writer_format writer,
   cmark_node_mem(document)->free(result);
 }
 
+static void print_stats(const cmark_stats *stats, double render_ns) {
+  static const char *node_names[CMARK_NODE_LAST_INLINE + 1] = {
+      "none",          "document",    "block_quote", "list",
+      "item",          "code_block",  "html_block",  "custom_block",
+      "paragraph",     "heading",     "thematic_break", "text",
+      "softbreak",     "linebreak",   "code",        "html_inline",
+      "custom_inline", "emph",        "strong",      "link",
+      "image"};
+  size_t nodes = 0;
+  int i;
+
+  fprintf(stderr, "time (ms):\n");
+  fprintf(stderr, "  block        %10.3f\n", stats->block_ns / 1e6);
+  fprintf(stderr, "  finalize     %10.3f\n", stats->finalize_ns / 1e6);
+  fprintf(stderr, "  inline       %10.3f\n", stats->inline_ns / 1e6);
+  fprintf(stderr, "  consolidate  %10.3f\n", stats->consolidate_ns / 1e6);
+  fprintf(stderr, "  render       %10.3f\n", render_ns / 1e6);
+  fprintf(stderr, "lines          %10lu\n", (unsigned long)stats->lines);
+  for (i = 0; i <= CMARK_NODE_LAST_INLINE; i++)
+    nodes += stats->nodes[i];
+  fprintf(stderr, "nodes          %10lu\n", (unsigned long)nodes);
+  for (i = 0; i <= CMARK_NODE_LAST_INLINE; i++)
+    if (stats->nodes[i] > 0)
+      fprintf(stderr, "  %-14s %8lu\n", node_names[i],
+              (unsigned long)stats->nodes[i]);
+  fprintf(stderr, "allocs         %10lu (%lu bytes)\n",
+          (unsigned long)stats->allocs, (unsigned long)stats->alloc_bytes);
+  fprintf(stderr, "reallocs       %10lu (%lu bytes)\n",
+          (unsigned long)stats->reallocs,
+          (unsigned long)stats->realloc_bytes);
+  fprintf(stderr, "ref lookups    %10lu (%lu hits)\n",
+          (unsigned long)stats->ref_lookups, (unsigned long)stats->ref_hits);
+  fprintf(stderr, "delim peak     %10lu\n", (unsigned long)stats->delim_peak);
+}
+
 int main(int argc, char *argv[]) {
   int i, numfps = 0;
   int *files;
@@ -80,6 +117,9 @@ int main(int argc, char *argv[]) {
   char *unparsed;
   writer_format writer = FORMAT_HTML;
   cmark_option_t options = CMARK_OPT_DEFAULT;
+  bool stats = false;
+  cmark_stats parser_stats;
+  double render_ns = 0;
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
   _setmode(_fileno(stdin), _O_BINARY);
@@ -107,6 +147,8 @@ int main(int argc, char *argv[]) {
       options |= CMARK_OPT_NORMALIZE;
     } else if (strcmp(argv[i], "--validate-utf8") == 0) {
       options |= CMARK_OPT_VALIDATE_UTF8;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      stats = true;
     } else if ((strcmp(argv[i], "--help") == 0) ||
                (strcmp(argv[i], "-h") == 0)) {
       print_usage();
@@ -185,12 +227,25 @@ int main(int argc, char *argv[]) {
   }
 
   document = cmark_parser_finish(parser);
+  if (stats && !cmark_parser_get_stats(parser, &parser_stats)) {
+    fprintf(stderr, "cmark: built without CMARK_STATS, no statistics\n");
+    stats = false;
+  }
   cmark_parser_free(parser);
 
+#ifdef CMARK_STATS
+  render_ns = cmark_stats_clock();
+#endif
   print_document(document, writer, options, width);
+#ifdef CMARK_STATS
+  render_ns = cmark_stats_clock() - render_ns;
+#endif
 
   cmark_node_free(document);
 
+  if (stats)
+    print_stats(&parser_stats, render_ns);
+
   free(files);
 
   return 0;
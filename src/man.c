@@ -251,6 +251,11 @@ static int S_render_node(cmark_renderer *renderer, cmark_node *node,
   return 1;
 }
 
+// The bytes of markup around each type of node, for the size estimate.
+static const unsigned char MAN_OVERHEAD[CMARK_NODE_LAST_INLINE + 1] = {
+    0, 0, 8, 0, 13, 23, 0, 2, 4, 5, 21, 0, 1, 14, 9, 0, 0, 9, 9, 3, 3};
+
 char *cmark_render_man(cmark_node *root, int options, int width) {
-  return cmark_render(root, options, width, S_outc, S_render_node);
+  return cmark_render(root, options, width, S_outc, S_render_node,
+                      cmark_node_estimate_size(root, MAN_OVERHEAD, 1));
 }
@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "node.h"
+#include "stats.h"
 
 static void S_node_unlink(cmark_node *node);
 
@@ -76,6 +77,7 @@ cmark_node *cmark_node_new_with_mem(cmark_node_type type, cmark_mem *mem) {
   cmark_node *node = (cmark_node *)mem->calloc(1, sizeof(*node));
   cmark_strbuf_init(mem, &node->content, 0);
   node->type = (uint16_t)type;
+  STATS_ADD(nodes[type], 1);
 
   switch (node->type) {
   case CMARK_NODE_HEADING:
@@ -128,6 +130,12 @@ static void S_free_nodes(cmark_node *e) {
       cmark_chunk_free(NODE_MEM(e), &e->as.custom.on_enter);
       cmark_chunk_free(NODE_MEM(e), &e->as.custom.on_exit);
       break;
+    case CMARK_NODE_DOCUMENT:
+      if (e->as.document.stats)
+        NODE_MEM(e)->free(e->as.document.stats);
+      if (e->as.document.lazy)
+        cmark_lazy_inlines_free(NODE_MEM(e), e->as.document.lazy);
+      break;
     default:
       break;
     }
@@ -237,6 +245,7 @@ cmark_node *cmark_node_first_child(cmark_node *node) {
   if (node == NULL) {
     return NULL;
   } else {
+    cmark_node_ensure_inlines(node);
     return node->first_child;
   }
 }
@@ -245,6 +254,7 @@ cmark_node *cmark_node_last_child(cmark_node *node) {
   if (node == NULL) {
     return NULL;
   } else {
+    cmark_node_ensure_inlines(node);
     return node->last_child;
   }
 }
@@ -637,6 +647,26 @@ int cmark_node_get_end_column(cmark_node *node) {
   return node->end_column;
 }
 
+// Parse the deferred inlines under the block 'node' before it is moved,
+// as they can only be parsed in the document it came from.
+static void S_parse_pending_tree(cmark_node *node) {
+  cmark_node *root;
+  cmark_iter *iter;
+
+  if (node == NULL || node->parent == NULL || !S_is_block(node)) {
+    return;
+  }
+  for (root = node->parent; root->parent != NULL; root = root->parent)
+    ;
+  if (root->type != CMARK_NODE_DOCUMENT || root->as.document.lazy == NULL) {
+    return;
+  }
+  iter = cmark_iter_new(node);
+  while (cmark_iter_next(iter) != CMARK_EVENT_DONE)
+    ;
+  cmark_iter_free(iter);
+}
+
 // Unlink a node without adjusting its next, prev, and parent pointers.
 static void S_node_unlink(cmark_node *node) {
   cmark_node *parent;
@@ -665,6 +695,7 @@ static void S_node_unlink(cmark_node *node) {
 }
 
 void cmark_node_unlink(cmark_node *node) {
+  S_parse_pending_tree(node);
   S_node_unlink(node);
 
   node->next = NULL;
@@ -683,6 +714,7 @@ int cmark_node_insert_before(cmark_node *node, cmark_node *sibling) {
     return 0;
   }
 
+  S_parse_pending_tree(sibling);
   S_node_unlink(sibling);
 
   old_prev = node->prev;
@@ -718,6 +750,7 @@ int cmark_node_insert_after(cmark_node *node, cmark_node *sibling) {
     return 0;
   }
 
+  S_parse_pending_tree(sibling);
   S_node_unlink(sibling);
 
   old_next = node->next;
@@ -757,6 +790,8 @@ int cmark_node_prepend_child(cmark_node *node, cmark_node *child) {
     return 0;
   }
 
+  cmark_node_ensure_inlines(node);
+  S_parse_pending_tree(child);
   S_node_unlink(child);
 
   old_first_child = node->first_child;
@@ -783,6 +818,8 @@ int cmark_node_append_child(cmark_node *node, cmark_node *child) {
     return 0;
   }
 
+  cmark_node_ensure_inlines(node);
+  S_parse_pending_tree(child);
   S_node_unlink(child);
 
   old_last_child = node->last_child;
@@ -811,6 +848,68 @@ static void S_print_error(FILE *out, cmark_node *node, const char *elem) {
           node->start_column);
 }
 
+const cmark_doc_stats *cmark_node_doc_stats(cmark_node *root,
+                                            cmark_doc_stats *scratch) {
+  cmark_iter *iter;
+  cmark_event_type ev_type;
+  cmark_node *cur;
+
+  if (root->type == CMARK_NODE_DOCUMENT && root->as.document.stats != NULL)
+    return root->as.document.stats;
+
+  memset(scratch, 0, sizeof(*scratch));
+  iter = cmark_iter_new(root);
+  while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+    if (ev_type != CMARK_EVENT_ENTER)
+      continue;
+    cur = cmark_iter_get_node(iter);
+    if (cur->type <= CMARK_NODE_LAST_INLINE)
+      scratch->nodes[cur->type]++;
+    switch (cur->type) {
+    case CMARK_NODE_CODE_BLOCK:
+      cmark_doc_stats_add(scratch, cur->as.code.literal.data,
+                          cur->as.code.literal.len, true);
+      break;
+    case CMARK_NODE_TEXT:
+    case CMARK_NODE_CODE:
+      cmark_doc_stats_add(scratch, cur->as.literal.data, cur->as.literal.len,
+                          true);
+      break;
+    case CMARK_NODE_HTML_BLOCK:
+    case CMARK_NODE_HTML_INLINE:
+      cmark_doc_stats_add(scratch, cur->as.literal.data, cur->as.literal.len,
+                          false);
+      break;
+    case CMARK_NODE_LINK:
+    case CMARK_NODE_IMAGE:
+      cmark_doc_stats_add(scratch, cur->as.link.url.data,
+                          cur->as.link.url.len, false);
+      cmark_doc_stats_add(scratch, cur->as.link.title.data,
+                          cur->as.link.title.len, false);
+      break;
+    default:
+      break;
+    }
+  }
+  cmark_iter_free(iter);
+  return scratch;
+}
+
+size_t cmark_node_estimate_size(cmark_node *root,
+                                const unsigned char *overhead, size_t escape) {
+  cmark_doc_stats scratch;
+  const cmark_doc_stats *stats = cmark_node_doc_stats(root, &scratch);
+  size_t max_output = cmark_node_output_limit(root);
+  size_t size = stats->literal_bytes + escape * stats->escapable;
+  int t;
+
+  for (t = 0; t <= CMARK_NODE_LAST_INLINE; t++)
+    size += overhead[t] * stats->nodes[t];
+  if (max_output && size > max_output)
+    size = max_output;
+  return size;
+}
+
 int cmark_node_check(cmark_node *node, FILE *out) {
   cmark_node *cur;
   int errors = 0;
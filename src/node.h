@@ -46,9 +46,24 @@ typedef struct {
   cmark_chunk on_exit;
 } cmark_custom;
 
+// Counts gathered by the parser, from which the renderers estimate
+// the size of their output.
+typedef struct cmark_doc_stats {
+  size_t nodes[CMARK_NODE_LAST_INLINE + 1];
+  size_t literal_bytes; // text, code and HTML literals, URLs, titles
+  size_t escapable;     // characters of escaped literals that need it
+} cmark_doc_stats;
+
+typedef struct {
+  size_t max_output;
+  cmark_doc_stats *stats;           // NULL unless made by the parser
+  struct cmark_lazy_inlines *lazy; // NULL unless inlines are deferred
+} cmark_document;
+
 enum cmark_node__internal_flags {
   CMARK_NODE__OPEN = (1 << 0),
   CMARK_NODE__LAST_LINE_BLANK = (1 << 1),
+  CMARK_NODE__INLINES_PENDING = (1 << 2),
 };
 
 struct cmark_node {
@@ -76,6 +91,7 @@ struct cmark_node {
     cmark_heading heading;
     cmark_link link;
     cmark_custom custom;
+    cmark_document document;
     int html_block_type;
   } as;
 };
@@ -83,6 +99,58 @@ struct cmark_node {
 static CMARK_INLINE cmark_mem *cmark_node_mem(cmark_node *node) {
   return node->content.mem;
 }
+
+// The output limit of the document containing 'node' (see
+// cmark_parser_set_limits), 0 for none.
+static CMARK_INLINE size_t cmark_node_output_limit(cmark_node *node) {
+  while (node->parent != NULL)
+    node = node->parent;
+  return node->type == CMARK_NODE_DOCUMENT ? node->as.document.max_output
+                                           : 0;
+}
+
+// Count 'len' bytes of literal text, and the characters among them that
+// are escaped in markup if 'escaped' is true.
+static CMARK_INLINE void cmark_doc_stats_add(cmark_doc_stats *stats,
+                                            const unsigned char *data,
+                                            bufsize_t len, bool escaped) {
+  size_t n = 0;
+  bufsize_t i;
+
+  stats->literal_bytes += len;
+  if (escaped) {
+    for (i = 0; i < len; i++) {
+      unsigned char c = data[i];
+      n += (c == '<') | (c == '>') | (c == '&') | (c == '"');
+    }
+    stats->escapable += n;
+  }
+}
+
+// Parse the inlines of 'node', deferred with CMARK_OPT_LAZY_INLINES.
+void cmark_node_parse_pending(cmark_node *node);
+
+void cmark_lazy_inlines_free(cmark_mem *mem, struct cmark_lazy_inlines *lazy);
+
+// Parse the inlines of 'node' if they are deferred, before its children
+// are looked at.
+static CMARK_INLINE void cmark_node_ensure_inlines(cmark_node *node) {
+  if (node->flags & CMARK_NODE__INLINES_PENDING)
+    cmark_node_parse_pending(node);
+}
+
+// The statistics of the document 'root', or if 'root' is not a parsed
+// document, of the tree under 'root' counted into 'scratch'.
+const cmark_doc_stats *cmark_node_doc_stats(cmark_node *root,
+                                            cmark_doc_stats *scratch);
+
+// Estimate the size of rendering 'root': its literal bytes, plus
+// 'escape' bytes for each escapable character, plus 'overhead[t]' for
+// each node of type t.  The estimate is capped at the document's
+// output limit.
+size_t cmark_node_estimate_size(cmark_node *root,
+                                const unsigned char *overhead, size_t escape);
+
 CMARK_EXPORT int cmark_node_check(cmark_node *node, FILE *out);
 
 #ifdef __cplusplus
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "node.h"
+#include "cmark.h"
+#include "outline.h"
+
+cmark_outline *cmark_outline_new(cmark_mem *mem) {
+  cmark_outline *outline = (cmark_outline *)mem->calloc(1, sizeof(*outline));
+
+  outline->mem = mem;
+  cmark_strbuf_init(mem, &outline->pool, 0);
+  cmark_strbuf_putc(&outline->pool, '\0');
+  return outline;
+}
+
+static cmark_outline_entry *S_add_entry(cmark_outline *outline, int type) {
+  cmark_outline_entry *entry;
+
+  if (outline->nentries == outline->alloc) {
+    outline->alloc = outline->alloc ? 2 * outline->alloc : 32;
+    outline->entries = (cmark_outline_entry *)outline->mem->realloc(
+        outline->entries, outline->alloc * sizeof(cmark_outline_entry));
+  }
+  entry = &outline->entries[outline->nentries++];
+  memset(entry, 0, sizeof(*entry));
+  entry->type = type;
+  return entry;
+}
+
+static unsigned int S_put_string(cmark_outline *outline,
+                                 const unsigned char *data, bufsize_t len,
+                                 unsigned int *string_len) {
+  unsigned int offset = (unsigned int)outline->pool.size;
+
+  *string_len = (unsigned int)len;
+  if (len <= 0)
+    return 0;
+  cmark_strbuf_put(&outline->pool, data, len);
+  cmark_strbuf_putc(&outline->pool, '\0');
+  return offset;
+}
+
+static void S_set_position(cmark_outline_entry *entry, cmark_node *node) {
+  entry->start_line = node->start_line;
+  entry->start_column = node->start_column;
+  entry->end_line = node->end_line;
+  entry->end_column = node->end_column;
+}
+
+void cmark_outline_add_block(cmark_outline *outline, cmark_node *block) {
+  cmark_iter *iter = cmark_iter_new(block);
+  cmark_outline_entry *entry;
+  cmark_node *cur;
+  cmark_chunk text;
+
+  while (cmark_iter_next(iter) != CMARK_EVENT_DONE) {
+    cur = cmark_iter_get_node(iter);
+    if (cmark_iter_get_event_type(iter) != CMARK_EVENT_ENTER)
+      continue;
+    if (cur->type == CMARK_NODE_HEADING) {
+      entry = S_add_entry(outline, CMARK_OUTLINE_HEADING);
+      entry->level = cur->as.heading.level;
+      text.data = cur->content.ptr;
+      text.len = cur->content.size;
+      text.alloc = 0;
+      cmark_chunk_trim(&text);
+      entry->text = S_put_string(outline, text.data, text.len,
+                                 &entry->text_len);
+      S_set_position(entry, cur);
+    } else if (cur->type == CMARK_NODE_CODE_BLOCK && cur->as.code.fenced) {
+      entry = S_add_entry(outline, CMARK_OUTLINE_CODE);
+      entry->text = S_put_string(outline, cur->as.code.info.data,
+                                 cur->as.code.info.len, &entry->text_len);
+      S_set_position(entry, cur);
+    }
+  }
+  cmark_iter_free(iter);
+}
+
+void cmark_outline_add_references(cmark_outline *outline,
+                                  cmark_reference_map *refmap) {
+  cmark_reference **refs;
+  cmark_reference *ref;
+  cmark_outline_entry *entry;
+  unsigned int i;
+
+  if (refmap->count == 0)
+    return;
+
+  // each reference's age is its index in the order they were made
+  refs = (cmark_reference **)outline->mem->calloc(refmap->count,
+                                                  sizeof(cmark_reference *));
+  for (i = 0; i < refmap->size; i++) {
+    for (ref = refmap->table[i]; ref != NULL; ref = ref->next)
+      refs[ref->age] = ref;
+  }
+  for (i = 0; i < refmap->count; i++) {
+    ref = refs[i];
+    entry = S_add_entry(outline, CMARK_OUTLINE_REFERENCE);
+    entry->text = S_put_string(outline, ref->label,
+                               (bufsize_t)strlen((char *)ref->label),
+                               &entry->text_len);
+    entry->url =
+        S_put_string(outline, ref->url.data, ref->url.len, &entry->url_len);
+  }
+  outline->mem->free(refs);
+}
+
+void cmark_outline_free(cmark_outline *outline) {
+  if (outline == NULL)
+    return;
+  cmark_strbuf_free(&outline->pool);
+  outline->mem->free(outline->entries);
+  outline->mem->free(outline);
+}
+
+size_t cmark_outline_count(const cmark_outline *outline) {
+  return outline->nentries;
+}
+
+const cmark_outline_entry *cmark_outline_entries(const cmark_outline *outline) {
+  return outline->entries;
+}
+
+const char *cmark_outline_string(const cmark_outline *outline,
+                                 unsigned int offset) {
+  return (const char *)outline->pool.ptr + offset;
+}
@@ -0,0 +1,37 @@
+#ifndef CMARK_OUTLINE_H
+#define CMARK_OUTLINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "cmark.h"
+#include "buffer.h"
+#include "memory.h"
+#include "references.h"
+
+// The entries, and a pool with their NUL-terminated strings.  The empty
+// string is at offset 0 of the pool.
+struct cmark_outline {
+  cmark_mem *mem;
+  cmark_outline_entry *entries;
+  size_t nentries;
+  size_t alloc;
+  cmark_strbuf pool;
+};
+
+cmark_outline *cmark_outline_new(cmark_mem *mem);
+
+// Add the headings and fenced code blocks under the closed block 'block'.
+void cmark_outline_add_block(cmark_outline *outline, cmark_node *block);
+
+// Add the reference definitions of 'refmap', in the order they were
+// made.
+void cmark_outline_add_references(cmark_outline *outline,
+                                  cmark_reference_map *refmap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,6 +5,7 @@
 #include "node.h"
 #include "buffer.h"
 #include "memory.h"
+#include "config.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,9 +13,38 @@ extern "C" {
 
 #define MAX_LINK_LABEL_LENGTH 1000
 
+// The limits set with cmark_parser_set_limits, and how much of them
+// has been used.
+typedef struct cmark_budget {
+  cmark_limits limits;
+  size_t nodes;
+  size_t steps;
+  size_t references;
+} cmark_budget;
+
+// No more nodes may be made or steps taken: what is left of the input
+// is kept as literal text.
+static CMARK_INLINE bool cmark_budget_exhausted(const cmark_budget *budget) {
+  return (budget->limits.max_nodes &&
+          budget->nodes >= budget->limits.max_nodes) ||
+         (budget->limits.max_steps &&
+          budget->steps >= budget->limits.max_steps);
+}
+
+// What a document needs to parse its inlines on demand, handed over
+// by the parser with CMARK_OPT_LAZY_INLINES.
+typedef struct cmark_lazy_inlines {
+  struct cmark_reference_map *refmap;
+  struct cmark_inline_workspace *ws;
+  cmark_budget budget;
+  cmark_doc_stats doc_stats;
+  int options;
+} cmark_lazy_inlines;
+
 struct cmark_parser {
   struct cmark_mem *mem;
   struct cmark_reference_map *refmap;
+  struct cmark_inline_workspace *inline_ws;
   struct cmark_node *root;
   struct cmark_node *current;
   int line_number;
@@ -30,6 +60,12 @@ struct cmark_parser {
   cmark_strbuf linebuf;
   int options;
   bool last_buffer_ended_with_cr;
+  cmark_budget budget;
+  cmark_doc_stats doc_stats;
+  struct cmark_outline *outline; // if only the outline is made
+#ifdef CMARK_STATS
+  cmark_stats stats;
+#endif
 };
 
 #ifdef __cplusplus
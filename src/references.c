@@ -4,6 +4,7 @@
 #include "references.h"
 #include "inlines.h"
 #include "chunk.h"
+#include "stats.h"
 
 static unsigned int refhash(const unsigned char *link_ref) {
   unsigned int hash = 0;
@@ -53,8 +54,28 @@ static unsigned char *normalize_reference(cmark_mem *mem, cmark_chunk *ref) {
   return result;
 }
 
+// Double the number of buckets, so that documents with many reference
+// definitions keep short chains.
+static void grow_table(cmark_reference_map *map) {
+  unsigned int i, size = map->size * 2;
+  cmark_reference **table =
+      (cmark_reference **)map->mem->calloc(size, sizeof(cmark_reference *));
+  cmark_reference *ref, *next;
+
+  for (i = 0; i < map->size; ++i) {
+    for (ref = map->table[i]; ref; ref = next) {
+      next = ref->next;
+      ref->next = table[ref->hash & (size - 1)];
+      table[ref->hash & (size - 1)] = ref;
+    }
+  }
+  map->mem->free(map->table);
+  map->table = table;
+  map->size = size;
+}
+
 static void add_reference(cmark_reference_map *map, cmark_reference *ref) {
-  cmark_reference *t = ref->next = map->table[ref->hash % REFMAP_SIZE];
+  cmark_reference *t = ref->next = map->table[ref->hash & (map->size - 1)];
 
   while (t) {
     if (t->hash == ref->hash && !strcmp((char *)t->label, (char *)ref->label)) {
@@ -65,7 +86,10 @@ static void add_reference(cmark_reference_map *map, cmark_reference *ref) {
     t = t->next;
   }
 
-  map->table[ref->hash % REFMAP_SIZE] = ref;
+  map->table[ref->hash & (map->size - 1)] = ref;
+  ref->age = map->count;
+  if (++map->count > map->size)
+    grow_table(map);
 }
 
 void cmark_reference_create(cmark_reference_map *map, cmark_chunk *label,
@@ -87,14 +111,29 @@ void cmark_reference_create(cmark_reference_map *map, cmark_chunk *label,
   add_reference(map, ref);
 }
 
-// Returns reference if refmap contains a reference with matching
-// label, otherwise NULL.
+static cmark_reference *find_reference(const cmark_reference_map *map,
+                                       const unsigned char *norm,
+                                       unsigned int hash) {
+  cmark_reference *ref = map->table[hash & (map->size - 1)];
+
+  while (ref) {
+    if (ref->hash == hash && !strcmp((char *)ref->label, (char *)norm))
+      break;
+    ref = ref->next;
+  }
+  return ref;
+}
+
+// Returns reference if refmap, or else the shared map behind it,
+// contains a reference with matching label, otherwise NULL.
 cmark_reference *cmark_reference_lookup(cmark_reference_map *map,
                                         cmark_chunk *label) {
   cmark_reference *ref = NULL;
   unsigned char *norm;
   unsigned int hash;
 
+  STATS_ADD(ref_lookups, 1);
+
   if (label->len < 1 || label->len > MAX_LINK_LABEL_LENGTH)
     return NULL;
 
@@ -106,25 +145,20 @@ cmark_reference *cmark_reference_lookup(cmark_reference_map *map,
     return NULL;
 
   hash = refhash(norm);
-  ref = map->table[hash % REFMAP_SIZE];
-
-  while (ref) {
-    if (ref->hash == hash && !strcmp((char *)ref->label, (char *)norm))
-      break;
-    ref = ref->next;
-  }
+  ref = find_reference(map, norm, hash);
+  if (ref == NULL && map->shared != NULL)
+    ref = find_reference(map->shared, norm, hash);
 
   map->mem->free(norm);
+  if (ref != NULL)
+    STATS_ADD(ref_hits, 1);
   return ref;
 }
 
-void cmark_reference_map_free(cmark_reference_map *map) {
+void cmark_reference_map_clear(cmark_reference_map *map) {
   unsigned int i;
 
-  if (map == NULL)
-    return;
-
-  for (i = 0; i < REFMAP_SIZE; ++i) {
+  for (i = 0; i < map->size; ++i) {
     cmark_reference *ref = map->table[i];
     cmark_reference *next;
 
@@ -133,14 +167,30 @@ void cmark_reference_map_free(cmark_reference_map *map) {
       reference_free(map, ref);
       ref = next;
     }
+    map->table[i] = NULL;
   }
+  map->count = 0;
+}
+
+void cmark_reference_map_free(cmark_reference_map *map) {
+  if (map == NULL)
+    return;
 
+  cmark_reference_map_clear(map);
+  map->mem->free(map->table);
   map->mem->free(map);
 }
 
+size_t cmark_reference_map_count(const cmark_reference_map *map) {
+  return map->count;
+}
+
 cmark_reference_map *cmark_reference_map_new(cmark_mem *mem) {
   cmark_reference_map *map =
       (cmark_reference_map *)mem->calloc(1, sizeof(cmark_reference_map));
   map->mem = mem;
+  map->table =
+      (cmark_reference **)mem->calloc(REFMAP_SIZE, sizeof(cmark_reference *));
+  map->size = REFMAP_SIZE;
   return map;
 }
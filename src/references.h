@@ -8,6 +8,8 @@
 extern "C" {
 #endif
 
+// The initial number of buckets; the table doubles whenever it holds
+// more references than buckets.
 #define REFMAP_SIZE 16
 
 struct cmark_reference {
@@ -16,19 +18,23 @@ struct cmark_reference {
   cmark_chunk url;
   cmark_chunk title;
   unsigned int hash;
+  unsigned int age; // the number of references made before this one
 };
 
 typedef struct cmark_reference cmark_reference;
 
 struct cmark_reference_map {
   cmark_mem *mem;
-  cmark_reference *table[REFMAP_SIZE];
+  cmark_reference **table;
+  unsigned int size;  // number of buckets, a power of two
+  unsigned int count; // number of references
+  // Looked up when a label is not in this map; never changed, and
+  // shared with other parsers (see cmark_parser_set_shared_references).
+  const struct cmark_reference_map *shared;
 };
 
-typedef struct cmark_reference_map cmark_reference_map;
-
 cmark_reference_map *cmark_reference_map_new(cmark_mem *mem);
-void cmark_reference_map_free(cmark_reference_map *map);
+void cmark_reference_map_clear(cmark_reference_map *map);
 cmark_reference *cmark_reference_lookup(cmark_reference_map *map,
                                         cmark_chunk *label);
 extern void cmark_reference_create(cmark_reference_map *map, cmark_chunk *label,
@@ -147,21 +147,31 @@ char *cmark_render(cmark_node *root, int options, int width,
                                 unsigned char),
                    int (*render_node)(cmark_renderer *renderer,
                                       cmark_node *node,
-                                      cmark_event_type ev_type, int options)) {
+                                      cmark_event_type ev_type, int options),
+                   size_t size_hint) {
   cmark_mem *mem = cmark_node_mem(root);
   cmark_strbuf pref = CMARK_BUF_INIT(mem);
   cmark_strbuf buf = CMARK_BUF_INIT(mem);
   cmark_node *cur;
   cmark_event_type ev_type;
   char *result;
+  size_t max_output = cmark_node_output_limit(root);
   cmark_iter *iter = cmark_iter_new(root);
 
   cmark_renderer renderer = {mem,   &buf, &pref, 0,           width,
                              0,     0,    true,  true,        false,
                              false, outc, S_cr,  S_blankline, S_out};
 
+  cmark_strbuf_reserve(&buf, size_hint);
+
   while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
     cur = cmark_iter_get_node(iter);
+    if (max_output && ev_type == CMARK_EVENT_ENTER &&
+        (size_t)buf.size >= max_output) {
+      // output limit reached, leave out this node
+      cmark_iter_reset(iter, cur, CMARK_EVENT_EXIT);
+      continue;
+    }
     if (!render_node(&renderer, cur, ev_type, options)) {
       // a false value causes us to skip processing
       // the node's contents.  this is used for
@@ -171,7 +181,8 @@ char *cmark_render(cmark_node *root, int options, int width,
   }
 
   // ensure final newline
-  if (renderer.buffer->ptr[renderer.buffer->size - 1] != '\n') {
+  if (renderer.buffer->size == 0 ||
+      renderer.buffer->ptr[renderer.buffer->size - 1] != '\n') {
     cmark_strbuf_putc(renderer.buffer, '\n');
   }
 
@@ -41,7 +41,8 @@ char *cmark_render(cmark_node *root, cmark_option_t options, int width,
                                 unsigned char),
                    int (*render_node)(cmark_renderer *renderer,
                                       cmark_node *node,
-                                      cmark_event_type ev_type, cmark_option_t options));
+                                      cmark_event_type ev_type, cmark_option_t options),
+                   size_t size_hint);
 
 #ifdef __cplusplus
 }
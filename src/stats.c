@@ -0,0 +1,46 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <string.h>
+
+#include "config.h"
+#include "cmark.h"
+#include "parser.h"
+#include "stats.h"
+
+#ifdef CMARK_STATS
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+CMARK_THREAD_LOCAL cmark_stats *cmark_stats_current = NULL;
+
+double cmark_stats_clock(void) {
+#ifdef _WIN32
+  LARGE_INTEGER freq, count;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&count);
+  return (double)count.QuadPart * 1e9 / (double)freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+#endif
+
+int cmark_parser_get_stats(cmark_parser *parser, cmark_stats *stats) {
+#ifdef CMARK_STATS
+  memcpy(stats, &parser->stats, sizeof(*stats));
+  return 1;
+#else
+  (void)parser;
+  memset(stats, 0, sizeof(*stats));
+  return 0;
+#endif
+}
@@ -0,0 +1,67 @@
+#ifndef CMARK_STATS_H
+#define CMARK_STATS_H
+
+#include "config.h"
+#include "cmark.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Statistics are collected into the `cmark_stats` of the parser which
+// is currently running on this thread (set on entry to the parser's
+// public functions), so that code without access to the parser --
+// allocators, node constructors, the inline parser -- can count too.
+//
+// Without CMARK_STATS all of this compiles to nothing.
+
+#ifdef CMARK_STATS
+
+#if defined(_MSC_VER)
+#define CMARK_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define CMARK_THREAD_LOCAL __thread
+#else
+#define CMARK_THREAD_LOCAL
+#endif
+
+extern CMARK_THREAD_LOCAL cmark_stats *cmark_stats_current;
+
+// Monotonic clock in nanoseconds.
+double cmark_stats_clock(void);
+
+#define STATS_ENTER(stats)                                                     \
+  cmark_stats *stats_saved_ = cmark_stats_current;                             \
+  cmark_stats_current = (stats)
+#define STATS_LEAVE() (cmark_stats_current = stats_saved_)
+
+#define STATS_ADD(field, n)                                                    \
+  do {                                                                         \
+    if (cmark_stats_current != NULL)                                           \
+      cmark_stats_current->field += (n);                                       \
+  } while (0)
+#define STATS_MAX(field, n)                                                    \
+  do {                                                                         \
+    if (cmark_stats_current != NULL && cmark_stats_current->field < (n))       \
+      cmark_stats_current->field = (n);                                        \
+  } while (0)
+
+#define STATS_START(t) double t = cmark_stats_clock()
+#define STATS_STOP(field, t) STATS_ADD(field, cmark_stats_clock() - (t))
+
+#else
+
+#define STATS_ENTER(stats)
+#define STATS_LEAVE() ((void)0)
+#define STATS_ADD(field, n) ((void)0)
+#define STATS_MAX(field, n) ((void)0)
+#define STATS_START(t)
+#define STATS_STOP(field, t) ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
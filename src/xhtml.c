@@ -302,10 +302,19 @@ char *cmark_render_xhtml(cmark_node *root, cmark_option_t options) {
   cmark_event_type ev_type;
   cmark_node *cur;
   struct render_state state = {&html, NULL};
+  size_t max_output = cmark_node_output_limit(root);
   cmark_iter *iter = cmark_iter_new(root);
 
+  // the markup is the same as HTML's but for details
+  cmark_strbuf_reserve(&html, cmark_render_html_size_hint(root, options));
   while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
     cur = cmark_iter_get_node(iter);
+    if (max_output && ev_type == CMARK_EVENT_ENTER &&
+        (size_t)html.size >= max_output) {
+      // output limit reached, leave out this node
+      cmark_iter_reset(iter, cur, CMARK_EVENT_EXIT);
+      continue;
+    }
     S_render_node(cur, ev_type, &state, options);
   }
   result = (char *)cmark_strbuf_detach(&html);
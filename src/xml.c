@@ -151,20 +151,38 @@ static int S_render_node(cmark_node *node, cmark_event_type ev_type,
   return 1;
 }
 
+// The bytes of markup around each type of node, with some indentation,
+// without and with source positions, for the size estimate.
+static const unsigned char XML_OVERHEAD[2][CMARK_NODE_LAST_INLINE + 1] = {
+    {0, 150, 41, 54, 27, 32, 32, 50, 37, 42, 25, 22, 22, 22, 22, 36, 50, 31, 35,
+     55, 57},
+    {0, 150, 62, 75, 48, 53, 53, 71, 58, 63, 46, 22, 22, 22, 22, 36, 50, 31, 35,
+     55, 57}};
+
 char *cmark_render_xml(cmark_node *root, cmark_option_t options) {
   char *result;
   cmark_strbuf xml = CMARK_BUF_INIT(cmark_node_mem(root));
   cmark_event_type ev_type;
   cmark_node *cur;
   struct render_state state = {&xml, 0};
+  size_t max_output = cmark_node_output_limit(root);
 
   cmark_iter *iter = cmark_iter_new(root);
 
+  cmark_strbuf_reserve(
+      &xml, cmark_node_estimate_size(
+                root, XML_OVERHEAD[(options & CMARK_OPT_SOURCEPOS) != 0], 4));
   cmark_strbuf_puts(state.xml, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
   cmark_strbuf_puts(state.xml,
                     "<!DOCTYPE document SYSTEM \"CommonMark.dtd\">\n");
   while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
     cur = cmark_iter_get_node(iter);
+    if (max_output && ev_type == CMARK_EVENT_ENTER &&
+        (size_t)xml.size >= max_output) {
+      // output limit reached, leave out this node
+      cmark_iter_reset(iter, cur, CMARK_EVENT_EXIT);
+      continue;
+    }
     S_render_node(cur, ev_type, &state, options);
   }
   result = (char *)cmark_strbuf_detach(&xml);
@@ -38,6 +38,9 @@ pathological = {
     "mismatched openers and closers":
                  (("*a_ " * 50000),
                   re.compile("([*]a[_] ){49999}[*]a_")),
+    "openers and closers multiple of 3":
+                 (("a**b" + ("c* " * 50000)),
+                  re.compile("a[*][*]b(c[*] ){49999}c[*]")),
     "link openers and emph closers":
                  (("[ a_" * 50000),
                   re.compile("(\[ a_){50000}")),
@@ -55,7 +58,14 @@ pathological = {
                   re.compile("abc\ufffd?de\ufffd?")),
     "backticks":
                  ("".join(map(lambda x: ("e" + "`" * x), range(1,10000))),
-                  re.compile("^<p>[e`]*</p>\n$"))
+                  re.compile("^<p>[e`]*</p>\n$")),
+    "long backtick runs":
+                 ((("`" * 2000) + " a ") * 2000,
+                  re.compile("^<p>(<code>a</code> a ){999}<code>a</code> a</p>\n$")),
+    "many reference definitions":
+                 ("".join(map(lambda x: ("[%d]: u%d\n" % (x, x)), range(100000)))
+                   + "[0] [99999]\n",
+                  re.compile("^<p><a href=\"u0\">0</a> <a href=\"u99999\">99999</a></p>\n$")),
     }
 
 whitespace_re = re.compile('/s+/')
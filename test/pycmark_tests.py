@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# Tests for the pycmark extension module: its output must be the
+# library's, for single documents and for batches on several threads.
+
+import argparse
+import sys
+from cmark import CMark
+from spec_tests import get_tests
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Run pycmark tests.')
+    parser.add_argument('--module-dir', dest='module_dir', required=True,
+            help='directory containing the pycmark module')
+    parser.add_argument('--library-dir', dest='library_dir', nargs='?',
+            default=None, help='directory containing dynamic library')
+    parser.add_argument('--spec', dest='spec', default='spec.txt',
+            help='path to spec')
+    args = parser.parse_args(sys.argv[1:])
+
+sys.path.insert(0, args.module_dir)
+import pycmark
+
+cmark = CMark(library_dir=args.library_dir)
+docs = [test['markdown'] for test in get_tests(args.spec)]
+
+passed = 0
+failed = 0
+
+def check(name, ok):
+    global passed, failed
+    if ok:
+        print(name, '[PASSED]')
+        passed += 1
+    else:
+        print(name, '[FAILED]')
+        failed += 1
+
+expected = [cmark.to_html(doc)[1].encode('utf-8') for doc in docs]
+check("markdown_to_html",
+      [pycmark.markdown_to_html(doc) for doc in docs] == expected)
+check("markdown_to_html from bytes",
+      [pycmark.markdown_to_html(doc.encode('utf-8')) for doc in docs] ==
+      expected)
+check("markdown_to_html with options",
+      pycmark.markdown_to_html('"a" -- b', options=pycmark.OPT_SMART) ==
+      '<p>“a” – b</p>\n'.encode('utf-8'))
+for threads in [1, 4, 0]:
+    check("render_many on {} threads".format(threads),
+          pycmark.render_many(docs, threads=threads) == expected)
+check("render_many of nothing", pycmark.render_many([]) == [])
+check("render_many of a generator",
+      pycmark.render_many(doc for doc in docs[:10]) == expected[:10])
+
+try:
+    pycmark.render_many(["a", 1])
+    check("render_many rejects other types", False)
+except TypeError:
+    check("render_many rejects other types", True)
+
+print("{} passed, {} failed".format(passed, failed))
+exit(1 if failed else 0)
@@ -0,0 +1,296 @@
+// CPython extension module rendering CommonMark to HTML with the cmark
+// library, without going through ctypes.
+//
+// The GIL is released while documents are parsed and rendered, and
+// `render_many()` renders a batch of documents on several threads,
+// each with its own parser that is reset between documents.  Input is
+// read in place from `str` (as UTF-8) or from any bytes-like object,
+// and the HTML is returned as `bytes`.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmark.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// A document to render.
+typedef struct {
+  Py_buffer view; // if the input is a bytes-like object
+  int has_view;
+  const char *text;
+  Py_ssize_t len;
+  char *html;
+} job;
+
+// The documents of one call, and the next one to take.
+typedef struct {
+  job *jobs;
+  Py_ssize_t njobs;
+  Py_ssize_t next;
+  int options;
+#ifdef _WIN32
+  CRITICAL_SECTION lock;
+#else
+  pthread_mutex_t lock;
+#endif
+} batch;
+
+static job *next_job(batch *b) {
+  job *j = NULL;
+
+#ifdef _WIN32
+  EnterCriticalSection(&b->lock);
+#else
+  pthread_mutex_lock(&b->lock);
+#endif
+  if (b->next < b->njobs)
+    j = &b->jobs[b->next++];
+#ifdef _WIN32
+  LeaveCriticalSection(&b->lock);
+#else
+  pthread_mutex_unlock(&b->lock);
+#endif
+  return j;
+}
+
+// Render documents until there are none left.  Called without the GIL.
+static void render_jobs(batch *b) {
+  cmark_parser *parser = cmark_parser_new(b->options);
+  cmark_node *doc;
+  job *j;
+
+  while ((j = next_job(b)) != NULL) {
+    cmark_parser_feed(parser, j->text, (size_t)j->len);
+    doc = cmark_parser_finish(parser);
+    j->html = cmark_render_html(doc, b->options);
+    cmark_node_free(doc);
+    cmark_parser_reset(parser, b->options);
+  }
+  cmark_parser_free(parser);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker(LPVOID arg) {
+  render_jobs((batch *)arg);
+  return 0;
+}
+#else
+static void *worker(void *arg) {
+  render_jobs((batch *)arg);
+  return NULL;
+}
+#endif
+
+static int cpu_count(void) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
+
+// Render all jobs of 'b' on 'nthreads' threads, the calling one
+// included.  If a thread cannot be started, the others do its share.
+static void run_batch(batch *b, int nthreads) {
+  int i, started = 0;
+#ifdef _WIN32
+  HANDLE *threads;
+#else
+  pthread_t *threads;
+#endif
+
+  if (nthreads > b->njobs)
+    nthreads = (int)b->njobs;
+  threads = nthreads > 1 ? malloc((nthreads - 1) * sizeof(*threads)) : NULL;
+
+#ifdef _WIN32
+  InitializeCriticalSection(&b->lock);
+  for (i = 0; threads != NULL && i < nthreads - 1; i++) {
+    threads[started] = CreateThread(NULL, 0, worker, b, 0, NULL);
+    if (threads[started] != NULL)
+      started++;
+  }
+  render_jobs(b);
+  for (i = 0; i < started; i++) {
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+  }
+  DeleteCriticalSection(&b->lock);
+#else
+  pthread_mutex_init(&b->lock, NULL);
+  for (i = 0; threads != NULL && i < nthreads - 1; i++) {
+    if (pthread_create(&threads[started], NULL, worker, b) == 0)
+      started++;
+  }
+  render_jobs(b);
+  for (i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&b->lock);
+#endif
+  free(threads);
+}
+
+// Point 'j' at the text of 'obj', which must stay alive until the job
+// is released.
+static int job_init(job *j, PyObject *obj) {
+  memset(j, 0, sizeof(*j));
+  if (PyUnicode_Check(obj)) {
+    j->text = PyUnicode_AsUTF8AndSize(obj, &j->len);
+    return j->text != NULL ? 0 : -1;
+  }
+  if (PyObject_GetBuffer(obj, &j->view, PyBUF_SIMPLE) < 0) {
+    PyErr_Format(PyExc_TypeError,
+                 "expected str or a bytes-like object, not %.200s",
+                 Py_TYPE(obj)->tp_name);
+    return -1;
+  }
+  j->has_view = 1;
+  j->text = (const char *)j->view.buf;
+  j->len = j->view.len;
+  return 0;
+}
+
+static void job_release(job *j) {
+  if (j->has_view)
+    PyBuffer_Release(&j->view);
+  free(j->html);
+}
+
+static PyObject *job_result(job *j) {
+  return PyBytes_FromStringAndSize(j->html, (Py_ssize_t)strlen(j->html));
+}
+
+PyDoc_STRVAR(markdown_to_html_doc,
+             "markdown_to_html(text, options=0) -> bytes\n\n"
+             "Render the CommonMark document 'text' (str or bytes-like, "
+             "UTF-8) as HTML.");
+
+static PyObject *markdown_to_html(PyObject *self, PyObject *args,
+                                  PyObject *kwargs) {
+  static char *kwlist[] = {"text", "options", NULL};
+  PyObject *text, *result;
+  batch b;
+  job j;
+
+  (void)self;
+  memset(&b, 0, sizeof(b));
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i:markdown_to_html",
+                                   kwlist, &text, &b.options))
+    return NULL;
+  if (job_init(&j, text) < 0)
+    return NULL;
+
+  b.jobs = &j;
+  b.njobs = 1;
+  Py_BEGIN_ALLOW_THREADS
+  run_batch(&b, 1);
+  Py_END_ALLOW_THREADS
+
+  result = job_result(&j);
+  job_release(&j);
+  return result;
+}
+
+PyDoc_STRVAR(render_many_doc,
+             "render_many(docs, options=0, threads=0) -> list of bytes\n\n"
+             "Render each CommonMark document of the sequence 'docs' as "
+             "HTML, on\n'threads' threads (0 for one per CPU).");
+
+static PyObject *render_many(PyObject *self, PyObject *args,
+                             PyObject *kwargs) {
+  static char *kwlist[] = {"docs", "options", "threads", NULL};
+  PyObject *docs, *items, *result = NULL;
+  int threads = 0;
+  Py_ssize_t i, ninit = 0;
+  batch b;
+
+  (void)self;
+  memset(&b, 0, sizeof(b));
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ii:render_many", kwlist,
+                                   &docs, &b.options, &threads))
+    return NULL;
+
+  // A tuple keeps the documents alive even if 'docs' is changed by
+  // another thread while the GIL is released.
+  items = PySequence_Tuple(docs);
+  if (items == NULL)
+    return NULL;
+  b.njobs = PyTuple_GET_SIZE(items);
+  b.jobs = PyMem_Calloc(b.njobs ? b.njobs : 1, sizeof(job));
+  if (b.jobs == NULL) {
+    PyErr_NoMemory();
+    goto done;
+  }
+  for (ninit = 0; ninit < b.njobs; ninit++) {
+    if (job_init(&b.jobs[ninit], PyTuple_GET_ITEM(items, ninit)) < 0)
+      goto done;
+  }
+
+  if (threads <= 0)
+    threads = cpu_count();
+  Py_BEGIN_ALLOW_THREADS
+  run_batch(&b, threads);
+  Py_END_ALLOW_THREADS
+
+  result = PyList_New(b.njobs);
+  for (i = 0; result != NULL && i < b.njobs; i++) {
+    PyObject *html = job_result(&b.jobs[i]);
+    if (html == NULL) {
+      Py_CLEAR(result);
+      break;
+    }
+    PyList_SET_ITEM(result, i, html);
+  }
+
+done:
+  for (i = 0; i < ninit; i++)
+    job_release(&b.jobs[i]);
+  PyMem_Free(b.jobs);
+  Py_DECREF(items);
+  return result;
+}
+
+static PyMethodDef pycmark_methods[] = {
+    {"markdown_to_html", (PyCFunction)(void (*)(void))markdown_to_html,
+     METH_VARARGS | METH_KEYWORDS, markdown_to_html_doc},
+    {"render_many", (PyCFunction)(void (*)(void))render_many,
+     METH_VARARGS | METH_KEYWORDS, render_many_doc},
+    {NULL, NULL, 0, NULL}};
+
+static struct PyModuleDef pycmark_module = {
+    PyModuleDef_HEAD_INIT, "pycmark",
+    "Render CommonMark as HTML with the cmark library.", -1, pycmark_methods,
+    NULL, NULL, NULL, NULL};
+
+PyMODINIT_FUNC PyInit_pycmark(void) {
+  PyObject *m = PyModule_Create(&pycmark_module);
+
+  if (m == NULL)
+    return NULL;
+  if (PyModule_AddStringConstant(m, "version", cmark_version_string()) < 0 ||
+      PyModule_AddIntConstant(m, "OPT_DEFAULT", CMARK_OPT_DEFAULT) < 0 ||
+      PyModule_AddIntConstant(m, "OPT_SOURCEPOS", CMARK_OPT_SOURCEPOS) < 0 ||
+      PyModule_AddIntConstant(m, "OPT_HARDBREAKS", CMARK_OPT_HARDBREAKS) < 0 ||
+      PyModule_AddIntConstant(m, "OPT_SAFE", CMARK_OPT_SAFE) < 0 ||
+      PyModule_AddIntConstant(m, "OPT_NOBREAKS", CMARK_OPT_NOBREAKS) < 0 ||
+      PyModule_AddIntConstant(m, "OPT_NORMALIZE", CMARK_OPT_NORMALIZE) < 0 ||
+      PyModule_AddIntConstant(m, "OPT_VALIDATE_UTF8",
+                              CMARK_OPT_VALIDATE_UTF8) < 0 ||
+      PyModule_AddIntConstant(m, "OPT_SMART", CMARK_OPT_SMART) < 0) {
+    Py_DECREF(m);
+    return NULL;
+  }
+  return m;
+}
@@ -2,36 +2,45 @@
 
 # Example for using the shared library from python
 # Will work with either python 2 or python 3
-# Requires cmark library to be installed
+# Requires cmark library to be installed, or the pycmark extension
+# module (cmake -DCMARK_PYTHON=ON) for python 3
 
-from ctypes import CDLL, c_char_p, c_long
 import sys
 import platform
 
-sysname = platform.system()
+opts = 0 # defaults
 
-if sysname == 'Darwin':
-    libname = "libcmark.dylib"
-elif sysname == 'Windows':
-    libname = "cmark.dll"
-else:
-    libname = "libcmark.so"
-cmark = CDLL(libname)
+try:
+    import pycmark
 
-markdown = cmark.cmark_markdown_to_html
-markdown.restype = c_char_p
-markdown.argtypes = [c_char_p, c_long, c_long]
+    def md2html(text):
+        return pycmark.markdown_to_html(text, opts).decode('utf-8')
 
-opts = 0 # defaults
+except ImportError:
+    from ctypes import CDLL, c_char_p, c_long
+
+    sysname = platform.system()
 
-def md2html(text):
-    if sys.version_info >= (3,0):
-        textbytes = text.encode('utf-8')
-        textlen = len(textbytes)
-        return markdown(textbytes, textlen, opts).decode('utf-8')
+    if sysname == 'Darwin':
+        libname = "libcmark.dylib"
+    elif sysname == 'Windows':
+        libname = "cmark.dll"
     else:
-        textbytes = text
-        textlen = len(text)
-        return markdown(textbytes, textlen, opts)
+        libname = "libcmark.so"
+    cmark = CDLL(libname)
+
+    markdown = cmark.cmark_markdown_to_html
+    markdown.restype = c_char_p
+    markdown.argtypes = [c_char_p, c_long, c_long]
+
+    def md2html(text):
+        if sys.version_info >= (3,0):
+            textbytes = text.encode('utf-8')
+            textlen = len(textbytes)
+            return markdown(textbytes, textlen, opts).decode('utf-8')
+        else:
+            textbytes = text
+            textlen = len(text)
+            return markdown(textbytes, textlen, opts)
 
 sys.stdout.write(md2html(sys.stdin.read()))